@@ -0,0 +1,179 @@
+// compares the old per object corner projection test against the plane based sphere culling draw_geometry uses now,
+// scalar, avx2 and through the bounding volume hierarchy, over scenes of 10k, 100k and 1M objects.
+// run with: cull_bench [iterations]
+
+// the engine's projection, whose 0 to 1 depth range extract_frustum expects
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cull_bvh.h>
+#include <fmt/core.h>
+#include <frustum_cull.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <vector>
+
+// the fields of a render object the old test read, laid out the same way
+struct CullObject {
+  glm::vec3 origin;
+  float sphere_radius;
+  glm::vec3 extents;
+  glm::mat4 transform;
+};
+
+// the visibility test as it was: all 8 box corners projected to clip space, divided by w and compared to the view
+static bool is_visible(const CullObject& obj, const glm::mat4& viewproj) {
+  std::array<glm::vec3, 8> corners{
+      glm::vec3{1, 1, 1},  glm::vec3{1, 1, -1},  glm::vec3{1, -1, 1},  glm::vec3{1, -1, -1},
+      glm::vec3{-1, 1, 1}, glm::vec3{-1, 1, -1}, glm::vec3{-1, -1, 1}, glm::vec3{-1, -1, -1},
+  };
+
+  glm::mat4 matrix = viewproj * obj.transform;
+
+  glm::vec3 min = {1.5, 1.5, 1.5};
+  glm::vec3 max = {-1.5, -1.5, -1.5};
+
+  for (int c = 0; c < 8; c++) {
+    glm::vec4 v = matrix * glm::vec4(obj.origin + (corners[c] * obj.extents), 1.f);
+
+    v.x = v.x / v.w;
+    v.y = v.y / v.w;
+    v.z = v.z / v.w;
+
+    min = glm::min(glm::vec3{v.x, v.y, v.z}, min);
+    max = glm::max(glm::vec3{v.x, v.y, v.z}, max);
+  }
+
+  return !(min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f);
+}
+
+// objects with a random scale, either scattered all around the camera so some of every kind of plane test fails,
+// or spread over a city sized ground plane of which the camera sees a few percent
+static std::vector<CullObject> make_scene(size_t count, bool city) {
+  std::mt19937 rng{1234};
+  std::uniform_real_distribution<float> position{-500.f, 500.f};
+  std::uniform_real_distribution<float> ground{-5000.f, 5000.f};
+  std::uniform_real_distribution<float> height{0.f, 50.f};
+  std::uniform_real_distribution<float> size{0.5f, 5.f};
+
+  std::vector<CullObject> objects(count);
+  for (CullObject& obj : objects) {
+    obj.origin = glm::vec3{0.f};
+    obj.extents = glm::vec3{size(rng), size(rng), size(rng)};
+    obj.sphere_radius = glm::length(obj.extents);
+    const glm::vec3 translation = city ? glm::vec3{ground(rng), height(rng), ground(rng)}
+                                       : glm::vec3{position(rng), position(rng), position(rng)};
+    obj.transform = glm::translate(glm::mat4{1.f}, translation) * glm::scale(glm::mat4{1.f}, glm::vec3{size(rng)});
+  }
+  return objects;
+}
+
+template <typename F> static double time_ms(uint32_t iterations, F&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i{0}; i < iterations; ++i) {
+    func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv) {
+  const uint32_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20;
+
+  // same projection as update_scene, reversed depth
+  glm::mat4 proj = glm::perspective(glm::radians(70.f), 1700.f / 900.f, 10000.f, 0.1f);
+  proj[1][1] *= -1;
+  const bool avx2 = cull_spheres_avx2_supported();
+
+  fmt::println("{} iterations, avx2 {}", iterations, avx2 ? "available" : "unavailable, scalar twice");
+  for (bool city : {false, true}) {
+    // the city is looked down at from above
+    const glm::mat4 view =
+        city ? glm::lookAt(glm::vec3{0.f, 400.f, 0.f}, glm::vec3{200.f, 0.f, -200.f}, glm::vec3{0.f, 1.f, 0.f})
+             : glm::lookAt(glm::vec3{0.f, 0.f, 0.f}, glm::vec3{1.f, 0.2f, -1.f}, glm::vec3{0.f, 1.f, 0.f});
+    const glm::mat4 viewproj = proj * view;
+    const Frustum frustum = extract_frustum(viewproj);
+    for (size_t count : {size_t(10'000), size_t(100'000), size_t(1'000'000)}) {
+      const std::vector<CullObject> objects = make_scene(count, city);
+      CullSpheres spheres;
+      for (const CullObject& obj : objects) {
+        spheres.push_back(transform_sphere(obj.origin, obj.sphere_radius, obj.transform));
+      }
+
+      std::vector<uint32_t> corner_visible;
+      std::vector<uint32_t> scalar_visible;
+      std::vector<uint32_t> avx2_visible;
+      std::vector<uint32_t> bvh_visible;
+      corner_visible.reserve(count);
+      scalar_visible.reserve(count);
+      avx2_visible.reserve(count);
+      bvh_visible.reserve(count);
+
+      const double corner_ms = time_ms(iterations, [&]() {
+        corner_visible.clear();
+        for (uint32_t i = 0; i < objects.size(); i++) {
+          if (is_visible(objects[i], viewproj)) {
+            corner_visible.push_back(i);
+          }
+        }
+      });
+      const double scalar_ms = time_ms(iterations, [&]() {
+        scalar_visible.clear();
+        cull_spheres_scalar(frustum, spheres, scalar_visible);
+      });
+      const double avx2_ms = time_ms(iterations, [&]() {
+        avx2_visible.clear();
+        if (avx2) {
+          cull_spheres_avx2(frustum, spheres, avx2_visible);
+        } else {
+          cull_spheres_scalar(frustum, spheres, avx2_visible);
+        }
+      });
+
+      // the render list moves its objects into the tree's order on a build, the spheres are moved the same way here
+      CullBvh bvh;
+      std::vector<uint32_t> order;
+      CullSpheres tree_spheres;
+      const double build_ms = time_ms(1, [&]() {
+        bvh.build(spheres, spheres.size(), order);
+        tree_spheres.clear();
+        for (uint32_t i : order) {
+          tree_spheres.push_back(glm::vec4{spheres.x[i], spheres.y[i], spheres.z[i], spheres.radius[i]});
+        }
+        bvh.refit(tree_spheres);
+      });
+      const double refit_ms = time_ms(iterations, [&]() { bvh.refit(tree_spheres); });
+      const double bvh_ms = time_ms(iterations, [&]() {
+        bvh_visible.clear();
+        bvh.cull(frustum, tree_spheres, 0, bvh_visible);
+      });
+      for (uint32_t& i : bvh_visible) {
+        i = order[i];
+      }
+      std::sort(bvh_visible.begin(), bvh_visible.end());
+
+      // both kernels do the same arithmetic in the same order, so they have to agree exactly. the hierarchy only
+      // takes or drops whole subtrees whose box is entirely on one side of a plane, so it agrees as well. the corner
+      // test keeps more, boxes crossing the camera plane flip when their corners are divided by a negative w and pass
+      if (scalar_visible != avx2_visible || scalar_visible != bvh_visible) {
+        fmt::println("culling kernels disagree at {} objects", count);
+        return 1;
+      }
+
+      fmt::println("{} objects, {}", count, city ? "city" : "scattered");
+      fmt::println("  corners:        {:.3f} ms, {} visible", corner_ms, corner_visible.size());
+      fmt::println("  planes scalar:  {:.3f} ms, {} visible ({:.1f}x)", scalar_ms, scalar_visible.size(),
+                   corner_ms / scalar_ms);
+      fmt::println("  planes avx2:    {:.3f} ms, {} visible ({:.1f}x)", avx2_ms, avx2_visible.size(),
+                   corner_ms / avx2_ms);
+      fmt::println("  bvh:            {:.3f} ms, {} visible ({:.1f}x), {:.3f} ms build, {:.3f} ms refit", bvh_ms,
+                   bvh_visible.size(), corner_ms / bvh_ms, build_ms, refit_ms);
+    }
+  }
+  return 0;
+}
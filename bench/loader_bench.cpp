@@ -0,0 +1,185 @@
+// compares the old per element accessor conversion against the bulk stream conversion used by the glTF loader, and
+// checks the meshopt filters against values from the reference decoder first.
+// run with: loader_bench [primitives per mesh] [vertices per primitive] [iterations]
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fmt/core.h>
+#include <glm/glm.hpp>
+#include <meshopt_decoder.h>
+#include <random>
+#include <span>
+#include <vector>
+#include <vertex_streams.h>
+
+struct SourcePrimitive {
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> uvs;
+  std::vector<glm::vec4> colors;
+  std::vector<uint32_t> indices;
+};
+
+// stands in for fastgltf's per element iteration, which calls back once for every element
+template <typename T, typename F> [[gnu::noinline]] void iterate_with_index(const std::vector<T>& src, F&& func) {
+  for (size_t i{0}; i < src.size(); ++i) {
+    func(src[i], i);
+  }
+}
+
+static std::vector<SourcePrimitive> make_mesh(size_t primitive_count, size_t vertex_count) {
+  std::mt19937 rng{1234};
+  std::uniform_real_distribution<float> dist{-100.f, 100.f};
+
+  std::vector<SourcePrimitive> mesh(primitive_count);
+  for (SourcePrimitive& p : mesh) {
+    p.positions.resize(vertex_count);
+    p.normals.resize(vertex_count);
+    p.uvs.resize(vertex_count);
+    p.colors.resize(vertex_count);
+    p.indices.resize(vertex_count * 3);
+    for (size_t i{0}; i < vertex_count; ++i) {
+      p.positions[i] = {dist(rng), dist(rng), dist(rng)};
+      p.normals[i] = glm::vec3{0.f, 1.f, 0.f};
+      p.uvs[i] = {dist(rng), dist(rng)};
+      p.colors[i] = glm::vec4{1.f};
+    }
+    for (size_t i{0}; i < p.indices.size(); ++i) {
+      p.indices[i] = static_cast<uint32_t>(rng() % vertex_count);
+    }
+  }
+  return mesh;
+}
+
+// the conversion as it was: per element callbacks and bounds over the whole mesh for every primitive
+static float convert_per_element(const std::vector<SourcePrimitive>& mesh, std::vector<Vertex>& vertices,
+                                 std::vector<uint32_t>& indices) {
+  vertices.clear();
+  indices.clear();
+  float checksum = 0.f;
+
+  for (const SourcePrimitive& p : mesh) {
+    size_t initial_vtx = vertices.size();
+
+    indices.reserve(indices.size() + p.indices.size());
+    iterate_with_index(p.indices, [&](uint32_t idx, size_t) { indices.push_back(idx + initial_vtx); });
+
+    vertices.resize(vertices.size() + p.positions.size());
+    iterate_with_index(p.positions, [&](glm::vec3 v, size_t index) {
+      Vertex newvtx;
+      newvtx.position = v;
+      newvtx.normal = {1, 0, 0};
+      newvtx.color = glm::vec4{1.f};
+      newvtx.uv_x = 0;
+      newvtx.uv_y = 0;
+      vertices[initial_vtx + index] = newvtx;
+    });
+    iterate_with_index(p.normals, [&](glm::vec3 v, size_t index) { vertices[initial_vtx + index].normal = v; });
+    iterate_with_index(p.uvs, [&](glm::vec2 v, size_t index) {
+      vertices[initial_vtx + index].uv_x = v.x;
+      vertices[initial_vtx + index].uv_y = v.y;
+    });
+    iterate_with_index(p.colors, [&](glm::vec4 v, size_t index) { vertices[initial_vtx + index].color = v; });
+
+    glm::vec3 min_pos = vertices[initial_vtx].position;
+    glm::vec3 max_pos = vertices[initial_vtx].position;
+    for (auto& vert : vertices) {
+      min_pos = glm::min(min_pos, vert.position);
+      max_pos = glm::max(max_pos, vert.position);
+    }
+    checksum += max_pos.x - min_pos.x;
+  }
+  return checksum;
+}
+
+// the conversion the loader does now. the memcpys stand in for fastgltf::copyFromAccessor
+static float convert_bulk(const std::vector<SourcePrimitive>& mesh, std::vector<Vertex>& vertices,
+                          std::vector<uint32_t>& indices, std::vector<glm::vec3>& position_stream) {
+  vertices.clear();
+  indices.clear();
+  float checksum = 0.f;
+
+  for (const SourcePrimitive& p : mesh) {
+    const size_t initial_vtx = vertices.size();
+    const size_t initial_idx = indices.size();
+
+    indices.resize(indices.size() + p.indices.size());
+    std::span<uint32_t> primitive_indices = std::span(indices).subspan(initial_idx);
+    std::memcpy(primitive_indices.data(), p.indices.data(), primitive_indices.size_bytes());
+    offset_indices(primitive_indices, static_cast<uint32_t>(initial_vtx));
+
+    vertices.resize(vertices.size() + p.positions.size());
+    std::span<Vertex> primitive_vertices = std::span(vertices).subspan(initial_vtx);
+
+    position_stream.resize(p.positions.size());
+    std::memcpy(position_stream.data(), p.positions.data(), p.positions.size() * sizeof(glm::vec3));
+    PositionBounds bounds = write_positions(primitive_vertices, position_stream);
+
+    write_normals(primitive_vertices, p.normals);
+    write_uvs(primitive_vertices, p.uvs);
+    write_colors(primitive_vertices, p.colors);
+
+    checksum += bounds.max.x - bounds.min.x;
+  }
+  return checksum;
+}
+
+template <typename F> static double time_ms(uint32_t iterations, F&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i{0}; i < iterations; ++i) {
+    func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+}
+
+// octahedral vectors as the reference decoder in meshoptimizer decodes them, both hemispheres. w passes through
+template <typename T> static bool check_octahedral(std::vector<std::array<T, 4>> encoded,
+                                                   const std::vector<std::array<T, 4>>& expected) {
+  apply_meshopt_filter(std::as_writable_bytes(std::span(encoded)), encoded.size(), sizeof(encoded[0]),
+                       MeshoptFilter::octahedral);
+  return encoded == expected;
+}
+
+int main(int argc, char** argv) {
+  if (!check_octahedral<int8_t>({{127, 127, 127, 1}, {0, 0, 127, 2}, {100, -20, 50, 3}, {-90, 30, 40, 4}},
+                                {{0, 0, -127, 1}, {0, 0, 127, 2}, {42, 70, -98, 3}, {-13, -67, -107, 4}}) ||
+      !check_octahedral<int16_t>({{32767, 0, 32767, 5}, {-20000, -10000, 12000, 6}},
+                                 {{32767, 0, 0, 5}, {-3310, 13240, -29790, 6}})) {
+    fmt::println("meshopt octahedral filter doesn't match the reference decoder");
+    return 1;
+  }
+
+  const size_t primitive_count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  const size_t vertex_count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 4096;
+  const uint32_t iterations = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 20;
+
+  std::vector<SourcePrimitive> mesh = make_mesh(primitive_count, vertex_count);
+  std::vector<Vertex> vertices;
+  std::vector<uint32_t> indices;
+  std::vector<glm::vec3> position_stream;
+
+  // both paths must produce the same vertex and index arrays
+  convert_per_element(mesh, vertices, indices);
+  std::vector<Vertex> expected_vertices = vertices;
+  std::vector<uint32_t> expected_indices = indices;
+  convert_bulk(mesh, vertices, indices, position_stream);
+  if (std::memcmp(expected_vertices.data(), vertices.data(), vertices.size() * sizeof(Vertex)) != 0 ||
+      expected_indices != indices) {
+    fmt::println("bulk conversion doesn't match the per element conversion");
+    return 1;
+  }
+
+  volatile float sink = 0.f;
+  double per_element_ms = time_ms(iterations, [&]() { sink = sink + convert_per_element(mesh, vertices, indices); });
+  double bulk_ms =
+      time_ms(iterations, [&]() { sink = sink + convert_bulk(mesh, vertices, indices, position_stream); });
+
+  fmt::println("{} primitives x {} vertices, {} iterations", primitive_count, vertex_count, iterations);
+  fmt::println("per element: {:.3f} ms per mesh", per_element_ms);
+  fmt::println("bulk:        {:.3f} ms per mesh ({:.1f}x)", bulk_ms, per_element_ms / bulk_ms);
+  return 0;
+}
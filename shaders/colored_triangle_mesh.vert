@@ -18,11 +18,15 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer{
 	Vertex vertices[];
 };
 
-//push constants block
+layout(buffer_reference, std430) readonly buffer InstanceBuffer{ 
+	mat4 transforms[];
+};
+
+//push constants block, GPUDrawPushConstants
 layout( push_constant ) uniform constants
 {	
-	mat4 render_matrix;
 	VertexBuffer vertexBuffer;
+	InstanceBuffer instanceBuffer;
 } PushConstants;
 
 void main() 
@@ -31,7 +35,7 @@ void main()
 	Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
 
 	//output data
-	gl_Position = PushConstants.render_matrix *vec4(v.position, 1.0f);
+	gl_Position = PushConstants.instanceBuffer.transforms[gl_InstanceIndex] *vec4(v.position, 1.0f);
 	outColor = v.color.xyz;
 	outUV.x = v.uv_x;
 	outUV.y = v.uv_y;
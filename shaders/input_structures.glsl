@@ -7,10 +7,11 @@ layout(set = 0, binding = 0) uniform SceneData {
     vec4 sunlight_color;
 } sceneData;
 
-layout(set = 1, binding = 0) uniform GLTFMaterialData {
+// GLTFMettallicRoughness::MaterialConstants, one record of a scene's material table
+struct MaterialData {
     vec4 color_factors;
     vec4 metal_rough_factors;
-} materialData;
+};
 
 layout(set = 1, binding = 1) uniform sampler2D colorTex;
 layout(set = 1, binding = 2) uniform sampler2D metalRoughTex;
@@ -21,18 +21,31 @@ layout(buffer_reference, std430) readonly buffer VertexBuffer {
     Vertex vertices[];
 } vertexBuffer;
 
+// world matrix of every object drawn this frame, gl_InstanceIndex picks the draw's
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 transforms[];
+};
+
+layout(buffer_reference, std430) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+
 layout(push_constant) uniform constants {
-    mat4 renderMatrix;
     VertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
+    MaterialBuffer materialBuffer;
+    uint materialIndex;
 } PushConstants;
 
 void main() {
     Vertex v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
     vec4 position = vec4(v.position, 1.0f);
+    mat4 renderMatrix = PushConstants.instanceBuffer.transforms[gl_InstanceIndex];
+    MaterialData material = PushConstants.materialBuffer.materials[PushConstants.materialIndex];
 
-    gl_Position = sceneData.viewproj * PushConstants.renderMatrix * position;
-    outNormal = (PushConstants.renderMatrix * vec4(v.normal, 0.f)).xyz;
-    outColor = v.color.xyz * materialData.color_factors.xyz;
+    gl_Position = sceneData.viewproj * renderMatrix * position;
+    outNormal = (renderMatrix * vec4(v.normal, 0.f)).xyz;
+    outColor = v.color.xyz * material.color_factors.xyz;
     outUV.x = v.uv_x;
     outUV.y = v.uv_y;
 }
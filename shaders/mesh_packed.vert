@@ -0,0 +1,58 @@
+#version 450
+
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_buffer_reference : require
+
+#include "input_structures.glsl"
+
+layout(location = 0) out vec3 outNormal;
+layout(location = 1) out vec3 outColor;
+layout(location = 2) out vec2 outUV;
+
+// PackedVertex in vertex.h, one vertex per uvec4:
+// x: position.xy unorm16, y: position.z unorm16 + octahedral normal snorm8x2, z: uv half2, w: color unorm8x4
+layout(buffer_reference, std430) readonly buffer PackedVertexBuffer {
+    uvec4 vertices[];
+} vertexBuffer;
+
+// world matrix of every object drawn this frame, gl_InstanceIndex picks the draw's
+layout(buffer_reference, std430) readonly buffer InstanceBuffer {
+    mat4 transforms[];
+};
+
+layout(buffer_reference, std430) readonly buffer MaterialBuffer {
+    MaterialData materials[];
+};
+
+layout(push_constant) uniform constants {
+    PackedVertexBuffer vertexBuffer;
+    InstanceBuffer instanceBuffer;
+    MaterialBuffer materialBuffer;
+    uint materialIndex;
+    vec4 positionOffset;
+    // quantization range divided by 65535, so it scales the raw unorm16 values
+    vec4 positionScale;
+} PushConstants;
+
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e.x, e.y, 1.0f - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+void main() {
+    uvec4 v = PushConstants.vertexBuffer.vertices[gl_VertexIndex];
+
+    vec3 quantized = vec3(v.x & 0xffffu, v.x >> 16, v.y & 0xffffu);
+    vec4 position = vec4(PushConstants.positionOffset.xyz + quantized * PushConstants.positionScale.xyz, 1.0f);
+    vec3 normal = decode_octahedral(unpackSnorm4x8(v.y).zw);
+    mat4 renderMatrix = PushConstants.instanceBuffer.transforms[gl_InstanceIndex];
+    MaterialData material = PushConstants.materialBuffer.materials[PushConstants.materialIndex];
+
+    gl_Position = sceneData.viewproj * renderMatrix * position;
+    outNormal = (renderMatrix * vec4(normal, 0.f)).xyz;
+    outColor = unpackUnorm4x8(v.w).xyz * material.color_factors.xyz;
+    outUV = unpackHalf2x16(v.z);
+}
@@ -0,0 +1,278 @@
+#include <algorithm>
+#include <array>
+#include <bc_encoder.h>
+#include <cmath>
+#include <cstring>
+
+// interpolation weights for 4 bit BC7 indices, out of 64
+constexpr std::array<uint32_t, 16> BC7_WEIGHTS{0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+using Block = std::array<std::array<uint8_t, 4>, 16>;
+
+static Block load_block(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, uint32_t block_x,
+                        uint32_t block_y) {
+  Block block;
+  for (uint32_t y = 0; y < 4; y++) {
+    for (uint32_t x = 0; x < 4; x++) {
+      const uint32_t px = std::min(block_x * 4 + x, width - 1);
+      const uint32_t py = std::min(block_y * 4 + y, height - 1);
+      memcpy(block[y * 4 + x].data(), &rgba[(size_t(py) * width + px) * 4], 4);
+    }
+  }
+  return block;
+}
+
+// little endian bit stream over one 128 bit block
+struct BlockWriter {
+  uint64_t bits[2]{};
+  uint32_t position{0};
+
+  void put(uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++, position++) {
+      bits[position / 64] |= uint64_t((value >> i) & 1) << (position % 64);
+    }
+  }
+};
+
+struct Bc7Candidate {
+  // 7 bit endpoint colors plus the shared low bit of each endpoint
+  std::array<std::array<uint32_t, 4>, 2> endpoints;
+  std::array<uint32_t, 2> pbits;
+  std::array<uint32_t, 16> indices;
+  uint64_t error;
+};
+
+static uint32_t interpolate(uint32_t e0, uint32_t e1, uint32_t weight) {
+  return ((64 - weight) * e0 + weight * e1 + 32) >> 6;
+}
+
+// quantizes a float endpoint pair to mode 6 precision and picks the best index for every texel
+static Bc7Candidate evaluate_bc7(const Block& block, const std::array<std::array<float, 4>, 2>& ends) {
+  Bc7Candidate candidate{};
+
+  // each endpoint picks the low bit that lands its four channels closest to the requested color
+  std::array<std::array<uint32_t, 4>, 2> expanded;
+  for (uint32_t e = 0; e < 2; e++) {
+    float best_error = INFINITY;
+    for (uint32_t p = 0; p < 2; p++) {
+      std::array<uint32_t, 4> q;
+      float error = 0.f;
+      for (uint32_t c = 0; c < 4; c++) {
+        q[c] = uint32_t(std::clamp(std::lround((ends[e][c] - float(p)) * 0.5f), 0l, 127l));
+        const float d = float((q[c] << 1) | p) - ends[e][c];
+        error += d * d;
+      }
+      if (error < best_error) {
+        best_error = error;
+        candidate.endpoints[e] = q;
+        candidate.pbits[e] = p;
+      }
+    }
+    for (uint32_t c = 0; c < 4; c++) {
+      expanded[e][c] = (candidate.endpoints[e][c] << 1) | candidate.pbits[e];
+    }
+  }
+
+  std::array<std::array<uint32_t, 4>, 16> palette;
+  for (uint32_t i = 0; i < 16; i++) {
+    for (uint32_t c = 0; c < 4; c++) {
+      palette[i][c] = interpolate(expanded[0][c], expanded[1][c], BC7_WEIGHTS[i]);
+    }
+  }
+
+  for (uint32_t t = 0; t < 16; t++) {
+    uint64_t best_error = UINT64_MAX;
+    for (uint32_t i = 0; i < 16; i++) {
+      uint64_t error = 0;
+      for (uint32_t c = 0; c < 4; c++) {
+        const int64_t d = int64_t(palette[i][c]) - int64_t(block[t][c]);
+        error += uint64_t(d * d);
+      }
+      if (error < best_error) {
+        best_error = error;
+        candidate.indices[t] = i;
+      }
+    }
+    candidate.error += best_error;
+  }
+  return candidate;
+}
+
+// least squares endpoints for the current index assignment. returns false when every texel uses one weight
+static bool refit_bc7(const Block& block, const Bc7Candidate& candidate, std::array<std::array<float, 4>, 2>& ends) {
+  float aa = 0.f;
+  float ab = 0.f;
+  float bb = 0.f;
+  std::array<float, 4> ax{};
+  std::array<float, 4> bx{};
+  for (uint32_t t = 0; t < 16; t++) {
+    const float w = float(BC7_WEIGHTS[candidate.indices[t]]) / 64.f;
+    aa += (1.f - w) * (1.f - w);
+    ab += (1.f - w) * w;
+    bb += w * w;
+    for (uint32_t c = 0; c < 4; c++) {
+      ax[c] += (1.f - w) * block[t][c];
+      bx[c] += w * block[t][c];
+    }
+  }
+
+  const float det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f) {
+    return false;
+  }
+  for (uint32_t c = 0; c < 4; c++) {
+    ends[0][c] = std::clamp((ax[c] * bb - bx[c] * ab) / det, 0.f, 255.f);
+    ends[1][c] = std::clamp((bx[c] * aa - ax[c] * ab) / det, 0.f, 255.f);
+  }
+  return true;
+}
+
+static void encode_bc7_block(const Block& block, std::byte* out) {
+  std::array<float, 4> mean{};
+  for (const auto& texel : block) {
+    for (uint32_t c = 0; c < 4; c++) {
+      mean[c] += texel[c] / 16.f;
+    }
+  }
+
+  float covariance[4][4]{};
+  for (const auto& texel : block) {
+    for (uint32_t i = 0; i < 4; i++) {
+      for (uint32_t j = 0; j < 4; j++) {
+        covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+      }
+    }
+  }
+
+  // principal axis by power iteration, the endpoints are the extremes of the block projected onto it
+  std::array<float, 4> axis{1.f, 1.f, 1.f, 1.f};
+  for (uint32_t iteration = 0; iteration < 8; iteration++) {
+    std::array<float, 4> next{};
+    for (uint32_t i = 0; i < 4; i++) {
+      for (uint32_t j = 0; j < 4; j++) {
+        next[i] += covariance[i][j] * axis[j];
+      }
+    }
+    const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2] + next[3] * next[3]);
+    if (length < 1e-6f) {
+      break;
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+      axis[i] = next[i] / length;
+    }
+  }
+
+  float t_min = INFINITY;
+  float t_max = -INFINITY;
+  for (const auto& texel : block) {
+    float t = 0.f;
+    for (uint32_t c = 0; c < 4; c++) {
+      t += (texel[c] - mean[c]) * axis[c];
+    }
+    t_min = std::min(t_min, t);
+    t_max = std::max(t_max, t);
+  }
+
+  std::array<std::array<float, 4>, 2> ends;
+  for (uint32_t c = 0; c < 4; c++) {
+    ends[0][c] = std::clamp(mean[c] + axis[c] * t_min, 0.f, 255.f);
+    ends[1][c] = std::clamp(mean[c] + axis[c] * t_max, 0.f, 255.f);
+  }
+
+  Bc7Candidate best = evaluate_bc7(block, ends);
+  for (uint32_t iteration = 0; iteration < 2 && best.error > 0; iteration++) {
+    if (!refit_bc7(block, best, ends)) {
+      break;
+    }
+    Bc7Candidate refit = evaluate_bc7(block, ends);
+    if (refit.error >= best.error) {
+      break;
+    }
+    best = refit;
+  }
+
+  // the first texel's index drops its top bit, so the endpoints swap when it would need it
+  if (best.indices[0] >= 8) {
+    std::swap(best.endpoints[0], best.endpoints[1]);
+    std::swap(best.pbits[0], best.pbits[1]);
+    for (uint32_t& index : best.indices) {
+      index = 15 - index;
+    }
+  }
+
+  BlockWriter writer;
+  writer.put(1 << 6, 7);
+  for (uint32_t c = 0; c < 4; c++) {
+    writer.put(best.endpoints[0][c], 7);
+    writer.put(best.endpoints[1][c], 7);
+  }
+  writer.put(best.pbits[0], 1);
+  writer.put(best.pbits[1], 1);
+  writer.put(best.indices[0], 3);
+  for (uint32_t t = 1; t < 16; t++) {
+    writer.put(best.indices[t], 4);
+  }
+  memcpy(out, writer.bits, 16);
+}
+
+// one BC4 channel: two 8 bit endpoints and 3 bit indices into the 8 value ramp between them
+static void encode_bc4_block(const Block& block, uint32_t channel, std::byte* out) {
+  uint32_t hi = 0;
+  uint32_t lo = 255;
+  for (const auto& texel : block) {
+    hi = std::max<uint32_t>(hi, texel[channel]);
+    lo = std::min<uint32_t>(lo, texel[channel]);
+  }
+
+  uint64_t bits = hi | (lo << 8);
+  if (hi != lo) {
+    std::array<uint32_t, 8> palette{hi, lo};
+    for (uint32_t i = 2; i < 8; i++) {
+      palette[i] = ((8 - i) * hi + (i - 1) * lo + 3) / 7;
+    }
+
+    for (uint32_t t = 0; t < 16; t++) {
+      uint32_t best = 0;
+      uint32_t best_error = UINT32_MAX;
+      for (uint32_t i = 0; i < 8; i++) {
+        const uint32_t error = uint32_t(std::abs(int32_t(palette[i]) - int32_t(block[t][channel])));
+        if (error < best_error) {
+          best_error = error;
+          best = i;
+        }
+      }
+      bits |= uint64_t(best) << (16 + t * 3);
+    }
+  }
+  memcpy(out, &bits, 8);
+}
+
+std::vector<std::byte> encode_bc7(std::span<const uint8_t> rgba, uint32_t width, uint32_t height) {
+  const uint32_t blocks_x = (width + 3) / 4;
+  const uint32_t blocks_y = (height + 3) / 4;
+  std::vector<std::byte> blocks(size_t(blocks_x) * blocks_y * 16);
+
+  for (uint32_t y = 0; y < blocks_y; y++) {
+    for (uint32_t x = 0; x < blocks_x; x++) {
+      encode_bc7_block(load_block(rgba, width, height, x, y), &blocks[(size_t(y) * blocks_x + x) * 16]);
+    }
+  }
+  return blocks;
+}
+
+std::vector<std::byte> encode_bc5(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, uint32_t channel_r,
+                                  uint32_t channel_g) {
+  const uint32_t blocks_x = (width + 3) / 4;
+  const uint32_t blocks_y = (height + 3) / 4;
+  std::vector<std::byte> blocks(size_t(blocks_x) * blocks_y * 16);
+
+  for (uint32_t y = 0; y < blocks_y; y++) {
+    for (uint32_t x = 0; x < blocks_x; x++) {
+      const Block block = load_block(rgba, width, height, x, y);
+      std::byte* out = &blocks[(size_t(y) * blocks_x + x) * 16];
+      encode_bc4_block(block, channel_r, out);
+      encode_bc4_block(block, channel_g, out + 8);
+    }
+  }
+  return blocks;
+}
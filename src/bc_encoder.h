@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// block compression for the offline texture cooker. images are rgba8, tightly packed, and split into 4x4 blocks
+// row by row. blocks hanging over the right or bottom edge repeat the last row and column of the image
+
+// encodes every block with BC7 mode 6: one rgba endpoint pair with 4 bit indices. it's the single mode that covers
+// opaque and alpha blocks alike, which keeps the encoder small while staying well above BC1/BC3 quality
+std::vector<std::byte> encode_bc7(std::span<const uint8_t> rgba, uint32_t width, uint32_t height);
+
+// encodes two channels of the image as BC5. channel_r lands in the red half of each block, channel_g in the green
+std::vector<std::byte> encode_bc5(std::span<const uint8_t> rgba, uint32_t width, uint32_t height, uint32_t channel_r,
+                                  uint32_t channel_g);
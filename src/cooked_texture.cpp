@@ -0,0 +1,91 @@
+#include <cassert>
+#include <cooked_texture.h>
+#include <fmt/core.h>
+#include <hash.h>
+
+VkFormat cooked_texture_format(TextureRole role) {
+  // color stays unorm to sample exactly like the rgba8 images the loader makes from png and jpeg
+  return role == TextureRole::color ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC5_UNORM_BLOCK;
+}
+
+std::vector<std::optional<TextureRole>> image_roles(const fastgltf::Asset& asset) {
+  std::vector<std::optional<TextureRole>> roles(asset.images.size());
+
+  auto use = [&](size_t texture_index, TextureRole role) {
+    const std::optional<size_t>& image = asset.textures[texture_index].imageIndex;
+    if (!image.has_value()) {
+      return;
+    }
+    std::optional<TextureRole>& current = roles[*image];
+    current = current.has_value() && *current != role ? TextureRole::color : role;
+  };
+
+  for (const fastgltf::Material& material : asset.materials) {
+    if (material.pbrData.baseColorTexture.has_value()) {
+      use(material.pbrData.baseColorTexture->textureIndex, TextureRole::color);
+    }
+    if (material.emissiveTexture.has_value()) {
+      use(material.emissiveTexture->textureIndex, TextureRole::color);
+    }
+    if (material.occlusionTexture.has_value()) {
+      use(material.occlusionTexture->textureIndex, TextureRole::color);
+    }
+    if (material.normalTexture.has_value()) {
+      use(material.normalTexture->textureIndex, TextureRole::normal);
+    }
+    if (material.pbrData.metallicRoughnessTexture.has_value()) {
+      use(material.pbrData.metallicRoughnessTexture->textureIndex, TextureRole::metal_rough);
+    }
+  }
+  return roles;
+}
+
+std::span<const std::byte> image_source_bytes(const fastgltf::Asset& asset, const fastgltf::Image& image,
+                                              MappedFile& storage,
+                                              std::span<const std::span<const std::byte>> buffers) {
+  std::span<const std::byte> bytes;
+
+  std::visit(fastgltf::visitor{
+                 [](const auto& arg) {},
+                 [&](const fastgltf::sources::URI& file_path) {
+                   assert(file_path.fileByteOffset == 0); // We don't support offsets.
+                   assert(file_path.uri.isLocalPath());   // We're only capable of loading local files.
+
+                   const std::string path(file_path.uri.path().begin(), file_path.uri.path().end());
+                   if (storage.open(path)) {
+                     bytes = storage.bytes();
+                   }
+                 },
+                 [&](const fastgltf::sources::Array& vector) {
+                   bytes = std::as_bytes(std::span(vector.bytes.data(), vector.bytes.size()));
+                 },
+                 [&](const fastgltf::sources::BufferView& view) {
+                   const fastgltf::BufferView& buffer_view = asset.bufferViews[view.bufferViewIndex];
+                   const fastgltf::Buffer& buffer = asset.buffers[buffer_view.bufferIndex];
+                   if (!buffers.empty()) {
+                     bytes = buffers[buffer_view.bufferIndex].subspan(buffer_view.byteOffset, buffer_view.byteLength);
+                     return;
+                   }
+
+                   // LoadExternalBuffers and LoadGLBBuffers leave every buffer in an array
+                   std::visit(fastgltf::visitor{[](const auto& arg) {},
+                                                [&](const fastgltf::sources::Array& vector) {
+                                                  bytes = std::as_bytes(std::span(vector.bytes.data(),
+                                                                                  vector.bytes.size()))
+                                                              .subspan(buffer_view.byteOffset,
+                                                                       buffer_view.byteLength);
+                                                }},
+                              buffer.data);
+                 },
+             },
+             image.data);
+
+  return bytes;
+}
+
+std::filesystem::path cooked_texture_path(uint64_t source_hash, TextureRole role,
+                                          const std::filesystem::path& cache_dir) {
+  uint64_t key = hash_combine(source_hash, static_cast<uint64_t>(role));
+  key = hash_combine(key, TEXTURE_COOKER_VERSION);
+  return cache_dir / fmt::format("{:016x}.ktx2", key);
+}
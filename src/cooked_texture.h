@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <fastgltf/types.hpp>
+#include <filesystem>
+#include <mapped_file.h>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// cooked textures live beside the mesh cache, relative to the build dir
+constexpr const char* TEXTURE_CACHE_DIR = "../../cache/textures";
+// bump whenever the encoders or the mip filtering change so stale cooked textures are ignored
+constexpr uint32_t TEXTURE_COOKER_VERSION = 1;
+
+// how a glTF image is sampled, which decides the compressed format it is cooked into
+enum class TextureRole : uint8_t {
+  // BC7, everything that isn't one of the two channel roles below
+  color,
+  // BC5 holding the tangent space x and y, z is rebuilt from them
+  normal,
+  // BC5 holding roughness (glTF green) in red and metalness (glTF blue) in green
+  metal_rough,
+};
+
+VkFormat cooked_texture_format(TextureRole role);
+
+// role of every image a material references, indexed like asset.images. an image used in two incompatible ways,
+// like an occlusion-roughness-metal pack, falls back to color so no channel is dropped
+std::vector<std::optional<TextureRole>> image_roles(const fastgltf::Asset& asset);
+
+// encoded bytes of an image, png or jpeg or KTX2, wherever fastgltf put them. external files are mapped into
+// storage, which has to outlive the span. images in buffer views read from buffers when it is given, indexed like
+// asset.buffers, otherwise from buffers fastgltf loaded. empty when the source can't be read
+std::span<const std::byte> image_source_bytes(const fastgltf::Asset& asset, const fastgltf::Image& image,
+                                              MappedFile& storage,
+                                              std::span<const std::span<const std::byte>> buffers = {});
+
+// cooked entry for a source image, from hash_bytes of its encoded bytes. the key also covers the role and the
+// cooker version, so the same texture is cooked once no matter how many scenes use it
+std::filesystem::path cooked_texture_path(uint64_t source_hash, TextureRole role,
+                                          const std::filesystem::path& cache_dir = TEXTURE_CACHE_DIR);
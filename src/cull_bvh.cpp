@@ -0,0 +1,141 @@
+#include <algorithm>
+#include <cmath>
+#include <cull_bvh.h>
+#include <glm/common.hpp>
+#include <glm/geometric.hpp>
+
+void CullBvh::build(const CullSpheres& spheres, size_t count, std::vector<uint32_t>& order) {
+  // the centers are copied next to their index, so the partitioning doesn't jump around the sphere arrays
+  std::vector<BuildItem> items(count);
+  for (uint32_t i = 0; i < count; i++) {
+    items[i] = BuildItem{glm::vec3{spheres.x[i], spheres.y[i], spheres.z[i]}, i};
+  }
+
+  _nodes.clear();
+  _item_count = count;
+  if (count > 0) {
+    _nodes.reserve(2 * (count / LEAF_SIZE) + 1);
+    build_node(items, 0, static_cast<uint32_t>(count));
+  }
+
+  order.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    order[i] = items[i].index;
+  }
+}
+
+// median split on the longest axis of the item centers. the items are partitioned in place, so both halves stay
+// ranges. the boxes are fitted by refit once the spheres are in order
+uint32_t CullBvh::build_node(std::vector<BuildItem>& items, uint32_t first, uint32_t count) {
+  const uint32_t index = static_cast<uint32_t>(_nodes.size());
+  _nodes.push_back(Node{glm::vec3{0.f}, first, glm::vec3{0.f}, count, 0});
+  if (count <= LEAF_SIZE) {
+    return index;
+  }
+
+  glm::vec3 center_min{INFINITY};
+  glm::vec3 center_max{-INFINITY};
+  for (uint32_t i = first; i < first + count; i++) {
+    center_min = glm::min(center_min, items[i].center);
+    center_max = glm::max(center_max, items[i].center);
+  }
+  const glm::vec3 extent = center_max - center_min;
+  const int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+
+  const uint32_t half = count / 2;
+  std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+                   [axis](const BuildItem& a, const BuildItem& b) { return a.center[axis] < b.center[axis]; });
+
+  build_node(items, first, half);
+  const uint32_t right = build_node(items, first + half, count - half);
+  _nodes[index].right = right;
+  return index;
+}
+
+void CullBvh::refit(const CullSpheres& spheres) {
+  // children always come after their parent, so walking backwards fits them first
+  for (size_t i = _nodes.size(); i-- > 0;) {
+    Node& node = _nodes[i];
+    if (node.right != 0) {
+      node.min = glm::min(_nodes[i + 1].min, _nodes[node.right].min);
+      node.max = glm::max(_nodes[i + 1].max, _nodes[node.right].max);
+      continue;
+    }
+    node.min = glm::vec3{INFINITY};
+    node.max = glm::vec3{-INFINITY};
+    for (uint32_t item = node.first; item < node.first + node.count; item++) {
+      const glm::vec3 center{spheres.x[item], spheres.y[item], spheres.z[item]};
+      const glm::vec3 radius{spheres.radius[item]};
+      node.min = glm::min(node.min, center - radius);
+      node.max = glm::max(node.max, center + radius);
+    }
+  }
+}
+
+void CullBvh::clear() {
+  _nodes.clear();
+  _item_count = 0;
+}
+
+void CullBvh::split(size_t count, std::vector<uint32_t>& roots) const {
+  roots.clear();
+  if (_nodes.empty()) {
+    return;
+  }
+
+  // the largest subtree is opened up until there are enough, so the roots hold similar sphere counts
+  roots.push_back(0);
+  while (roots.size() < count) {
+    auto largest = std::max_element(roots.begin(), roots.end(),
+                                    [&](uint32_t a, uint32_t b) { return _nodes[a].count < _nodes[b].count; });
+    const uint32_t right = _nodes[*largest].right;
+    if (right == 0) {
+      break;
+    }
+    *largest = *largest + 1;
+    roots.push_back(right);
+  }
+}
+
+void CullBvh::cull(const Frustum& frustum, const CullSpheres& spheres, uint32_t root,
+                   std::vector<uint32_t>& visible) const {
+  // median splits keep the tree under 32 levels, and the stack holds at most one waiting node per level
+  uint32_t stack[64];
+  uint32_t stack_size = 0;
+  stack[stack_size++] = root;
+
+  while (stack_size > 0) {
+    const uint32_t index = stack[--stack_size];
+    const Node& node = _nodes[index];
+
+    // the box corner furthest along each plane's normal decides outside, the nearest one inside
+    const glm::vec3 center = (node.min + node.max) * 0.5f;
+    const glm::vec3 extent = (node.max - node.min) * 0.5f;
+    bool outside = false;
+    bool inside = true;
+    for (const glm::vec4& plane : frustum.planes) {
+      const float distance = glm::dot(glm::vec3(plane), center) + plane.w;
+      const float reach = glm::dot(glm::abs(glm::vec3(plane)), extent);
+      if (distance + reach < 0.f) {
+        outside = true;
+        break;
+      }
+      inside = inside && distance - reach >= 0.f;
+    }
+    if (outside) {
+      continue;
+    }
+
+    if (inside) {
+      for (uint32_t item = node.first; item < node.first + node.count; item++) {
+        visible.push_back(item);
+      }
+    } else if (node.right == 0) {
+      cull_spheres(frustum, spheres, visible, node.first, node.first + node.count);
+    } else {
+      // left first, so the spheres come out in order
+      stack[stack_size++] = node.right;
+      stack[stack_size++] = index + 1;
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <frustum_cull.h>
+#include <glm/vec3.hpp>
+#include <vector>
+
+// bounding volume hierarchy over a prefix of a CullSpheres array, for culling scenes where most objects are off
+// screen. a subtree found fully outside the frustum is skipped and one found fully inside is taken whole, each with
+// a single box test. nodes are laid out depth first, and the spheres are expected in the tree's order, so every
+// subtree covers one range of them
+class CullBvh {
+public:
+  // builds over spheres 0 to count - 1. order receives the tree's sphere order: whatever sphere order[i] is has to be
+  // moved to index i, and refit called with the moved spheres, before the tree is used
+  void build(const CullSpheres& spheres, size_t count, std::vector<uint32_t>& order);
+  // recomputes every node's box after spheres moved, keeping the tree's shape
+  void refit(const CullSpheres& spheres);
+  void clear();
+
+  // spheres the tree covers, the ones from here on have to be culled another way
+  size_t item_count() const { return _item_count; }
+
+  // nodes whose subtrees together cover every sphere once, at least count of them when the tree has that many
+  // leaves. they can be culled independently
+  void split(size_t count, std::vector<uint32_t>& roots) const;
+  // appends every sphere of the subtree at root that is at least partly inside the frustum to visible, in
+  // increasing order
+  void cull(const Frustum& frustum, const CullSpheres& spheres, uint32_t root, std::vector<uint32_t>& visible) const;
+
+private:
+  // two groups of the avx2 kernel
+  static constexpr uint32_t LEAF_SIZE = 16;
+
+  struct Node {
+    glm::vec3 min;
+    // spheres of the subtree, first to first + count - 1
+    uint32_t first;
+    glm::vec3 max;
+    uint32_t count;
+    // the left child is the next node. 0 for leaves, the root is never a right child
+    uint32_t right;
+  };
+
+  struct BuildItem {
+    glm::vec3 center;
+    uint32_t index;
+  };
+
+  uint32_t build_node(std::vector<BuildItem>& items, uint32_t first, uint32_t count);
+
+  std::vector<Node> _nodes;
+  size_t _item_count{0};
+};
@@ -0,0 +1,164 @@
+#include <algorithm>
+#include <bit>
+#include <frustum_cull.h>
+#include <glm/geometric.hpp>
+#include <glm/matrix.hpp>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define FRUSTUM_CULL_AVX2
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define AVX2_TARGET
+#else
+// only the kernel is built for avx2, the rest of the binary still runs on any x86-64 cpu
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+Frustum extract_frustum(const glm::mat4& viewproj) {
+  const glm::mat4 rows = glm::transpose(viewproj);
+  Frustum frustum{{rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2],
+                   rows[3] - rows[2]}};
+  for (glm::vec4& plane : frustum.planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+void CullSpheres::push_back(const glm::vec4& sphere) {
+  x.push_back(sphere.x);
+  y.push_back(sphere.y);
+  z.push_back(sphere.z);
+  radius.push_back(sphere.w);
+}
+
+void CullSpheres::set(size_t index, const glm::vec4& sphere) {
+  x[index] = sphere.x;
+  y[index] = sphere.y;
+  z[index] = sphere.z;
+  radius[index] = sphere.w;
+}
+
+void CullSpheres::swap_remove(size_t index) {
+  for (std::vector<float>* array : {&x, &y, &z, &radius}) {
+    (*array)[index] = array->back();
+    array->pop_back();
+  }
+}
+
+void CullSpheres::clear() {
+  x.clear();
+  y.clear();
+  z.clear();
+  radius.clear();
+}
+
+glm::vec4 transform_sphere(const glm::vec3& origin, float radius, const glm::mat4& transform) {
+  const glm::vec3 center = glm::vec3(transform * glm::vec4(origin, 1.f));
+  const float scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                glm::length(glm::vec3(transform[2]))});
+  return glm::vec4(center, radius * scale);
+}
+
+void cull_spheres_scalar(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible,
+                         size_t first, size_t end) {
+  end = std::min(end, spheres.size());
+  for (size_t i = first; i < end; i++) {
+    bool inside = true;
+    for (const glm::vec4& plane : frustum.planes) {
+      const float distance = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] + plane.w;
+      if (!(distance >= -spheres.radius[i])) {
+        inside = false;
+        break;
+      }
+    }
+    if (inside) {
+      visible.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+#ifdef FRUSTUM_CULL_AVX2
+AVX2_TARGET static void cull_avx2(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible,
+                                  size_t first, size_t end) {
+  // every plane component broadcast to all 8 lanes
+  __m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+  for (int p = 0; p < 6; p++) {
+    plane_x[p] = _mm256_set1_ps(frustum.planes[p].x);
+    plane_y[p] = _mm256_set1_ps(frustum.planes[p].y);
+    plane_z[p] = _mm256_set1_ps(frustum.planes[p].z);
+    plane_w[p] = _mm256_set1_ps(frustum.planes[p].w);
+  }
+
+  size_t i = first;
+  for (; i + 8 <= end; i += 8) {
+    const __m256 x = _mm256_loadu_ps(spheres.x.data() + i);
+    const __m256 y = _mm256_loadu_ps(spheres.y.data() + i);
+    const __m256 z = _mm256_loadu_ps(spheres.z.data() + i);
+    const __m256 neg_radius = _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.radius.data() + i));
+
+    // same operation order as the scalar kernel, so both agree on spheres right at a plane
+    __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+    for (int p = 0; p < 6; p++) {
+      __m256 distance = _mm256_mul_ps(plane_x[p], x);
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_y[p], y));
+      distance = _mm256_add_ps(distance, _mm256_mul_ps(plane_z[p], z));
+      distance = _mm256_add_ps(distance, plane_w[p]);
+      inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, neg_radius, _CMP_GE_OQ));
+    }
+
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+    while (mask != 0) {
+      visible.push_back(static_cast<uint32_t>(i) + std::countr_zero(mask));
+      mask &= mask - 1;
+    }
+  }
+  // the last partial group
+  cull_spheres_scalar(frustum, spheres, visible, i, end);
+}
+#endif
+
+bool cull_spheres_avx2_supported() {
+#if defined(FRUSTUM_CULL_AVX2) && defined(_MSC_VER) && !defined(__clang__)
+  static const bool supported = []() {
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+      return false;
+    }
+    // the os has to save the ymm registers too
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+      return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+  }();
+  return supported;
+#elif defined(FRUSTUM_CULL_AVX2)
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+void cull_spheres_avx2(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible,
+                       size_t first, size_t end) {
+#ifdef FRUSTUM_CULL_AVX2
+  cull_avx2(frustum, spheres, visible, first, std::min(end, spheres.size()));
+#else
+  cull_spheres_scalar(frustum, spheres, visible, first, end);
+#endif
+}
+
+void cull_spheres(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible, size_t first,
+                  size_t end) {
+  if (cull_spheres_avx2_supported()) {
+    cull_spheres_avx2(frustum, spheres, visible, first, end);
+  } else {
+    cull_spheres_scalar(frustum, spheres, visible, first, end);
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <vector>
+
+// normalized planes of a view frustum with the normals pointing inwards. a point p is on the inner side of a plane
+// when dot(plane.xyz, p) + plane.w >= 0
+struct Frustum {
+  // left, right, bottom, top, then the planes at depth 0 and depth 1
+  std::array<glm::vec4, 6> planes;
+};
+
+// planes of the 0 to 1 depth clip volume viewproj maps to, in the space viewproj transforms from
+Frustum extract_frustum(const glm::mat4& viewproj);
+
+// bounding spheres, structure of arrays so the cull kernel loads 8 of each at once
+struct CullSpheres {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+  std::vector<float> radius;
+
+  size_t size() const { return x.size(); }
+  // spheres are passed as center and radius in w
+  glm::vec4 get(size_t index) const { return glm::vec4(x[index], y[index], z[index], radius[index]); }
+  void push_back(const glm::vec4& sphere);
+  void set(size_t index, const glm::vec4& sphere);
+  // the last sphere takes index's place
+  void swap_remove(size_t index);
+  void clear();
+};
+
+// sphere around an object space sphere once it is transformed, scaled by the largest axis scale
+glm::vec4 transform_sphere(const glm::vec3& origin, float radius, const glm::mat4& transform);
+
+// appends the index of every sphere from first up to end that is at least partly inside the frustum to visible, in
+// increasing order. 8 spheres are tested at a time when the cpu has avx2
+void cull_spheres(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible,
+                  size_t first = 0, size_t end = SIZE_MAX);
+
+// the kernels cull_spheres picks from. the avx2 one may only be called when cull_spheres_avx2_supported()
+bool cull_spheres_avx2_supported();
+void cull_spheres_scalar(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible,
+                         size_t first = 0, size_t end = SIZE_MAX);
+void cull_spheres_avx2(const Frustum& frustum, const CullSpheres& spheres, std::vector<uint32_t>& visible,
+                       size_t first = 0, size_t end = SIZE_MAX);
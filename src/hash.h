@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+// fast non cryptographic 64 bit hash for cache keys. reads 8 bytes at a time so hashing whole asset files
+// stays well below the cost of loading them
+inline uint64_t hash_bytes(std::span<const std::byte> bytes, uint64_t seed = 0) {
+  constexpr uint64_t mul_a = 0x9E3779B97F4A7C15ull;
+  constexpr uint64_t mul_b = 0xFF51AFD7ED558CCDull;
+
+  uint64_t h = seed ^ (bytes.size() * mul_a);
+
+  auto mix = [&](uint64_t k) {
+    k *= mul_a;
+    k ^= k >> 32;
+    h = (h ^ k) * mul_b;
+    h ^= h >> 29;
+  };
+
+  size_t i = 0;
+  for (; i + 8 <= bytes.size(); i += 8) {
+    uint64_t k;
+    memcpy(&k, bytes.data() + i, 8);
+    mix(k);
+  }
+
+  if (i < bytes.size()) {
+    uint64_t k = 0;
+    memcpy(&k, bytes.data() + i, bytes.size() - i);
+    mix(k);
+  }
+
+  h ^= h >> 33;
+  h *= mul_b;
+  h ^= h >> 33;
+  return h;
+}
+
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0) {
+  return hash_bytes(std::span<const std::byte>((const std::byte*)data, size), seed);
+}
+
+inline uint64_t hash_combine(uint64_t seed, uint64_t value) {
+  return seed ^ (value + 0x9E3779B97F4A7C15ull + (seed << 6) + (seed >> 2));
+}
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fmt/core.h>
+#include <fstream>
+#include <ktx2.h>
+
+constexpr std::byte KTX2_IDENTIFIER[12]{std::byte{0xAB}, std::byte{0x4B}, std::byte{0x54}, std::byte{0x58},
+                                        std::byte{0x20}, std::byte{0x32}, std::byte{0x30}, std::byte{0xBB},
+                                        std::byte{0x0D}, std::byte{0x0A}, std::byte{0x1A}, std::byte{0x0A}};
+
+// supercompressionScheme values from the KTX2 spec
+constexpr uint32_t KTX2_SUPERCOMPRESSION_NONE = 0;
+constexpr uint32_t KTX2_SUPERCOMPRESSION_BASIS_LZ = 1;
+
+// data format descriptor values from the khronos data format spec
+constexpr uint32_t KHR_DF_MODEL_BC1A = 128;
+constexpr uint32_t KHR_DF_MODEL_BC3 = 130;
+constexpr uint32_t KHR_DF_MODEL_BC5 = 132;
+constexpr uint32_t KHR_DF_MODEL_BC7 = 134;
+constexpr uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+constexpr uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+constexpr uint32_t KHR_DF_TRANSFER_SRGB = 2;
+constexpr uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+
+// file header as laid out by the spec, everything little endian
+struct Ktx2Header {
+  std::byte identifier[12];
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+static_assert(sizeof(Ktx2Header) == 80);
+
+struct Ktx2LevelIndex {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+bool is_ktx2(std::span<const std::byte> file) {
+  return file.size() >= sizeof(KTX2_IDENTIFIER) && memcmp(file.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+}
+
+uint32_t bc_block_size(VkFormat format) {
+  switch (format) {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    return 8;
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+  case VK_FORMAT_BC5_SNORM_BLOCK:
+  case VK_FORMAT_BC7_UNORM_BLOCK:
+  case VK_FORMAT_BC7_SRGB_BLOCK:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+std::optional<Ktx2Image> read_ktx2(std::span<const std::byte> file) {
+  if (!is_ktx2(file) || file.size() < sizeof(Ktx2Header)) {
+    fmt::println("ktx2: not a KTX2 file");
+    return {};
+  }
+
+  Ktx2Header header;
+  memcpy(&header, file.data(), sizeof(header));
+
+  if (header.supercompression_scheme == KTX2_SUPERCOMPRESSION_BASIS_LZ || header.vk_format == VK_FORMAT_UNDEFINED) {
+    fmt::println("ktx2: basis universal textures have to be transcoded to BC before loading");
+    return {};
+  }
+  if (header.supercompression_scheme != KTX2_SUPERCOMPRESSION_NONE) {
+    fmt::println("ktx2: supercompression scheme {} is not supported", header.supercompression_scheme);
+    return {};
+  }
+
+  const VkFormat format = static_cast<VkFormat>(header.vk_format);
+  const uint32_t block_size = bc_block_size(format);
+  if (block_size == 0) {
+    fmt::println("ktx2: vkFormat {} is not a supported block compressed format", header.vk_format);
+    return {};
+  }
+  if (header.pixel_width == 0 || header.pixel_height == 0 || header.pixel_depth > 1 || header.layer_count > 1 ||
+      header.face_count != 1) {
+    fmt::println("ktx2: only single layer 2d textures are supported");
+    return {};
+  }
+
+  // a level count of 0 asks the loader to generate mips, which block compressed formats can't do with blits
+  const uint32_t level_count = std::max(header.level_count, 1u);
+  const uint32_t max_levels = std::bit_width(std::max(header.pixel_width, header.pixel_height));
+  if (level_count > max_levels || file.size() < sizeof(Ktx2Header) + size_t(level_count) * sizeof(Ktx2LevelIndex)) {
+    fmt::println("ktx2: invalid level index");
+    return {};
+  }
+
+  std::vector<Ktx2LevelIndex> levels(level_count);
+  memcpy(levels.data(), file.data() + sizeof(Ktx2Header), levels.size() * sizeof(Ktx2LevelIndex));
+
+  // levels are stored smallest first, so the data of the whole chain is one contiguous range of the file
+  uint64_t data_begin = UINT64_MAX;
+  uint64_t data_end = 0;
+  for (uint32_t level = 0; level < level_count; level++) {
+    const uint64_t blocks_x = (std::max(header.pixel_width >> level, 1u) + 3) / 4;
+    const uint64_t blocks_y = (std::max(header.pixel_height >> level, 1u) + 3) / 4;
+    const Ktx2LevelIndex& index = levels[level];
+    if (index.byte_length != blocks_x * blocks_y * block_size || index.byte_offset % block_size != 0 ||
+        index.byte_offset > file.size() || index.byte_length > file.size() - index.byte_offset) {
+      fmt::println("ktx2: level {} has the wrong size or lies outside the file", level);
+      return {};
+    }
+    data_begin = std::min(data_begin, index.byte_offset);
+    data_end = std::max(data_end, index.byte_offset + index.byte_length);
+  }
+
+  Ktx2Image image{};
+  image.format = format;
+  image.width = header.pixel_width;
+  image.height = header.pixel_height;
+  image.data.assign(file.begin() + data_begin, file.begin() + data_end);
+  image.level_offsets.resize(level_count);
+  for (uint32_t level = 0; level < level_count; level++) {
+    image.level_offsets[level] = levels[level].byte_offset - data_begin;
+  }
+  return image;
+}
+
+static bool is_srgb(VkFormat format) {
+  return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+         format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+}
+
+// basic data format descriptor for one 4x4 block. BC5 is described as two 64 bit halves, red then green, and the
+// other models as a single sample covering the block with the alpha half of BC3 as its own sample
+static std::vector<uint32_t> block_dfd(VkFormat format) {
+  struct Sample {
+    uint32_t bit_offset;
+    uint32_t bit_length;
+    uint32_t channel;
+  };
+
+  uint32_t model;
+  std::vector<Sample> samples;
+  switch (format) {
+  case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+  case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+  case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+    model = KHR_DF_MODEL_BC1A;
+    samples = {{0, 64, 0}};
+    break;
+  case VK_FORMAT_BC3_UNORM_BLOCK:
+  case VK_FORMAT_BC3_SRGB_BLOCK:
+    model = KHR_DF_MODEL_BC3;
+    samples = {{0, 64, KHR_DF_CHANNEL_ALPHA}, {64, 64, 0}};
+    break;
+  case VK_FORMAT_BC5_UNORM_BLOCK:
+  case VK_FORMAT_BC5_SNORM_BLOCK:
+    model = KHR_DF_MODEL_BC5;
+    samples = {{0, 64, 0}, {64, 64, 1}};
+    break;
+  default:
+    model = KHR_DF_MODEL_BC7;
+    samples = {{0, 128, 0}};
+    break;
+  }
+
+  const uint32_t block_size = 24 + 16 * uint32_t(samples.size());
+  const uint32_t transfer = is_srgb(format) ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR;
+
+  std::vector<uint32_t> dfd;
+  dfd.push_back(4 + block_size);
+  // vendor khronos, descriptor type basic, version 2
+  dfd.push_back(0);
+  dfd.push_back(2 | (block_size << 16));
+  dfd.push_back(model | (KHR_DF_PRIMARIES_BT709 << 8) | (transfer << 16));
+  // texel block dimensions are stored minus one
+  dfd.push_back(3 | (3 << 8));
+  dfd.push_back(bc_block_size(format));
+  dfd.push_back(0);
+  for (const Sample& sample : samples) {
+    dfd.push_back(sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+    dfd.push_back(0);
+    dfd.push_back(0);
+    dfd.push_back(UINT32_MAX);
+  }
+  return dfd;
+}
+
+bool write_ktx2(const std::filesystem::path& path, VkFormat format, uint32_t width, uint32_t height,
+                std::span<const std::vector<std::byte>> levels) {
+  const uint32_t block_size = bc_block_size(format);
+  if (block_size == 0 || levels.empty()) {
+    return false;
+  }
+
+  const std::vector<uint32_t> dfd = block_dfd(format);
+
+  Ktx2Header header{};
+  memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+  header.vk_format = format;
+  header.type_size = 1;
+  header.pixel_width = width;
+  header.pixel_height = height;
+  header.face_count = 1;
+  header.level_count = static_cast<uint32_t>(levels.size());
+  header.supercompression_scheme = KTX2_SUPERCOMPRESSION_NONE;
+  header.dfd_byte_offset = static_cast<uint32_t>(sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2LevelIndex));
+  header.dfd_byte_length = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+  // level data starts block aligned after the descriptor and is laid out smallest level first
+  uint64_t offset = header.dfd_byte_offset + header.dfd_byte_length;
+  const uint64_t data_begin = (offset + block_size - 1) / block_size * block_size;
+  offset = data_begin;
+  std::vector<Ktx2LevelIndex> index(levels.size());
+  for (size_t level = levels.size(); level-- > 0;) {
+    index[level].byte_offset = offset;
+    index[level].byte_length = levels[level].size();
+    index[level].uncompressed_byte_length = levels[level].size();
+    offset += levels[level].size();
+  }
+
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  std::filesystem::path tmp_path = path;
+  tmp_path += ".tmp";
+
+  std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+  if (!out.is_open()) {
+    return false;
+  }
+
+  const char zeros[16]{};
+  out.write((const char*)&header, sizeof(header));
+  out.write((const char*)index.data(), index.size() * sizeof(Ktx2LevelIndex));
+  out.write((const char*)dfd.data(), dfd.size() * sizeof(uint32_t));
+  out.write(zeros, data_begin - (header.dfd_byte_offset + header.dfd_byte_length));
+  for (size_t level = levels.size(); level-- > 0;) {
+    out.write((const char*)levels[level].data(), levels[level].size());
+  }
+  out.close();
+
+  if (!out) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  std::filesystem::rename(tmp_path, path, ec);
+  return !ec;
+}
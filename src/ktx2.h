@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// 2d block compressed texture read out of a KTX2 container, ready to be copied into an image of the same format
+struct Ktx2Image {
+  VkFormat format;
+  uint32_t width;
+  uint32_t height;
+  // every mip level the file holds, copied out as one block
+  std::vector<std::byte> data;
+  // where each mip level starts in data, level 0 is full size
+  std::vector<VkDeviceSize> level_offsets;
+};
+
+// checks the 12 byte KTX2 identifier
+bool is_ktx2(std::span<const std::byte> file);
+
+// reads a single face, single layer 2d texture stored as BC1, BC3, BC5 or BC7 without supercompression. basis
+// universal payloads need transcoding first, they are rejected like every other unsupported file
+std::optional<Ktx2Image> read_ktx2(std::span<const std::byte> file);
+
+// bytes per 4x4 block for the formats read_ktx2 accepts, 0 for anything else
+uint32_t bc_block_size(VkFormat format);
+
+// writes a block compressed 2d texture with its mip chain, level 0 first, in the layout read_ktx2 accepts. the file
+// is written beside path and renamed into place so a reader never sees half of it
+bool write_ktx2(const std::filesystem::path& path, VkFormat format, uint32_t width, uint32_t height,
+                std::span<const std::vector<std::byte>> levels);
@@ -0,0 +1,69 @@
+#include <fcntl.h>
+#include <mapped_file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : _data(std::exchange(other._data, nullptr)), _size(std::exchange(other._size, 0)),
+      _padding(std::exchange(other._padding, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    close();
+    _data = std::exchange(other._data, nullptr);
+    _size = std::exchange(other._size, 0);
+    _padding = std::exchange(other._padding, 0);
+  }
+  return *this;
+}
+
+bool MappedFile::open(const std::filesystem::path& path, size_t padding) {
+  close();
+
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // pages past the end of a file fault when read, so the padding is anonymous memory the file is mapped over
+  void* mapping = MAP_FAILED;
+  if (padding == 0) {
+    mapping = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  } else {
+    void* reserved = mmap(nullptr, file_stat.st_size + padding, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved != MAP_FAILED) {
+      mapping = mmap(reserved, file_stat.st_size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0);
+      if (mapping == MAP_FAILED) {
+        munmap(reserved, file_stat.st_size + padding);
+      }
+    }
+  }
+  // the mapping keeps its own reference to the file
+  ::close(fd);
+
+  if (mapping == MAP_FAILED) {
+    return false;
+  }
+
+  _data = (const std::byte*)mapping;
+  _size = file_stat.st_size;
+  _padding = padding;
+  return true;
+}
+
+void MappedFile::close() {
+  if (_data != nullptr) {
+    munmap((void*)_data, _size + _padding);
+    _data = nullptr;
+    _size = 0;
+    _padding = 0;
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+
+// read only memory mapping of a whole file
+class MappedFile {
+public:
+  MappedFile() = default;
+  ~MappedFile() { close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  // padding zeroed bytes stay readable past the end of the file, for parsers that read ahead
+  bool open(const std::filesystem::path& path, size_t padding = 0);
+  void close();
+
+  bool is_open() const { return _data != nullptr; }
+  const std::byte* data() const { return _data; }
+  size_t size() const { return _size; }
+  std::span<const std::byte> bytes() const { return {_data, _size}; }
+
+private:
+  const std::byte* _data{nullptr};
+  size_t _size{0};
+  size_t _padding{0};
+};
@@ -0,0 +1,145 @@
+#include <chrono>
+#include <hash.h>
+#include <mapped_gltf.h>
+#include <meshopt_decoder.h>
+#include <string>
+#include <sys/resource.h>
+
+fastgltf::Error MappedGltf::load(fastgltf::Parser& parser, const std::filesystem::path& path,
+                                 fastgltf::Options options) {
+  // simdjson reads a few bytes past the end of the json, the padding keeps that inside the mapping
+  if (!_file.open(path, fastgltf::getGltfBufferPadding())) {
+    return fastgltf::Error::InvalidPath;
+  }
+
+  // the data buffer only borrows the mapping, which parsing never writes to
+  fastgltf::GltfDataBuffer data;
+  data.fromByteView(const_cast<std::uint8_t*>(reinterpret_cast<const std::uint8_t*>(_file.data())), _file.size(),
+                    _file.size() + fastgltf::getGltfBufferPadding());
+
+  auto load = parser.loadGltf(&data, path.parent_path(), options);
+  if (!load) {
+    return load.error();
+  }
+  _asset = std::move(load.get());
+
+  // without the load options a GLB chunk is a view into the file and external files stay uris. data uris are
+  // base64 so fastgltf always decodes those into arrays
+  _buffer_files.resize(_asset.buffers.size());
+  _buffers.resize(_asset.buffers.size());
+  _decoded.resize(_asset.buffers.size());
+  for (size_t i = 0; i < _asset.buffers.size(); i++) {
+    const fastgltf::Buffer& buffer = _asset.buffers[i];
+    bool mapped = false;
+    std::visit(fastgltf::visitor{
+                   [](const auto& arg) {},
+                   [&](const fastgltf::sources::ByteView& view) {
+                     _buffers[i] = view.bytes;
+                     mapped = true;
+                   },
+                   [&](const fastgltf::sources::Array& array) {
+                     _buffers[i] = std::as_bytes(std::span(array.bytes.data(), array.bytes.size()));
+                     mapped = true;
+                   },
+                   [&](const fastgltf::sources::Fallback&) {
+                     // only there for loaders without EXT_meshopt_compression, filled in by decode_compressed_views
+                     _decoded[i] = std::make_unique_for_overwrite<std::byte[]>(buffer.byteLength);
+                     _buffers[i] = std::span(_decoded[i].get(), buffer.byteLength);
+                     mapped = true;
+                   },
+                   [&](const fastgltf::sources::URI& uri) {
+                     if (!uri.uri.isLocalPath()) {
+                       return;
+                     }
+                     const std::string file(uri.uri.path().begin(), uri.uri.path().end());
+                     if (_buffer_files[i].open(path.parent_path() / file) &&
+                         uri.fileByteOffset + buffer.byteLength <= _buffer_files[i].size()) {
+                       _buffers[i] = _buffer_files[i].bytes().subspan(uri.fileByteOffset, buffer.byteLength);
+                       mapped = true;
+                     }
+                   },
+               },
+               buffer.data);
+    if (!mapped) {
+      return fastgltf::Error::MissingExternalBuffer;
+    }
+  }
+  return fastgltf::Error::None;
+}
+
+bool MappedGltf::decode_compressed_views(ThreadPool& pool, MeshoptDecodeStats& stats) {
+  stats = {};
+  auto start = std::chrono::system_clock::now();
+
+  bool decoded = true;
+  std::vector<std::future<bool>> jobs;
+  for (const fastgltf::BufferView& view : _asset.bufferViews) {
+    if (!view.meshoptCompression || _decoded[view.bufferIndex] == nullptr) {
+      continue;
+    }
+    const fastgltf::CompressedBufferView& compressed = *view.meshoptCompression;
+    const std::span<const std::byte> src = _buffers[compressed.bufferIndex];
+    const size_t decoded_size = compressed.count * compressed.byteStride;
+    if (compressed.byteOffset + compressed.byteLength > src.size() ||
+        view.byteOffset + decoded_size > _buffers[view.bufferIndex].size()) {
+      // the jobs already submitted write into _decoded, so they are still waited for before returning
+      decoded = false;
+      break;
+    }
+
+    MeshoptMode mode = MeshoptMode::attributes;
+    if (compressed.mode == fastgltf::MeshoptCompressionMode::Triangles) {
+      mode = MeshoptMode::triangles;
+    } else if (compressed.mode == fastgltf::MeshoptCompressionMode::Indices) {
+      mode = MeshoptMode::indices;
+    }
+    MeshoptFilter filter = MeshoptFilter::none;
+    if (compressed.filter == fastgltf::MeshoptCompressionFilter::Octahedral) {
+      filter = MeshoptFilter::octahedral;
+    } else if (compressed.filter == fastgltf::MeshoptCompressionFilter::Quaternion) {
+      filter = MeshoptFilter::quaternion;
+    } else if (compressed.filter == fastgltf::MeshoptCompressionFilter::Exponential) {
+      filter = MeshoptFilter::exponential;
+    }
+
+    // views never overlap, so every job writes its own range of the fallback buffer
+    const std::span<std::byte> dst(_decoded[view.bufferIndex].get() + view.byteOffset, decoded_size);
+    const std::span<const std::byte> stream = src.subspan(compressed.byteOffset, compressed.byteLength);
+    const size_t count = compressed.count;
+    const size_t stride = compressed.byteStride;
+    jobs.push_back(pool.submit([=]() { return decode_meshopt(dst, count, stride, stream, mode, filter); }));
+
+    stats.view_count++;
+    stats.compressed_bytes += compressed.byteLength;
+    stats.decoded_bytes += decoded_size;
+  }
+
+  for (std::future<bool>& job : jobs) {
+    decoded &= job.get();
+  }
+
+  auto end = std::chrono::system_clock::now();
+  stats.decode_ms = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() / 1000.f;
+  return decoded;
+}
+
+uint64_t MappedGltf::source_hash() const {
+  uint64_t hash = hash_bytes(_file.bytes());
+  for (size_t i = 0; i < _buffers.size(); i++) {
+    if (_buffer_files[i].is_open()) {
+      hash = hash_bytes(_buffers[i], hash);
+    }
+  }
+  return hash;
+}
+
+const std::byte* MappedGltf::BufferAdapter::operator()(const fastgltf::Buffer& buffer) const {
+  return gltf->_buffers[&buffer - gltf->_asset.buffers.data()].data();
+}
+
+size_t peak_rss_bytes() {
+  struct rusage usage {};
+  getrusage(RUSAGE_SELF, &usage);
+  // linux reports kilobytes
+  return size_t(usage.ru_maxrss) * 1024;
+}
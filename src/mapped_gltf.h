@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fastgltf/core.hpp>
+#include <fastgltf/types.hpp>
+#include <filesystem>
+#include <mapped_file.h>
+#include <memory>
+#include <span>
+#include <thread_pool.h>
+#include <vector>
+
+struct MeshoptDecodeStats {
+  size_t view_count;
+  size_t compressed_bytes;
+  size_t decoded_bytes;
+  float decode_ms;
+
+  float megabytes_per_second() const { return decode_ms <= 0.f ? 0.f : decoded_bytes / (decode_ms * 1000.f); }
+};
+
+// a glTF or GLB file and its external buffers mapped into memory instead of read. fastgltf parses the json straight
+// out of the mapping, a GLB's binary chunk stays a view into it and external .bin files get their own mapping, so
+// accessors read vertex data from the page cache and it is only copied once the loader has processed it
+class MappedGltf {
+public:
+  // fastgltf::Error::None once the asset and every buffer it references are mapped. options shouldn't have
+  // LoadGLBBuffers or LoadExternalBuffers, which make fastgltf copy the buffers this maps
+  fastgltf::Error load(fastgltf::Parser& parser, const std::filesystem::path& path, fastgltf::Options options);
+
+  // EXT_meshopt_compression views are decoded into their fallback buffer, one job per view on pool, so accessors
+  // read them like any other view. views whose buffer has real data are left alone. false when a view is malformed
+  bool decode_compressed_views(ThreadPool& pool, MeshoptDecodeStats& stats);
+
+  fastgltf::Asset& asset() { return _asset; }
+  const fastgltf::Asset& asset() const { return _asset; }
+  // the whole source file, json and binary chunk
+  std::span<const std::byte> file_bytes() const { return _file.bytes(); }
+  // hash of the file and of the external buffer files it references, the exact bytes a load reads. a GLB's binary
+  // chunk is part of the file
+  uint64_t source_hash() const;
+  // bytes of every buffer, indexed like asset().buffers
+  std::span<const std::span<const std::byte>> buffers() const { return _buffers; }
+
+  // buffer data adapter for fastgltf::copyFromAccessor and iterateAccessor
+  struct BufferAdapter {
+    const MappedGltf* gltf;
+    const std::byte* operator()(const fastgltf::Buffer& buffer) const;
+  };
+  BufferAdapter adapter() const { return BufferAdapter{this}; }
+
+private:
+  MappedFile _file;
+  std::vector<MappedFile> _buffer_files;
+  std::vector<std::span<const std::byte>> _buffers;
+  // storage of the fallback buffers compressed views decode into, empty for every other buffer
+  std::vector<std::unique_ptr<std::byte[]>> _decoded;
+  fastgltf::Asset _asset;
+};
+
+// high water mark of the process's resident memory, in bytes
+size_t peak_rss_bytes();
@@ -0,0 +1,193 @@
+#include <atomic>
+#include <cstring>
+#include <fmt/core.h>
+#include <hash.h>
+#include <mesh_cache.h>
+#include <unistd.h>
+
+// cooked entries live next to the other runtime data, relative to the build dir like the shaders and assets
+constexpr const char* MESH_CACHE_DIR = "../../cache/meshes";
+constexpr uint32_t MESH_CACHE_MAGIC = 0x434D5653; // "SVMC"
+// every array in the file starts on this alignment so it can be used in place from the mapping
+constexpr size_t MESH_CACHE_ALIGNMENT = 16;
+
+struct MeshCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t source_hash;
+  uint64_t mesh_count;
+  // hash_bytes of everything after the header
+  uint64_t payload_hash;
+};
+
+struct MeshCacheRecord {
+  uint32_t name_size;
+  uint32_t surface_count;
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t meshlet_count;
+};
+
+static size_t align_up(size_t size) { return (size + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1); }
+
+static uint64_t payload_hash(std::span<const std::byte> file) {
+  return hash_bytes(file.subspan(align_up(sizeof(MeshCacheHeader))));
+}
+
+std::filesystem::path mesh_cache_path(uint64_t source_hash) {
+  return std::filesystem::path(MESH_CACHE_DIR) / fmt::format("{:016x}.mesh", source_hash);
+}
+
+bool MeshCacheReader::open(const std::filesystem::path& path, uint64_t source_hash) {
+  _meshes.clear();
+  if (!_file.open(path)) {
+    return false;
+  }
+
+  const std::byte* base = _file.data();
+  const size_t size = _file.size();
+  size_t offset = 0;
+
+  // hands out the next aligned chunk of the file, or nullptr when the file is too short
+  auto take = [&](size_t bytes) -> const std::byte* {
+    if (bytes > size || offset > size - bytes) {
+      return nullptr;
+    }
+    const std::byte* ptr = base + offset;
+    offset += align_up(bytes);
+    return ptr;
+  };
+
+  const auto* header = (const MeshCacheHeader*)take(sizeof(MeshCacheHeader));
+  if (header == nullptr || header->magic != MESH_CACHE_MAGIC || header->version != MESH_COOKER_VERSION ||
+      header->source_hash != source_hash) {
+    _file.close();
+    return false;
+  }
+  // the counts below only catch truncation, a damaged payload would upload garbage indices
+  if (header->payload_hash != payload_hash(_file.bytes())) {
+    fmt::println("mesh cache {} is corrupt, recooking", path.string());
+    _file.close();
+    return false;
+  }
+
+  _meshes.reserve(header->mesh_count);
+  for (uint64_t i = 0; i < header->mesh_count; i++) {
+    const auto* record = (const MeshCacheRecord*)take(sizeof(MeshCacheRecord));
+    if (record == nullptr) {
+      break;
+    }
+
+    const auto* name = (const char*)take(record->name_size);
+    const auto* surfaces = (const CookedSurface*)take(record->surface_count * sizeof(CookedSurface));
+    const auto* vertices = (const Vertex*)take(record->vertex_count * sizeof(Vertex));
+    const auto* indices = (const uint32_t*)take(record->index_count * sizeof(uint32_t));
+    const auto* meshlets = (const Meshlet*)take(record->meshlet_count * sizeof(Meshlet));
+    if (name == nullptr || surfaces == nullptr || vertices == nullptr || indices == nullptr || meshlets == nullptr) {
+      break;
+    }
+
+    CookedMesh mesh;
+    mesh.name = std::string_view(name, record->name_size);
+    mesh.surfaces = std::span(surfaces, record->surface_count);
+    mesh.vertices = std::span(vertices, record->vertex_count);
+    mesh.indices = std::span(indices, record->index_count);
+    mesh.meshlets = std::span(meshlets, record->meshlet_count);
+    _meshes.push_back(mesh);
+  }
+
+  if (_meshes.size() != header->mesh_count) {
+    fmt::println("mesh cache {} is truncated, recooking", path.string());
+    _meshes.clear();
+    _file.close();
+    return false;
+  }
+  return true;
+}
+
+bool MeshCacheWriter::open(const std::filesystem::path& path, uint64_t source_hash) {
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+
+  // loads of the same file on different threads or processes cook into their own files, the last rename wins
+  static std::atomic<uint32_t> writer_count{0};
+  _path = path;
+  _tmp_path = path;
+  _tmp_path += fmt::format(".{}.{}.tmp", getpid(), writer_count.fetch_add(1, std::memory_order_relaxed));
+  _source_hash = source_hash;
+  _mesh_count = 0;
+
+  _out.open(_tmp_path, std::ios::binary | std::ios::trunc);
+  if (!_out.is_open()) {
+    return false;
+  }
+
+  // written again with the real mesh count in finish()
+  MeshCacheHeader header{};
+  write_padded(&header, sizeof(header));
+  return true;
+}
+
+void MeshCacheWriter::write_padded(const void* data, size_t size) {
+  constexpr char zeros[MESH_CACHE_ALIGNMENT]{};
+  _out.write((const char*)data, size);
+  _out.write(zeros, align_up(size) - size);
+}
+
+void MeshCacheWriter::add_mesh(std::string_view name, std::span<const CookedSurface> surfaces,
+                               std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                               std::span<const Meshlet> meshlets) {
+  if (!_out.is_open()) {
+    return;
+  }
+
+  MeshCacheRecord record{};
+  record.name_size = static_cast<uint32_t>(name.size());
+  record.surface_count = static_cast<uint32_t>(surfaces.size());
+  record.vertex_count = static_cast<uint32_t>(vertices.size());
+  record.index_count = static_cast<uint32_t>(indices.size());
+  record.meshlet_count = static_cast<uint32_t>(meshlets.size());
+
+  write_padded(&record, sizeof(record));
+  write_padded(name.data(), name.size());
+  write_padded(surfaces.data(), surfaces.size_bytes());
+  write_padded(vertices.data(), vertices.size_bytes());
+  write_padded(indices.data(), indices.size_bytes());
+  write_padded(meshlets.data(), meshlets.size_bytes());
+  _mesh_count++;
+}
+
+bool MeshCacheWriter::finish() {
+  if (!_out.is_open()) {
+    return false;
+  }
+
+  MeshCacheHeader header{};
+  header.magic = MESH_CACHE_MAGIC;
+  header.version = MESH_COOKER_VERSION;
+  header.source_hash = _source_hash;
+  header.mesh_count = _mesh_count;
+
+  // the payload is hashed from the written file, the way the reader sees it
+  _out.flush();
+  MappedFile written;
+  if (_out && written.open(_tmp_path)) {
+    header.payload_hash = payload_hash(written.bytes());
+    written.close();
+    _out.seekp(0);
+    _out.write((const char*)&header, sizeof(header));
+  } else {
+    _out.setstate(std::ios::failbit);
+  }
+  _out.close();
+
+  if (!_out) {
+    std::error_code ec;
+    std::filesystem::remove(_tmp_path, ec);
+    return false;
+  }
+
+  std::error_code ec;
+  std::filesystem::rename(_tmp_path, _path, ec);
+  return !ec;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mapped_file.h>
+#include <meshlets.h>
+#include <span>
+#include <string_view>
+#include <vector>
+#include <vk_loader.h>
+
+// bump whenever the cooked layout or anything that feeds the cooked arrays changes
+constexpr uint32_t MESH_COOKER_VERSION = 6;
+
+// surface record as stored on disk. material_index is -1 when the primitive has no material
+struct CookedSurface {
+  uint32_t start_index;
+  uint32_t count;
+  // range of the mesh vertex array the surface's indices point into
+  uint32_t first_vertex;
+  uint32_t vertex_count;
+  int32_t material_index;
+  Bounds bounds;
+  VertexQuantization quantization;
+  std::array<SurfaceLod, MAX_SURFACE_LODS> lods;
+  uint32_t lod_count;
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+};
+
+// one mesh inside a cache file. the spans point straight into the mapping
+struct CookedMesh {
+  std::string_view name;
+  std::span<const CookedSurface> surfaces;
+  std::span<const Vertex> vertices;
+  std::span<const uint32_t> indices;
+  std::span<const Meshlet> meshlets;
+};
+
+// cache entry location for a source file hash
+std::filesystem::path mesh_cache_path(uint64_t source_hash);
+
+class MeshCacheReader {
+public:
+  // maps the entry and validates it. fails for missing, truncated or corrupt files and for other cooker versions
+  bool open(const std::filesystem::path& path, uint64_t source_hash);
+
+  std::span<const CookedMesh> meshes() const { return _meshes; }
+
+private:
+  MappedFile _file;
+  std::vector<CookedMesh> _meshes;
+};
+
+class MeshCacheWriter {
+public:
+  bool open(const std::filesystem::path& path, uint64_t source_hash);
+  void add_mesh(std::string_view name, std::span<const CookedSurface> surfaces, std::span<const Vertex> vertices,
+                std::span<const uint32_t> indices, std::span<const Meshlet> meshlets);
+  // patches the header and moves the finished file into place so readers never see a partial entry. every writer
+  // has its own temporary file, so loads of the same source can cook at the same time
+  bool finish();
+
+private:
+  void write_padded(const void* data, size_t size);
+
+  std::filesystem::path _path;
+  std::filesystem::path _tmp_path;
+  std::ofstream _out;
+  uint64_t _source_hash{0};
+  uint64_t _mesh_count{0};
+};
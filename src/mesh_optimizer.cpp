@@ -0,0 +1,274 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <hash.h>
+#include <mesh_optimizer.h>
+#include <vector>
+
+// fifo size used for the acmr numbers, close to what current hardware batches vertices by
+constexpr uint32_t ANALYZE_CACHE_SIZE = 16;
+// the fetch model is a 16 KB direct mapped cache of 64 byte lines
+constexpr size_t FETCH_LINE_SIZE = 64;
+constexpr size_t FETCH_LINE_COUNT = 256;
+
+// lru cache the optimizer simulates and its scoring constants, as given in forsyth's paper
+constexpr uint32_t OPTIMIZE_CACHE_SIZE = 32;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float VALENCE_BOOST_SCALE = 2.f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count) {
+  VertexCacheStats stats{0, indices.size() / 3};
+
+  // a vertex is still cached if fewer than ANALYZE_CACHE_SIZE misses happened since it was inserted
+  std::vector<uint32_t> insert_time(vertex_count, 0);
+  uint32_t time = ANALYZE_CACHE_SIZE + 1;
+
+  for (uint32_t index : indices) {
+    if (time - insert_time[index] > ANALYZE_CACHE_SIZE) {
+      insert_time[index] = time++;
+      stats.vertices_transformed++;
+    }
+  }
+  return stats;
+}
+
+VertexFetchStats analyze_vertex_fetch(std::span<const uint32_t> indices, size_t vertex_count, size_t vertex_size) {
+  VertexFetchStats stats{0, 0};
+
+  std::array<size_t, FETCH_LINE_COUNT> lines;
+  lines.fill(SIZE_MAX);
+  std::vector<bool> referenced(vertex_count, false);
+
+  for (uint32_t index : indices) {
+    if (!referenced[index]) {
+      referenced[index] = true;
+      stats.vertex_bytes += vertex_size;
+    }
+
+    const size_t first_line = index * vertex_size / FETCH_LINE_SIZE;
+    const size_t last_line = ((index + 1) * vertex_size - 1) / FETCH_LINE_SIZE;
+    for (size_t line = first_line; line <= last_line; ++line) {
+      size_t& slot = lines[line % FETCH_LINE_COUNT];
+      if (slot != line) {
+        slot = line;
+        stats.bytes_fetched += FETCH_LINE_SIZE;
+      }
+    }
+  }
+  return stats;
+}
+
+size_t weld_vertices(std::span<uint32_t> indices, std::span<Vertex> vertices) {
+  // open addressing table of the first vertex seen with each value
+  size_t table_size = 1;
+  while (table_size < vertices.size() * 2) {
+    table_size *= 2;
+  }
+  std::vector<uint32_t> table(table_size, INVALID_INDEX);
+
+  std::vector<uint32_t> remap(vertices.size());
+  std::vector<uint32_t> first_of;
+  first_of.reserve(vertices.size());
+
+  for (uint32_t v{0}; v < vertices.size(); ++v) {
+    size_t slot = hash_bytes(&vertices[v], sizeof(Vertex)) & (table_size - 1);
+    while (table[slot] != INVALID_INDEX && std::memcmp(&vertices[table[slot]], &vertices[v], sizeof(Vertex)) != 0) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+
+    if (table[slot] == INVALID_INDEX) {
+      table[slot] = v;
+      remap[v] = static_cast<uint32_t>(first_of.size());
+      first_of.push_back(v);
+    } else {
+      remap[v] = remap[table[slot]];
+    }
+  }
+
+  // first_of is increasing and never below its position, so compacting front to back only overwrites
+  // vertices that were already moved
+  for (size_t u{0}; u < first_of.size(); ++u) {
+    vertices[u] = vertices[first_of[u]];
+  }
+  for (uint32_t& index : indices) {
+    index = remap[index];
+  }
+  return first_of.size();
+}
+
+// score tables, valences past the end of the table are rare enough to compute directly
+struct VertexScoreTables {
+  std::array<float, OPTIMIZE_CACHE_SIZE> cache;
+  std::array<float, 32> valence;
+
+  VertexScoreTables() {
+    for (uint32_t i{0}; i < OPTIMIZE_CACHE_SIZE; ++i) {
+      // the last triangle's vertices get a fixed score so the order doesn't just keep turning around them
+      cache[i] = i < 3 ? LAST_TRIANGLE_SCORE
+                       : std::pow(1.f - float(i - 3) / float(OPTIMIZE_CACHE_SIZE - 3), CACHE_DECAY_POWER);
+    }
+    for (uint32_t i{0}; i < valence.size(); ++i) {
+      valence[i] = valence_boost(i);
+    }
+  }
+
+  // vertices with few triangles left get a boost so they are finished off instead of left behind
+  static float valence_boost(uint32_t remaining_triangles) {
+    return remaining_triangles == 0 ? 0.f
+                                    : VALENCE_BOOST_SCALE * std::pow(float(remaining_triangles), -VALENCE_BOOST_POWER);
+  }
+};
+
+static float vertex_score(const VertexScoreTables& tables, int32_t cache_position, uint32_t remaining_triangles) {
+  // vertices with nothing left to draw must never pull a triangle forward
+  if (remaining_triangles == 0) {
+    return -1.f;
+  }
+
+  float score = cache_position >= 0 ? tables.cache[cache_position] : 0.f;
+  score += remaining_triangles < tables.valence.size() ? tables.valence[remaining_triangles]
+                                                       : VertexScoreTables::valence_boost(remaining_triangles);
+  return score;
+}
+
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count) {
+  const size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0) {
+    return;
+  }
+
+  // per vertex list of the triangles that still have to be drawn
+  std::vector<uint32_t> remaining(vertex_count, 0);
+  for (uint32_t index : indices) {
+    remaining[index]++;
+  }
+  std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+  for (size_t v{0}; v < vertex_count; ++v) {
+    adjacency_offset[v + 1] = adjacency_offset[v] + remaining[v];
+  }
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for (size_t i{0}; i < indices.size(); ++i) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  static const VertexScoreTables tables;
+
+  std::vector<int32_t> cache_position(vertex_count, -1);
+  std::vector<float> vertex_scores(vertex_count);
+  for (size_t v{0}; v < vertex_count; ++v) {
+    vertex_scores[v] = vertex_score(tables, -1, remaining[v]);
+  }
+
+  std::vector<float> triangle_scores(triangle_count);
+  std::vector<bool> emitted(triangle_count, false);
+  uint32_t best_triangle = 0;
+  for (size_t t{0}; t < triangle_count; ++t) {
+    triangle_scores[t] =
+        vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+    if (triangle_scores[t] > triangle_scores[best_triangle]) {
+      best_triangle = static_cast<uint32_t>(t);
+    }
+  }
+
+  std::vector<uint32_t> output;
+  output.reserve(indices.size());
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> next_cache;
+  cache.reserve(OPTIMIZE_CACHE_SIZE + 3);
+  next_cache.reserve(OPTIMIZE_CACHE_SIZE + 3);
+
+  // when the cache runs dry the next triangle comes from here, in input order
+  size_t input_cursor = 0;
+
+  while (output.size() < triangle_count * 3) {
+    if (best_triangle == INVALID_INDEX) {
+      while (emitted[input_cursor]) {
+        input_cursor++;
+      }
+      best_triangle = static_cast<uint32_t>(input_cursor);
+    }
+
+    const uint32_t* tri = &indices[best_triangle * 3];
+    emitted[best_triangle] = true;
+    output.insert(output.end(), tri, tri + 3);
+
+    for (int i{0}; i < 3; ++i) {
+      const uint32_t v = tri[i];
+      uint32_t* list = &adjacency[adjacency_offset[v]];
+      std::swap(*std::find(list, list + remaining[v], best_triangle), list[remaining[v] - 1]);
+      remaining[v]--;
+    }
+
+    // the triangle's vertices move to the front, everything else keeps its order
+    next_cache.assign(tri, tri + 3);
+    for (uint32_t v : cache) {
+      if (v != tri[0] && v != tri[1] && v != tri[2]) {
+        next_cache.push_back(v);
+      }
+    }
+    for (size_t i = OPTIMIZE_CACHE_SIZE; i < next_cache.size(); ++i) {
+      cache_position[next_cache[i]] = -1;
+      vertex_scores[next_cache[i]] = vertex_score(tables, -1, remaining[next_cache[i]]);
+    }
+    next_cache.resize(std::min<size_t>(next_cache.size(), OPTIMIZE_CACHE_SIZE));
+    std::swap(cache, next_cache);
+
+    for (size_t i{0}; i < cache.size(); ++i) {
+      cache_position[cache[i]] = static_cast<int32_t>(i);
+      vertex_scores[cache[i]] = vertex_score(tables, static_cast<int32_t>(i), remaining[cache[i]]);
+    }
+
+    // only triangles touching the cache changed score, the best of them is drawn next
+    best_triangle = INVALID_INDEX;
+    float best_score = 0.f;
+    for (uint32_t v : cache) {
+      const uint32_t* list = &adjacency[adjacency_offset[v]];
+      for (uint32_t i{0}; i < remaining[v]; ++i) {
+        const uint32_t t = list[i];
+        triangle_scores[t] =
+            vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] + vertex_scores[indices[t * 3 + 2]];
+        if (triangle_scores[t] > best_score) {
+          best_score = triangle_scores[t];
+          best_triangle = t;
+        }
+      }
+    }
+  }
+
+  std::copy(output.begin(), output.end(), indices.begin());
+}
+
+size_t optimize_vertex_fetch(std::span<uint32_t> indices, std::span<Vertex> vertices) {
+  std::vector<uint32_t> remap(vertices.size(), INVALID_INDEX);
+  uint32_t next = 0;
+  for (uint32_t& index : indices) {
+    if (remap[index] == INVALID_INDEX) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+
+  std::vector<Vertex> reordered(next);
+  for (size_t v{0}; v < vertices.size(); ++v) {
+    if (remap[v] != INVALID_INDEX) {
+      reordered[remap[v]] = vertices[v];
+    }
+  }
+  std::copy(reordered.begin(), reordered.end(), vertices.begin());
+  return next;
+}
+
+size_t optimize_mesh(std::span<uint32_t> indices, std::span<Vertex> vertices) {
+  size_t vertex_count = weld_vertices(indices, vertices);
+  optimize_vertex_cache(indices, vertex_count);
+  return optimize_vertex_fetch(indices, vertices.first(vertex_count));
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vertex.h>
+
+// import time reordering of triangle lists. every function works on one primitive, with indices local to
+// the vertices passed alongside them
+
+// post transform cache behaviour under a fifo cache model. acmr is vertices transformed per triangle
+struct VertexCacheStats {
+  size_t vertices_transformed;
+  size_t triangles;
+
+  float acmr() const { return triangles == 0 ? 0.f : float(vertices_transformed) / float(triangles); }
+};
+
+// pre transform fetch behaviour under a cache line model. overfetch is bytes fetched over the size of
+// the referenced vertices, 1 means every byte was read exactly once
+struct VertexFetchStats {
+  size_t bytes_fetched;
+  size_t vertex_bytes;
+
+  float overfetch() const { return vertex_bytes == 0 ? 0.f : float(bytes_fetched) / float(vertex_bytes); }
+};
+
+VertexCacheStats analyze_vertex_cache(std::span<const uint32_t> indices, size_t vertex_count);
+VertexFetchStats analyze_vertex_fetch(std::span<const uint32_t> indices, size_t vertex_count, size_t vertex_size);
+
+// collapses byte identical vertices into one and compacts the vertex array. returns the new vertex count
+size_t weld_vertices(std::span<uint32_t> indices, std::span<Vertex> vertices);
+
+// reorders triangles so consecutive ones share vertices (tom forsyth's linear speed optimizer)
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count);
+
+// moves vertices into the order the triangles first use them and drops unreferenced ones. returns the new
+// vertex count
+size_t optimize_vertex_fetch(std::span<uint32_t> indices, std::span<Vertex> vertices);
+
+// weld, then vertex cache, then vertex fetch. returns the vertex count left, vertices past it are stale
+size_t optimize_mesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glm/glm.hpp>
+#include <hash.h>
+#include <mesh_simplifier.h>
+#include <unordered_set>
+#include <vector>
+
+constexpr uint32_t INVALID_INDEX = ~0u;
+// open border edges get a plane perpendicular to their triangle with this much weight relative to the
+// triangle planes, so collapses that pull a border inwards are expensive
+constexpr double BORDER_WEIGHT = 10.0;
+
+enum class VertexKind : uint8_t {
+  // can collapse onto any neighbour
+  Manifold,
+  // on an open edge, can only collapse along it
+  Border,
+  // seam or non manifold vertex, never moves
+  Locked,
+};
+
+// sum of squared distances to a set of weighted planes
+struct Quadric {
+  double a00, a01, a02, a11, a12, a22;
+  double b0, b1, b2;
+  double c;
+  double weight;
+};
+
+static Quadric plane_quadric(glm::vec3 normal, glm::vec3 point, double weight) {
+  const double x = normal.x, y = normal.y, z = normal.z;
+  const double d = -(x * point.x + y * point.y + z * point.z);
+  return {weight * x * x, weight * x * y, weight * x * z, weight * y * y, weight * y * z, weight * z * z,
+          weight * d * x, weight * d * y, weight * d * z, weight * d * d, weight};
+}
+
+static void add_quadric(Quadric& q, const Quadric& r) {
+  q.a00 += r.a00;
+  q.a01 += r.a01;
+  q.a02 += r.a02;
+  q.a11 += r.a11;
+  q.a12 += r.a12;
+  q.a22 += r.a22;
+  q.b0 += r.b0;
+  q.b1 += r.b1;
+  q.b2 += r.b2;
+  q.c += r.c;
+  q.weight += r.weight;
+}
+
+static double evaluate_quadric(const Quadric& q, glm::vec3 p) {
+  const double x = p.x, y = p.y, z = p.z;
+  const double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z + 2 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z) +
+                   2 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+  return std::abs(r);
+}
+
+// maps every vertex to the first one that compares equal to it
+template <typename Hash, typename Equal>
+static std::vector<uint32_t> build_remap(size_t count, Hash&& hash, Equal&& equal) {
+  size_t table_size = 1;
+  while (table_size < count * 2) {
+    table_size *= 2;
+  }
+  std::vector<uint32_t> table(table_size, INVALID_INDEX);
+  std::vector<uint32_t> remap(count);
+
+  for (uint32_t v{0}; v < count; ++v) {
+    size_t slot = hash(v) & (table_size - 1);
+    while (table[slot] != INVALID_INDEX && !equal(table[slot], v)) {
+      slot = (slot + 1) & (table_size - 1);
+    }
+    if (table[slot] == INVALID_INDEX) {
+      table[slot] = v;
+    }
+    remap[v] = table[slot];
+  }
+  return remap;
+}
+
+static uint64_t edge_key(uint32_t a, uint32_t b) { return (uint64_t(a) << 32) | b; }
+
+float simplify_scale(std::span<const Vertex> vertices) {
+  if (vertices.empty()) {
+    return 0.f;
+  }
+
+  glm::vec3 min_pos = vertices[0].position;
+  glm::vec3 max_pos = vertices[0].position;
+  for (const Vertex& v : vertices) {
+    min_pos = glm::min(min_pos, v.position);
+    max_pos = glm::max(max_pos, v.position);
+  }
+  const glm::vec3 extent = max_pos - min_pos;
+  return std::max(extent.x, std::max(extent.y, extent.z));
+}
+
+size_t simplify_mesh(std::span<uint32_t> destination, std::span<const uint32_t> indices,
+                     std::span<const Vertex> vertices, size_t target_index_count, float target_error,
+                     float* result_error) {
+  const size_t vertex_count = vertices.size();
+
+  // positions normalized to the unit cube so errors don't depend on the mesh's scale
+  const float scale = simplify_scale(vertices);
+  const float inv_scale = scale > 0.f ? 1.f / scale : 0.f;
+  glm::vec3 min_pos = vertices.empty() ? glm::vec3{0.f} : vertices[0].position;
+  for (const Vertex& v : vertices) {
+    min_pos = glm::min(min_pos, v.position);
+  }
+  std::vector<glm::vec3> positions(vertex_count);
+  for (size_t v{0}; v < vertex_count; ++v) {
+    positions[v] = (vertices[v].position - min_pos) * inv_scale;
+  }
+
+  // byte identical vertices are treated as one, then every position gets a single representative
+  std::vector<uint32_t> canonical = build_remap(
+      vertex_count, [&](uint32_t v) { return hash_bytes(&vertices[v], sizeof(Vertex)); },
+      [&](uint32_t a, uint32_t b) { return std::memcmp(&vertices[a], &vertices[b], sizeof(Vertex)) == 0; });
+  std::vector<uint32_t> position_of = build_remap(
+      vertex_count, [&](uint32_t v) { return hash_bytes(&vertices[v].position, sizeof(glm::vec3)); },
+      [&](uint32_t a, uint32_t b) {
+        return std::memcmp(&vertices[a].position, &vertices[b].position, sizeof(glm::vec3)) == 0;
+      });
+
+  // positions shared by several distinct vertices sit on an attribute seam
+  std::vector<uint32_t> wedge_count(vertex_count, 0);
+  for (uint32_t v{0}; v < vertex_count; ++v) {
+    if (canonical[v] == v) {
+      wedge_count[position_of[v]]++;
+    }
+  }
+
+  auto is_degenerate = [&](uint32_t a, uint32_t b, uint32_t c) {
+    const uint32_t pa = position_of[a], pb = position_of[b], pc = position_of[c];
+    return pa == pb || pb == pc || pa == pc;
+  };
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+  for (size_t i{0}; i + 2 < indices.size(); i += 3) {
+    const uint32_t a = canonical[indices[i]], b = canonical[indices[i + 1]], c = canonical[indices[i + 2]];
+    if (!is_degenerate(a, b, c)) {
+      result.insert(result.end(), {a, b, c});
+    }
+  }
+
+  std::unordered_set<uint64_t> edges;
+  auto build_edges = [&]() {
+    edges.clear();
+    edges.reserve(result.size());
+    for (size_t i{0}; i < result.size(); i += 3) {
+      for (int k{0}; k < 3; ++k) {
+        edges.insert(edge_key(position_of[result[i + k]], position_of[result[i + (k + 1) % 3]]));
+      }
+    }
+  };
+  auto is_border_edge = [&](uint32_t pa, uint32_t pb) {
+    return edges.contains(edge_key(pa, pb)) != edges.contains(edge_key(pb, pa));
+  };
+
+  // triangle planes weighted by area, plus the border planes
+  build_edges();
+  std::vector<Quadric> quadrics(vertex_count, Quadric{});
+  for (size_t i{0}; i < result.size(); i += 3) {
+    const uint32_t p[3] = {position_of[result[i]], position_of[result[i + 1]], position_of[result[i + 2]]};
+    const glm::vec3 cross = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+    const float length = glm::length(cross);
+    if (length == 0.f) {
+      continue;
+    }
+    const glm::vec3 normal = cross / length;
+
+    const Quadric q = plane_quadric(normal, positions[p[0]], length * 0.5);
+    for (int k{0}; k < 3; ++k) {
+      add_quadric(quadrics[p[k]], q);
+    }
+
+    for (int k{0}; k < 3; ++k) {
+      const uint32_t a = p[k], b = p[(k + 1) % 3];
+      if (!is_border_edge(a, b)) {
+        continue;
+      }
+      const glm::vec3 edge = positions[b] - positions[a];
+      const float edge_length = glm::length(edge);
+      if (edge_length == 0.f) {
+        continue;
+      }
+      const glm::vec3 border_normal = glm::normalize(glm::cross(edge, normal));
+      const Quadric border = plane_quadric(border_normal, positions[a], edge_length * edge_length * BORDER_WEIGHT);
+      add_quadric(quadrics[a], border);
+      add_quadric(quadrics[b], border);
+    }
+  }
+
+  auto collapse_error = [&](uint32_t p0, uint32_t p1) {
+    Quadric q = quadrics[p0];
+    add_quadric(q, quadrics[p1]);
+    return q.weight > 0.0 ? evaluate_quadric(q, positions[p1]) / q.weight : 0.0;
+  };
+
+  struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    double error;
+  };
+
+  std::vector<VertexKind> kinds(vertex_count);
+  std::vector<uint32_t> border_edge_count(vertex_count);
+  std::vector<uint32_t> triangle_offsets(vertex_count + 1);
+  std::vector<uint32_t> triangle_fill(vertex_count);
+  std::vector<uint32_t> vertex_triangles;
+  std::vector<Collapse> collapses;
+  std::vector<bool> touched(vertex_count);
+  std::vector<uint32_t> collapse_remap(vertex_count);
+
+  const double error_limit = double(target_error) * double(target_error);
+  double max_error = 0.0;
+
+  while (result.size() > target_index_count) {
+    build_edges();
+
+    // classify positions against the current topology
+    std::fill(border_edge_count.begin(), border_edge_count.end(), 0);
+    for (uint64_t key : edges) {
+      const uint32_t a = uint32_t(key >> 32), b = uint32_t(key);
+      if (!edges.contains(edge_key(b, a))) {
+        border_edge_count[a]++;
+        border_edge_count[b]++;
+      }
+    }
+    for (uint32_t v{0}; v < vertex_count; ++v) {
+      if (wedge_count[v] > 1 || border_edge_count[v] > 2) {
+        kinds[v] = VertexKind::Locked;
+      } else {
+        kinds[v] = border_edge_count[v] > 0 ? VertexKind::Border : VertexKind::Manifold;
+      }
+    }
+
+    // triangles around each position
+    std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+    for (uint32_t index : result) {
+      triangle_offsets[position_of[index] + 1]++;
+    }
+    for (size_t v{0}; v < vertex_count; ++v) {
+      triangle_offsets[v + 1] += triangle_offsets[v];
+    }
+    std::copy(triangle_offsets.begin(), triangle_offsets.end() - 1, triangle_fill.begin());
+    vertex_triangles.resize(result.size());
+    for (size_t i{0}; i < result.size(); ++i) {
+      vertex_triangles[triangle_fill[position_of[result[i]]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    collapses.clear();
+    for (size_t i{0}; i < result.size(); i += 3) {
+      for (int k{0}; k < 3; ++k) {
+        const uint32_t a = result[i + k], b = result[i + (k + 1) % 3];
+        const uint32_t pa = position_of[a], pb = position_of[b];
+        if (kinds[pa] == VertexKind::Manifold || (kinds[pa] == VertexKind::Border && is_border_edge(pa, pb))) {
+          collapses.push_back({a, b, collapse_error(pa, pb)});
+        }
+        if (kinds[pb] == VertexKind::Manifold || (kinds[pb] == VertexKind::Border && is_border_edge(pa, pb))) {
+          collapses.push_back({b, a, collapse_error(pb, pa)});
+        }
+      }
+    }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse& a, const Collapse& b) { return a.error < b.error; });
+
+    std::fill(touched.begin(), touched.end(), false);
+    for (uint32_t v{0}; v < vertex_count; ++v) {
+      collapse_remap[v] = v;
+    }
+
+    const size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+    size_t triangles_removed = 0;
+    for (const Collapse& collapse : collapses) {
+      if (collapse.error > error_limit || triangles_removed >= triangles_to_remove) {
+        break;
+      }
+
+      const uint32_t p0 = position_of[collapse.from];
+      const uint32_t p1 = position_of[collapse.to];
+      if (touched[p0] || touched[p1]) {
+        continue;
+      }
+
+      // moving p0 must not turn any of its remaining triangles over
+      bool flips = false;
+      size_t shared = 0;
+      for (uint32_t j = triangle_offsets[p0]; j < triangle_offsets[p0 + 1] && !flips; ++j) {
+        const uint32_t* tri = &result[vertex_triangles[j] * 3];
+        const uint32_t p[3] = {position_of[tri[0]], position_of[tri[1]], position_of[tri[2]]};
+        if (p[0] == p1 || p[1] == p1 || p[2] == p1) {
+          shared++;
+          continue;
+        }
+
+        glm::vec3 moved[3] = {positions[p[0]], positions[p[1]], positions[p[2]]};
+        const glm::vec3 before = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        for (int k{0}; k < 3; ++k) {
+          if (p[k] == p0) {
+            moved[k] = positions[p1];
+          }
+        }
+        const glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        flips = glm::dot(before, after) <= 0.f;
+      }
+      if (flips) {
+        continue;
+      }
+
+      // everything around p0 changes shape, so none of it may collapse again in this pass
+      for (uint32_t j = triangle_offsets[p0]; j < triangle_offsets[p0 + 1]; ++j) {
+        const uint32_t* tri = &result[vertex_triangles[j] * 3];
+        for (int k{0}; k < 3; ++k) {
+          touched[position_of[tri[k]]] = true;
+        }
+      }
+
+      // p0 isn't on a seam, so collapse.from is the only vertex at that position
+      collapse_remap[collapse.from] = collapse.to;
+      add_quadric(quadrics[p1], quadrics[p0]);
+      max_error = std::max(max_error, collapse.error);
+      triangles_removed += shared;
+    }
+
+    if (triangles_removed == 0) {
+      break;
+    }
+
+    size_t write = 0;
+    for (size_t i{0}; i < result.size(); i += 3) {
+      const uint32_t a = collapse_remap[result[i]], b = collapse_remap[result[i + 1]],
+                     c = collapse_remap[result[i + 2]];
+      if (!is_degenerate(a, b, c)) {
+        result[write++] = a;
+        result[write++] = b;
+        result[write++] = c;
+      }
+    }
+    result.resize(write);
+  }
+
+  std::copy(result.begin(), result.end(), destination.begin());
+  if (result_error != nullptr) {
+    *result_error = static_cast<float>(std::sqrt(max_error));
+  }
+  return result.size();
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vertex.h>
+
+// quadric error edge collapse simplification of a triangle list. vertices are only ever collapsed onto other
+// existing vertices, so every level of detail can share the source vertex array.
+//
+// collapses are applied cheapest first until the index count reaches target_index_count or the next collapse
+// would move the surface further than target_error. errors are relative to the largest extent of the mesh.
+// open borders only collapse along themselves and vertices on attribute seams stay where they are.
+//
+// writes the simplified indices to destination, which must hold indices.size() elements, and returns how many
+// were written. result_error receives the relative error of the result when it isn't null
+size_t simplify_mesh(std::span<uint32_t> destination, std::span<const uint32_t> indices,
+                     std::span<const Vertex> vertices, size_t target_index_count, float target_error,
+                     float* result_error = nullptr);
+
+// the factor that turns simplify_mesh's relative errors into object space distances
+float simplify_scale(std::span<const Vertex> vertices);
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cmath>
+#include <glm/geometric.hpp>
+#include <meshlets.h>
+
+constexpr uint32_t INVALID_INDEX = ~0u;
+
+static_assert(sizeof(Meshlet) == 64, "Meshlet is mirrored in meshlet_cull.comp");
+
+// bounds and normal cone of the triangles in [first_index, first_index + index_count), following the
+// construction in meshoptimizer's meshopt_computeClusterBounds
+static Meshlet meshlet_bounds(std::span<const uint32_t> indices, std::span<const Vertex> vertices,
+                              uint32_t first_index, uint32_t index_count) {
+  Meshlet meshlet{};
+  meshlet.first_index = first_index;
+  meshlet.index_count = index_count;
+
+  glm::vec3 min{vertices[indices[first_index]].position};
+  glm::vec3 max{min};
+  for (uint32_t i = first_index; i < first_index + index_count; ++i) {
+    min = glm::min(min, vertices[indices[i]].position);
+    max = glm::max(max, vertices[indices[i]].position);
+  }
+  const glm::vec3 center = (min + max) * 0.5f;
+  float radius = 0.f;
+  for (uint32_t i = first_index; i < first_index + index_count; ++i) {
+    radius = std::max(radius, glm::length(vertices[indices[i]].position - center));
+  }
+  meshlet.sphere = glm::vec4{center, radius};
+
+  // the cone axis is the average face normal, degenerate triangles don't get a vote
+  const uint32_t triangle_count = index_count / 3;
+  glm::vec3 axis{0.f};
+  for (uint32_t t{0}; t < triangle_count; ++t) {
+    const uint32_t* tri = &indices[first_index + t * 3];
+    const glm::vec3 n = glm::cross(vertices[tri[1]].position - vertices[tri[0]].position,
+                                   vertices[tri[2]].position - vertices[tri[0]].position);
+    const float area = glm::length(n);
+    if (area > 0.f) {
+      axis += n / area;
+    }
+  }
+
+  meshlet.cone_apex = glm::vec4{center, 0.f};
+  meshlet.cone_axis_cutoff = glm::vec4{0.f, 0.f, 1.f, 1.f};
+
+  const float axis_length = glm::length(axis);
+  if (axis_length == 0.f) {
+    return meshlet;
+  }
+  axis /= axis_length;
+
+  // the widest angle between the axis and a face normal, and how far back along the axis the apex has to
+  // sit so every triangle's plane is in front of it
+  float min_dot = 1.f;
+  float max_t = 0.f;
+  for (uint32_t t{0}; t < triangle_count; ++t) {
+    const uint32_t* tri = &indices[first_index + t * 3];
+    const glm::vec3 p0 = vertices[tri[0]].position;
+    glm::vec3 n = glm::cross(vertices[tri[1]].position - p0, vertices[tri[2]].position - p0);
+    const float area = glm::length(n);
+    if (area == 0.f) {
+      continue;
+    }
+    n /= area;
+
+    const float dot = glm::dot(n, axis);
+    min_dot = std::min(min_dot, dot);
+
+    // distance along the axis from the center to this triangle's plane
+    if (dot > 0.f) {
+      max_t = std::max(max_t, glm::dot(center - p0, n) / dot);
+    }
+  }
+
+  // normals spread over more than a hemisphere, any view direction sees some of it
+  if (min_dot <= 0.f) {
+    return meshlet;
+  }
+
+  meshlet.cone_apex = glm::vec4{center - axis * max_t, 0.f};
+  meshlet.cone_axis_cutoff = glm::vec4{axis, std::sqrt(1.f - min_dot * min_dot)};
+  return meshlet;
+}
+
+std::vector<Meshlet> build_meshlets(std::span<const uint32_t> indices, std::span<const Vertex> vertices) {
+  std::vector<Meshlet> meshlets;
+  const uint32_t index_count = static_cast<uint32_t>(indices.size() / 3 * 3);
+  if (index_count == 0) {
+    return meshlets;
+  }
+
+  // which meshlet each vertex was last counted in, so counting unique vertices needs no clearing
+  std::vector<uint32_t> seen_in(vertices.size(), INVALID_INDEX);
+  uint32_t meshlet_id = 0;
+  uint32_t first_index = 0;
+  uint32_t vertex_count = 0;
+
+  for (uint32_t i{0}; i < index_count; i += 3) {
+    uint32_t new_vertices = 0;
+    for (uint32_t k{0}; k < 3; ++k) {
+      const uint32_t v = indices[i + k];
+      // a triangle can repeat a vertex, count it once
+      const bool repeated = (k > 0 && indices[i] == v) || (k > 1 && indices[i + 1] == v);
+      new_vertices += seen_in[v] != meshlet_id && !repeated;
+    }
+
+    const uint32_t triangles = (i - first_index) / 3;
+    if (vertex_count + new_vertices > MESHLET_MAX_VERTICES || triangles == MESHLET_MAX_TRIANGLES) {
+      meshlets.push_back(meshlet_bounds(indices, vertices, first_index, i - first_index));
+      meshlet_id++;
+      first_index = i;
+      vertex_count = 0;
+    }
+
+    for (uint32_t k{0}; k < 3; ++k) {
+      const uint32_t v = indices[i + k];
+      if (seen_in[v] != meshlet_id) {
+        seen_in[v] = meshlet_id;
+        vertex_count++;
+      }
+    }
+  }
+  meshlets.push_back(meshlet_bounds(indices, vertices, first_index, index_count - first_index));
+
+  return meshlets;
+}
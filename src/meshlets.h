@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec4.hpp>
+#include <span>
+#include <vector>
+#include <vertex.h>
+
+// limits a meshlet is built to. 64 vertices keeps the bounds tight, 124 triangles keeps index ranges a multiple
+// of 4 and leaves room for a per meshlet header if the geometry ever moves to mesh shaders
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// a cluster of consecutive triangles in a surface's index range. the layout is shared with meshlet_cull.comp
+struct Meshlet {
+  // xyz center, w radius
+  glm::vec4 sphere;
+  // xyz apex of the normal cone, w unused
+  glm::vec4 cone_apex;
+  // xyz cone axis, w cutoff. the cluster faces away from any viewer with
+  // dot(normalize(apex - camera), axis) >= cutoff. a cutoff of 1 or more means it can never be cone culled
+  glm::vec4 cone_axis_cutoff;
+  // relative to the start of the indices the meshlets were built from
+  uint32_t first_index;
+  uint32_t index_count;
+  uint32_t pad[2];
+};
+
+// cuts a triangle list into meshlets in its current triangle order, so the order should already be cache
+// optimized. every meshlet is a contiguous run of indices, the triangles are not moved
+std::vector<Meshlet> build_meshlets(std::span<const uint32_t> indices, std::span<const Vertex> vertices);
@@ -0,0 +1,405 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <meshopt_decoder.h>
+
+constexpr uint8_t VERTEX_HEADER = 0xa0;
+constexpr uint8_t TRIANGLE_HEADER = 0xe0;
+constexpr uint8_t SEQUENCE_HEADER = 0xd0;
+
+// attribute blocks hold at most this many bytes of vertices, in at most this many vertices
+constexpr size_t VERTEX_BLOCK_BYTES = 8192;
+constexpr size_t VERTEX_BLOCK_MAX_COUNT = 256;
+// bytes are coded in groups of 16, each with one of four bit widths
+constexpr size_t BYTE_GROUP_SIZE = 16;
+// the most a group can take: 8 bytes of 4 bit codes and 16 escaped values
+constexpr size_t BYTE_GROUP_MAX_BYTES = 24;
+// the stream ends with the first vertex, padded to at least this many bytes
+constexpr size_t VERTEX_TAIL_MIN_BYTES = 32;
+
+static size_t vertex_block_count(size_t stride) {
+  const size_t count = (VERTEX_BLOCK_BYTES / stride) & ~(BYTE_GROUP_SIZE - 1);
+  return std::min(count, VERTEX_BLOCK_MAX_COUNT);
+}
+
+// 16 values of 0, 2, 4 or 8 bits. the largest 2 and 4 bit code means the value follows the codes as a whole byte
+static const uint8_t* decode_byte_group(const uint8_t* data, uint8_t* out, uint32_t bits_log2) {
+  if (bits_log2 == 0) {
+    memset(out, 0, BYTE_GROUP_SIZE);
+    return data;
+  }
+  if (bits_log2 == 3) {
+    memcpy(out, data, BYTE_GROUP_SIZE);
+    return data + BYTE_GROUP_SIZE;
+  }
+
+  const uint32_t bits = bits_log2 == 1 ? 2 : 4;
+  const uint32_t escape = (1u << bits) - 1;
+  const uint8_t* codes = data;
+  const uint8_t* escaped = data + BYTE_GROUP_SIZE * bits / 8;
+  for (size_t i = 0; i < BYTE_GROUP_SIZE; i++) {
+    // codes fill each byte from the top bits down
+    const uint32_t bit = uint32_t(i) * bits;
+    const uint32_t code = (codes[bit / 8] >> (8 - bits - bit % 8)) & escape;
+    out[i] = code == escape ? *escaped++ : uint8_t(code);
+  }
+  return escaped;
+}
+
+// size bytes, a multiple of 16, behind a header of 2 bit widths per group
+static const uint8_t* decode_bytes(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t size) {
+  const size_t group_count = size / BYTE_GROUP_SIZE;
+  const size_t header_size = (group_count + 3) / 4;
+  if (size_t(end - data) < header_size) {
+    return nullptr;
+  }
+  const uint8_t* header = data;
+  data += header_size;
+
+  for (size_t group = 0; group < group_count; group++) {
+    if (size_t(end - data) < BYTE_GROUP_MAX_BYTES) {
+      return nullptr;
+    }
+    const uint32_t bits_log2 = (header[group / 4] >> ((group % 4) * 2)) & 3;
+    data = decode_byte_group(data, out + group * BYTE_GROUP_SIZE, bits_log2);
+  }
+  return data;
+}
+
+// every byte of the vertex is its own stream of zigzagged deltas from the same byte of the previous vertex
+static const uint8_t* decode_vertex_block(const uint8_t* data, const uint8_t* end, uint8_t* out, size_t count,
+                                          size_t stride, std::array<uint8_t, 256>& last_vertex) {
+  std::array<uint8_t, VERTEX_BLOCK_MAX_COUNT> deltas;
+  const size_t aligned_count = (count + BYTE_GROUP_SIZE - 1) & ~(BYTE_GROUP_SIZE - 1);
+
+  for (size_t k = 0; k < stride; k++) {
+    data = decode_bytes(data, end, deltas.data(), aligned_count);
+    if (data == nullptr) {
+      return nullptr;
+    }
+
+    uint8_t previous = last_vertex[k];
+    for (size_t i = 0; i < count; i++) {
+      const uint8_t delta = uint8_t(-(deltas[i] & 1) ^ (deltas[i] >> 1));
+      previous = uint8_t(previous + delta);
+      out[i * stride + k] = previous;
+    }
+    last_vertex[k] = previous;
+  }
+  return data;
+}
+
+bool decode_meshopt_attributes(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src) {
+  if (stride == 0 || stride > 256 || stride % 4 != 0 || dst.size() < count * stride) {
+    return false;
+  }
+  const uint8_t* data = reinterpret_cast<const uint8_t*>(src.data());
+  const uint8_t* end = data + src.size();
+  const size_t tail_size = std::max(stride, VERTEX_TAIL_MIN_BYTES);
+  if (src.size() < 1 + tail_size || (data[0] & 0xf0) != VERTEX_HEADER || (data[0] & 0x0f) != 0) {
+    return false;
+  }
+  data++;
+
+  // the first block deltas against the vertex stored at the very end
+  std::array<uint8_t, 256> last_vertex;
+  memcpy(last_vertex.data(), end - stride, stride);
+
+  uint8_t* out = reinterpret_cast<uint8_t*>(dst.data());
+  const size_t block_count = vertex_block_count(stride);
+  for (size_t first = 0; first < count; first += block_count) {
+    const size_t block = std::min(block_count, count - first);
+    data = decode_vertex_block(data, end, out + first * stride, block, stride, last_vertex);
+    if (data == nullptr) {
+      return false;
+    }
+  }
+  return size_t(end - data) == tail_size;
+}
+
+// little endian base 128
+static uint32_t decode_vbyte(const uint8_t*& data) {
+  const uint8_t lead = *data++;
+  if (lead < 128) {
+    return lead;
+  }
+  uint32_t result = lead & 127;
+  uint32_t shift = 7;
+  for (int i = 0; i < 4; i++) {
+    const uint8_t group = *data++;
+    result |= uint32_t(group & 127) << shift;
+    shift += 7;
+    if (group < 128) {
+      break;
+    }
+  }
+  return result;
+}
+
+static uint32_t decode_index(const uint8_t*& data, uint32_t last) {
+  const uint32_t v = decode_vbyte(data);
+  return last + ((v >> 1) ^ uint32_t(-int32_t(v & 1)));
+}
+
+static void write_index(std::span<std::byte> dst, size_t stride, size_t i, uint32_t index) {
+  if (stride == 2) {
+    const uint16_t narrow = uint16_t(index);
+    memcpy(&dst[i * 2], &narrow, 2);
+  } else {
+    memcpy(&dst[i * 4], &index, 4);
+  }
+}
+
+bool decode_meshopt_triangles(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src) {
+  if ((stride != 2 && stride != 4) || count % 3 != 0 || dst.size() < count * stride) {
+    return false;
+  }
+  // one code per triangle plus the 16 byte table of common aux codes at the end
+  const uint8_t* buffer = reinterpret_cast<const uint8_t*>(src.data());
+  if (src.size() < 1 + count / 3 + 16 || (buffer[0] & 0xf0) != TRIANGLE_HEADER || (buffer[0] & 0x0f) > 1) {
+    return false;
+  }
+  const uint32_t version = buffer[0] & 0x0f;
+
+  // the last 16 edges and vertices, which codes refer back into
+  std::array<std::array<uint32_t, 2>, 16> edge_fifo;
+  std::array<uint32_t, 16> vertex_fifo;
+  for (auto& edge : edge_fifo) {
+    edge = {UINT32_MAX, UINT32_MAX};
+  }
+  vertex_fifo.fill(UINT32_MAX);
+  uint32_t edge_offset = 0;
+  uint32_t vertex_offset = 0;
+  auto push_edge = [&](uint32_t a, uint32_t b) {
+    edge_fifo[edge_offset] = {a, b};
+    edge_offset = (edge_offset + 1) & 15;
+  };
+  auto push_vertex = [&](uint32_t v, bool push = true) {
+    vertex_fifo[vertex_offset] = v;
+    vertex_offset = (vertex_offset + (push ? 1 : 0)) & 15;
+  };
+
+  // next is the next vertex never seen before, last the most recent explicitly coded index
+  uint32_t next = 0;
+  uint32_t last = 0;
+  // version 1 codes small steps from last as 13 and 14 instead of two more fifo slots
+  const int fec_max = version >= 1 ? 13 : 15;
+
+  const uint8_t* code = buffer + 1;
+  const uint8_t* data = code + count / 3;
+  const uint8_t* data_end = buffer + src.size() - 16;
+  const uint8_t* aux_table = data_end;
+
+  for (size_t i = 0; i < count; i += 3) {
+    // a triangle reads at most 16 bytes, which the aux table leaves room for
+    if (data > data_end) {
+      return false;
+    }
+    const uint8_t codetri = *code++;
+
+    if (codetri < 0xf0) {
+      // reuses a recent edge, the third vertex is new, from the fifo or explicit
+      const int fe = codetri >> 4;
+      const uint32_t a = edge_fifo[(edge_offset - 1 - fe) & 15][0];
+      const uint32_t b = edge_fifo[(edge_offset - 1 - fe) & 15][1];
+      const int fec = codetri & 15;
+
+      uint32_t c;
+      if (fec < fec_max) {
+        c = fec == 0 ? next++ : vertex_fifo[(vertex_offset - 1 - fec) & 15];
+        push_vertex(c, fec == 0);
+      } else {
+        // 13 and 14 step last by -1 and 1
+        last = c = fec != 15 ? last + (fec - (fec ^ 3)) : decode_index(data, last);
+        push_vertex(c);
+      }
+      write_index(dst, stride, i + 0, a);
+      write_index(dst, stride, i + 1, b);
+      write_index(dst, stride, i + 2, c);
+      push_edge(c, b);
+      push_edge(a, c);
+    } else if (codetri < 0xfe) {
+      // three vertices without a shared edge, the first new and the others looked up through the aux table
+      const uint8_t codeaux = aux_table[codetri & 15];
+      const int feb = codeaux >> 4;
+      const int fec = codeaux & 15;
+
+      const uint32_t a = next++;
+      const uint32_t b = feb == 0 ? next++ : vertex_fifo[(vertex_offset - feb) & 15];
+      const uint32_t c = fec == 0 ? next++ : vertex_fifo[(vertex_offset - fec) & 15];
+
+      write_index(dst, stride, i + 0, a);
+      write_index(dst, stride, i + 1, b);
+      write_index(dst, stride, i + 2, c);
+      push_vertex(a);
+      push_vertex(b, feb == 0);
+      push_vertex(c, fec == 0);
+      push_edge(b, a);
+      push_edge(c, b);
+      push_edge(a, c);
+    } else {
+      // like above with the aux code inline, and any of the three may be explicit
+      const uint8_t codeaux = *data++;
+      const int fea = codetri == 0xfe ? 0 : 15;
+      const int feb = codeaux >> 4;
+      const int fec = codeaux & 15;
+      if (codeaux == 0) {
+        next = 0;
+      }
+
+      uint32_t a = fea == 0 ? next++ : 0;
+      uint32_t b = feb == 0 ? next++ : vertex_fifo[(vertex_offset - feb) & 15];
+      uint32_t c = fec == 0 ? next++ : vertex_fifo[(vertex_offset - fec) & 15];
+      if (fea == 15) {
+        last = a = decode_index(data, last);
+      }
+      if (feb == 15) {
+        last = b = decode_index(data, last);
+      }
+      if (fec == 15) {
+        last = c = decode_index(data, last);
+      }
+
+      write_index(dst, stride, i + 0, a);
+      write_index(dst, stride, i + 1, b);
+      write_index(dst, stride, i + 2, c);
+      push_vertex(a);
+      push_vertex(b, feb == 0 || feb == 15);
+      push_vertex(c, fec == 0 || fec == 15);
+      push_edge(b, a);
+      push_edge(c, b);
+      push_edge(a, c);
+    }
+  }
+  return data == data_end;
+}
+
+bool decode_meshopt_indices(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src) {
+  if ((stride != 2 && stride != 4) || dst.size() < count * stride) {
+    return false;
+  }
+  // at least a byte per index, then 4 bytes of padding
+  const uint8_t* buffer = reinterpret_cast<const uint8_t*>(src.data());
+  if (src.size() < 1 + count + 4 || (buffer[0] & 0xf0) != SEQUENCE_HEADER || (buffer[0] & 0x0f) > 1) {
+    return false;
+  }
+
+  const uint8_t* data = buffer + 1;
+  const uint8_t* data_end = buffer + src.size() - 4;
+  // the low bit of every value picks which of the two baselines it's a delta from
+  std::array<uint32_t, 2> last{};
+  for (size_t i = 0; i < count; i++) {
+    // an index reads at most 5 bytes, which the padding leaves room for
+    if (data >= data_end) {
+      return false;
+    }
+    uint32_t v = decode_vbyte(data);
+    const uint32_t baseline = v & 1;
+    v >>= 1;
+    const uint32_t index = last[baseline] + ((v >> 1) ^ uint32_t(-int32_t(v & 1)));
+    last[baseline] = index;
+    write_index(dst, stride, i, index);
+  }
+  return data == data_end;
+}
+
+// the filters work one element at a time, copied out since the decoded view needn't be aligned for T
+template <typename T> static void decode_octahedral(std::byte* data, size_t count) {
+  const float max = float((1 << (sizeof(T) * 8 - 1)) - 1);
+  for (size_t i = 0; i < count; i++) {
+    std::array<T, 4> v;
+    memcpy(v.data(), data + i * sizeof(v), sizeof(v));
+
+    // z is stored as the value that means 1, x and y fold the lower hemisphere over the upper one
+    float x = float(v[0]);
+    float y = float(v[1]);
+    const float z = float(v[2]) - std::abs(x) - std::abs(y);
+    const float t = z < 0.f ? z : 0.f;
+    x += x >= 0.f ? t : -t;
+    y += y >= 0.f ? t : -t;
+
+    const float scale = max / std::sqrt(x * x + y * y + z * z);
+    v[0] = T(int(x * scale + (x >= 0.f ? 0.5f : -0.5f)));
+    v[1] = T(int(y * scale + (y >= 0.f ? 0.5f : -0.5f)));
+    v[2] = T(int(z * scale + (z >= 0.f ? 0.5f : -0.5f)));
+    memcpy(data + i * sizeof(v), v.data(), sizeof(v));
+  }
+}
+
+static void decode_quaternion(std::byte* data, size_t count) {
+  const float scale = 1.f / std::sqrt(2.f);
+  for (size_t i = 0; i < count; i++) {
+    std::array<int16_t, 4> v;
+    memcpy(v.data(), data + i * sizeof(v), sizeof(v));
+
+    // the fourth value holds the encoder's scale in its high bits and the dropped component in its low two
+    const float component_scale = scale / float(v[3] | 3);
+    const float x = float(v[0]) * component_scale;
+    const float y = float(v[1]) * component_scale;
+    const float z = float(v[2]) * component_scale;
+    const float ww = 1.f - x * x - y * y - z * z;
+    const float w = std::sqrt(ww >= 0.f ? ww : 0.f);
+
+    auto round = [](float f) { return int16_t(int(f * 32767.f + (f >= 0.f ? 0.5f : -0.5f))); };
+    const int dropped = v[3] & 3;
+    v[(dropped + 1) & 3] = round(x);
+    v[(dropped + 2) & 3] = round(y);
+    v[(dropped + 3) & 3] = round(z);
+    v[(dropped + 0) & 3] = round(w);
+    memcpy(data + i * sizeof(v), v.data(), sizeof(v));
+  }
+}
+
+static void decode_exponential(std::byte* data, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    uint32_t v;
+    memcpy(&v, data + i * 4, 4);
+    const int32_t mantissa = int32_t(v << 8) >> 8;
+    const int32_t exponent = int32_t(v) >> 24;
+    // ldexp(mantissa, exponent) by building 2^exponent directly
+    const float power = std::bit_cast<float>(uint32_t(exponent + 127) << 23);
+    v = std::bit_cast<uint32_t>(power * float(mantissa));
+    memcpy(data + i * 4, &v, 4);
+  }
+}
+
+void apply_meshopt_filter(std::span<std::byte> data, size_t count, size_t stride, MeshoptFilter filter) {
+  switch (filter) {
+  case MeshoptFilter::none:
+    break;
+  case MeshoptFilter::octahedral:
+    if (stride == 4) {
+      decode_octahedral<int8_t>(data.data(), count);
+    } else if (stride == 8) {
+      decode_octahedral<int16_t>(data.data(), count);
+    }
+    break;
+  case MeshoptFilter::quaternion:
+    if (stride == 8) {
+      decode_quaternion(data.data(), count);
+    }
+    break;
+  case MeshoptFilter::exponential:
+    decode_exponential(data.data(), count * stride / 4);
+    break;
+  }
+}
+
+bool decode_meshopt(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src,
+                    MeshoptMode mode, MeshoptFilter filter) {
+  switch (mode) {
+  case MeshoptMode::attributes:
+    if (!decode_meshopt_attributes(dst, count, stride, src)) {
+      return false;
+    }
+    apply_meshopt_filter(dst, count, stride, filter);
+    return true;
+  case MeshoptMode::triangles:
+    return decode_meshopt_triangles(dst, count, stride, src);
+  case MeshoptMode::indices:
+    return decode_meshopt_indices(dst, count, stride, src);
+  }
+  return false;
+}
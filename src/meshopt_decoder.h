@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// decoders for the bitstreams of EXT_meshopt_compression buffer views, following the extension spec. every
+// function writes count elements of stride bytes into dst, which has to hold count * stride bytes, and returns
+// false on a malformed stream
+
+enum class MeshoptMode : uint8_t {
+  // vertex attributes, delta coded per byte across a block of vertices
+  attributes,
+  // triangle lists, coded through edge and vertex fifos
+  triangles,
+  // any other index sequence, delta coded against two baselines
+  indices,
+};
+
+// applied to attributes after decoding
+enum class MeshoptFilter : uint8_t {
+  none,
+  // unit vectors as 8 or 16 bit octahedral coordinates
+  octahedral,
+  // unit quaternions with the largest component dropped
+  quaternion,
+  // floats as a shared exponent and a 24 bit mantissa
+  exponential,
+};
+
+bool decode_meshopt_attributes(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src);
+bool decode_meshopt_triangles(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src);
+bool decode_meshopt_indices(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src);
+void apply_meshopt_filter(std::span<std::byte> data, size_t count, size_t stride, MeshoptFilter filter);
+
+// one buffer view: the stream for mode, then the filter
+bool decode_meshopt(std::span<std::byte> dst, size_t count, size_t stride, std::span<const std::byte> src,
+                    MeshoptMode mode, MeshoptFilter filter);
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <render_list.h>
+
+RenderObject surface_object(const MeshAsset& mesh, const GeoSurface& surface, const glm::mat4& transform) {
+  RenderObject object;
+  object.material = &surface.material->data;
+  object.geometry_block = mesh.geometry.block;
+  object.vertex_offset = mesh.geometry.vertex_offset;
+  object.quantization = surface.quantization;
+  object.first_meshlet = mesh.geometry.first_meshlet + surface.first_meshlet;
+  object.double_sided = surface.material->double_sided;
+  object.bounds = surface.bounds;
+  object.transform = transform;
+  object.surface = &surface;
+  object.mesh_first_index = mesh.geometry.first_index;
+  set_lod(object, 0);
+  return object;
+}
+
+void set_lod(RenderObject& object, uint32_t level) {
+  const GeoSurface& surface = *object.surface;
+  object.lod = level;
+  object.index_count = level == 0 ? surface.count : surface.lods[level - 1].count;
+  object.first_index =
+      object.mesh_first_index + (level == 0 ? surface.startIndex : surface.lods[level - 1].start_index);
+  // meshlets are only built for the full detail level
+  object.meshlet_count = level == 0 ? surface.meshlet_count : 0;
+}
+
+RenderHandle RenderList::add(const RenderObject& object) {
+  const uint32_t list = object.material->pass_type == MaterialPass::Transparent ? TRANSPARENT : OPAQUE;
+
+  RenderHandle handle;
+  if (_free_handles.empty()) {
+    handle = static_cast<RenderHandle>(_slots.size());
+    _slots.emplace_back();
+  } else {
+    handle = _free_handles.back();
+    _free_handles.pop_back();
+  }
+
+  _slots[handle] = Slot{list, static_cast<uint32_t>(_objects[list].size())};
+  _objects[list].push_back(object);
+  _spheres[list].push_back(transform_sphere(object.bounds.origin, object.bounds.sphere_radius, object.transform));
+  _handles[list].push_back(handle);
+  _change_count++;
+  return handle;
+}
+
+void RenderList::remove(RenderHandle handle) {
+  const Slot slot = _slots[handle];
+  std::vector<RenderObject>& objects = _objects[slot.list];
+  std::vector<RenderHandle>& handles = _handles[slot.list];
+
+  // the last object fills the gap
+  const RenderHandle moved = handles.back();
+  objects[slot.index] = objects.back();
+  handles[slot.index] = moved;
+  _slots[moved].index = slot.index;
+  objects.pop_back();
+  handles.pop_back();
+  _spheres[slot.list].swap_remove(slot.index);
+  _bvh_reordered = _bvh_reordered || slot.list == OPAQUE;
+
+  _free_handles.push_back(handle);
+  _change_count++;
+}
+
+const RenderObject& RenderList::get(RenderHandle handle) const {
+  const Slot slot = _slots[handle];
+  return _objects[slot.list][slot.index];
+}
+
+void RenderList::set_transform(RenderHandle handle, const glm::mat4& transform) {
+  const Slot slot = _slots[handle];
+  RenderObject& object = _objects[slot.list][slot.index];
+  object.transform = transform;
+  _spheres[slot.list].set(slot.index, transform_sphere(object.bounds.origin, object.bounds.sphere_radius, transform));
+  _bvh_moved = _bvh_moved || (slot.list == OPAQUE && slot.index < _bvh.item_count());
+  _change_count++;
+}
+
+void RenderList::update_bvh() {
+  CullSpheres& spheres = _spheres[OPAQUE];
+  const size_t added = spheres.size() - std::min(spheres.size(), _bvh.item_count());
+  if (_bvh_reordered || added > _bvh.item_count() / 4) {
+    std::vector<uint32_t> order;
+    _bvh.build(spheres, spheres.size(), order);
+
+    // the opaque objects take the tree's order, so every subtree is a range of them
+    std::vector<RenderObject> objects;
+    std::vector<RenderHandle> handles;
+    CullSpheres ordered;
+    objects.reserve(order.size());
+    handles.reserve(order.size());
+    for (uint32_t index : order) {
+      objects.push_back(_objects[OPAQUE][index]);
+      handles.push_back(_handles[OPAQUE][index]);
+      ordered.push_back(glm::vec4{spheres.x[index], spheres.y[index], spheres.z[index], spheres.radius[index]});
+      _slots[handles.back()].index = static_cast<uint32_t>(handles.size() - 1);
+    }
+    _objects[OPAQUE] = std::move(objects);
+    _handles[OPAQUE] = std::move(handles);
+    spheres = std::move(ordered);
+    _bvh.refit(spheres);
+  } else if (_bvh_moved) {
+    _bvh.refit(spheres);
+  }
+  _bvh_moved = false;
+  _bvh_reordered = false;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cull_bvh.h>
+#include <frustum_cull.h>
+#include <span>
+#include <vector>
+#include <vk_loader.h>
+#include <vk_types.h>
+
+struct RenderObject {
+  uint32_t index_count;
+  // offsets into a block of the engine geometry pool
+  uint32_t geometry_block;
+  uint32_t first_index;
+  uint32_t vertex_offset;
+  VertexQuantization quantization;
+  // meshlets covering the index range, 0 when it has to be drawn whole
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+  bool double_sided;
+
+  Bounds bounds;
+  MaterialInstance* material;
+  glm::mat4 transform;
+
+  // the surface the object draws, the level in use and where its mesh starts in the pool. index_count, first_index
+  // and meshlet_count follow the level
+  const GeoSurface* surface;
+  uint32_t mesh_first_index;
+  uint32_t lod;
+};
+
+// object for a surface of a mesh in the geometry pool, at full detail
+RenderObject surface_object(const MeshAsset& mesh, const GeoSurface& surface, const glm::mat4& transform);
+// points the object's index range at the given level of its surface
+void set_lod(RenderObject& object, uint32_t level);
+
+// stays valid until the object is removed
+using RenderHandle = uint32_t;
+
+// render objects kept across frames. scenes add an object when its surface can be drawn, move it when its node's
+// transform changes and remove it on unload, so frames only pay for what changed. opaque and transparent objects
+// are each kept packed for the passes that walk them
+class RenderList {
+public:
+  // the object goes into the opaque or transparent list by its material's pass
+  RenderHandle add(const RenderObject& object);
+  void remove(RenderHandle handle);
+  const RenderObject& get(RenderHandle handle) const;
+  // moves the object and its bounding sphere
+  void set_transform(RenderHandle handle, const glm::mat4& transform);
+
+  std::span<RenderObject> opaque() { return _objects[OPAQUE]; }
+  std::span<RenderObject> transparent() { return _objects[TRANSPARENT]; }
+  // world space bounding sphere of every opaque object, at the same index
+  const CullSpheres& opaque_spheres() const { return _spheres[OPAQUE]; }
+  // hierarchy over the opaque spheres up to its item count. the objects added after it have to be culled linearly
+  const CullBvh& opaque_bvh() const { return _bvh; }
+  // brings the hierarchy up to date with the changes since the last call. moved objects only refit it. it is
+  // rebuilt after a removal, which reorders the objects, and once the objects added since the last build reach a
+  // quarter of it, so a scene streaming in rebuilds a logarithmic number of times. a rebuild puts the opaque
+  // objects in the tree's order, handles stay valid
+  void update_bvh();
+  size_t size() const { return _objects[OPAQUE].size() + _objects[TRANSPARENT].size(); }
+
+  // adds, removes and moves since the last call, how much the scenes changed the list
+  uint32_t take_change_count();
+
+private:
+  static constexpr uint32_t OPAQUE = 0;
+  static constexpr uint32_t TRANSPARENT = 1;
+
+  struct Slot {
+    uint32_t list;
+    uint32_t index;
+  };
+
+  std::array<std::vector<RenderObject>, 2> _objects;
+  std::array<CullSpheres, 2> _spheres;
+  // handle of every packed object, to fix up the slot of the object moved into a removed one's place
+  std::array<std::vector<RenderHandle>, 2> _handles;
+  std::vector<Slot> _slots;
+  std::vector<RenderHandle> _free_handles;
+  uint32_t _change_count{0};
+
+  CullBvh _bvh;
+  bool _bvh_moved{false};
+  bool _bvh_reordered{false};
+};
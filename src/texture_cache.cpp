@@ -0,0 +1,81 @@
+#include <texture_cache.h>
+#include <vk_engine.h>
+
+void TextureCache::init(VulkanEngine* engine) { _engine = engine; }
+
+void TextureCache::cleanup() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (auto& [key, entry] : _entries) {
+    const std::optional<CachedTexture>& texture = entry.texture.get();
+    if (!texture.has_value()) {
+      continue;
+    }
+    if (texture->stream != NO_STREAMED_TEXTURE) {
+      _engine->_texture_streamer.remove(texture->stream);
+    } else {
+      _engine->destroy_image(texture->image);
+    }
+  }
+  _entries.clear();
+}
+
+std::optional<CachedTexture> TextureCache::acquire(uint64_t key,
+                                                   const std::function<std::optional<CachedTexture>()>& create) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  if (auto it = _entries.find(key); it != _entries.end()) {
+    it->second.references++;
+    std::shared_future<std::optional<CachedTexture>> pending = it->second.texture;
+    lock.unlock();
+
+    // a failed create has already dropped the entry along with the references taken while it ran
+    std::optional<CachedTexture> texture = pending.get();
+    // a streamed texture's image changes with its resident levels
+    if (texture.has_value() && texture->stream != NO_STREAMED_TEXTURE) {
+      texture->image = _engine->_texture_streamer.image(texture->stream);
+    }
+    return texture;
+  }
+
+  if (!create) {
+    return {};
+  }
+  // the staging copy and submit happen outside the lock, so lookups of other keys don't wait on them
+  std::promise<std::optional<CachedTexture>> created;
+  _entries[key] = Entry{created.get_future().share(), 1};
+  lock.unlock();
+
+  std::optional<CachedTexture> texture = create();
+  if (!texture.has_value()) {
+    lock.lock();
+    _entries.erase(key);
+    lock.unlock();
+  }
+  created.set_value(texture);
+  return texture;
+}
+
+void TextureCache::release(uint64_t key) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto it = _entries.find(key);
+  if (it == _entries.end() || --it->second.references > 0) {
+    return;
+  }
+
+  // frames in flight can still sample it, so it goes once the current frame retires. a later acquire of the same
+  // key makes a new image instead of reviving this one. every reference was handed out with the texture, so it is
+  // ready
+  const CachedTexture texture = *it->second.texture.get();
+  _entries.erase(it);
+  if (texture.stream != NO_STREAMED_TEXTURE) {
+    _engine->_texture_streamer.remove(texture.stream);
+    return;
+  }
+  AllocatedImage image = texture.image;
+  VulkanEngine* engine = _engine;
+  _engine->get_current_frame().deletion_queue.push_function([=]() { engine->destroy_image(image); });
+}
+
+size_t TextureCache::size() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _entries.size();
+}
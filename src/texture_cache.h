@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <hash.h>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vk_types.h>
+
+class VulkanEngine;
+
+struct CachedTexture {
+  // for a streamed texture, the image holding its levels when it was acquired
+  AllocatedImage image;
+  // id in the engine's texture streamer, which owns the image when set
+  uint32_t stream{NO_STREAMED_TEXTURE};
+  // async upload that holds the image, or its tail levels when streamed
+  uint64_t ticket{0};
+};
+
+// engine wide set of uploaded textures, keyed by a hash of the encoded source bytes and the format they were
+// uploaded in. scenes that share a texture file or embedded image share one image, so later loads are a lookup
+class TextureCache {
+public:
+  void init(VulkanEngine* engine);
+  // destroys whatever is left, for engine shutdown once every scene is gone
+  void cleanup();
+
+  // returns the texture cached under key and takes a reference to it. on a miss create makes the texture outside the
+  // cache lock and it is cached with one reference. acquires of a key that is still being created wait for it, so two
+  // loaders never upload the same texture twice. nothing is cached when create is empty or fails
+  std::optional<CachedTexture> acquire(uint64_t key, const std::function<std::optional<CachedTexture>()>& create = {});
+  // drops a reference. the last one destroys the image once the frames in flight that might sample it retire, or
+  // removes a streamed texture from the streamer
+  void release(uint64_t key);
+
+  size_t size();
+
+private:
+  // the texture is ready once its create returns, empty when it failed
+  struct Entry {
+    std::shared_future<std::optional<CachedTexture>> texture;
+    uint32_t references;
+  };
+
+  VulkanEngine* _engine;
+  std::mutex _mutex;
+  std::unordered_map<uint64_t, Entry> _entries;
+};
+
+// cache key for a texture decoded from source bytes with the given hash into format
+inline uint64_t texture_cache_key(uint64_t source_hash, VkFormat format) {
+  return hash_combine(source_hash, static_cast<uint64_t>(format));
+}
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <texture_streamer.h>
+#include <vk_engine.h>
+
+// level changes uploading at once. keeps a camera cut from queueing hundreds of megabytes in one frame
+constexpr uint32_t MAX_PENDING_CHANGES = 8;
+
+static VkDeviceSize level_bytes(const Ktx2Image& source, uint32_t level) {
+  const VkDeviceSize blocks_x = (std::max(source.width >> level, 1u) + 3) / 4;
+  const VkDeviceSize blocks_y = (std::max(source.height >> level, 1u) + 3) / 4;
+  return blocks_x * blocks_y * bc_block_size(source.format);
+}
+
+static uint32_t last_level(const Ktx2Image& source) { return static_cast<uint32_t>(source.level_offsets.size()) - 1; }
+
+// first level whose larger side fits STREAM_TAIL_EXTENT, or the smallest level the file has
+static uint32_t tail_level(const Ktx2Image& source) {
+  uint32_t level = 0;
+  while (level < last_level(source) && std::max(source.width >> level, source.height >> level) > STREAM_TAIL_EXTENT) {
+    level++;
+  }
+  return level;
+}
+
+bool TextureStreamer::worth_streaming(const Ktx2Image& source) { return tail_level(source) > 0; }
+
+VkDeviceSize TextureStreamer::chain_bytes(const Ktx2Image& source, uint32_t first, uint32_t last) {
+  VkDeviceSize bytes = 0;
+  for (uint32_t level = first; level <= last; level++) {
+    bytes += level_bytes(source, level);
+  }
+  return bytes;
+}
+
+void TextureStreamer::init(VulkanEngine* engine, VkDeviceSize budget) {
+  _engine = engine;
+  _budget = budget;
+}
+
+void TextureStreamer::drain() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (std::unique_ptr<StreamedTexture>& texture : _textures) {
+    if (texture != nullptr && texture->pending.valid()) {
+      texture->uploaded = texture->pending.get();
+    }
+  }
+}
+
+void TextureStreamer::cleanup() {
+  drain();
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  // workers may have submitted uploads after the last frame, and their images are destroyed below
+  {
+    std::lock_guard<std::mutex> queue_lock(_engine->_queue_mutex);
+    vkDeviceWaitIdle(_engine->_device);
+  }
+
+  for (std::unique_ptr<StreamedTexture>& texture : _textures) {
+    if (texture == nullptr) {
+      continue;
+    }
+    if (texture->uploaded.has_value()) {
+      _engine->destroy_image(texture->uploaded->image);
+    }
+    if (!texture->removed) {
+      _engine->destroy_image(texture->image);
+    }
+  }
+  _textures.clear();
+  _free_ids.clear();
+}
+
+AllocatedImage TextureStreamer::create_levels(UploadBatch& batch, const StreamedTexture& texture, uint32_t first) {
+  const Ktx2Image& source = texture.source;
+  const uint32_t last = last_level(source);
+
+  // the levels are one contiguous range of the chain, whatever order the file stored them in
+  VkDeviceSize begin = UINT64_MAX;
+  VkDeviceSize end = 0;
+  for (uint32_t level = first; level <= last; level++) {
+    begin = std::min(begin, source.level_offsets[level]);
+    end = std::max(end, source.level_offsets[level] + level_bytes(source, level));
+  }
+
+  std::vector<VkDeviceSize> offsets;
+  for (uint32_t level = first; level <= last; level++) {
+    offsets.push_back(source.level_offsets[level] - begin);
+  }
+
+  VkExtent3D extent{std::max(source.width >> first, 1u), std::max(source.height >> first, 1u), 1};
+  return _engine->create_compressed_image(batch, source.data.data() + begin, end - begin, offsets, extent,
+                                          source.format, VK_IMAGE_USAGE_SAMPLED_BIT);
+}
+
+uint32_t TextureStreamer::add(Ktx2Image&& source, UploadBatch& batch) {
+  auto texture = std::make_unique<StreamedTexture>();
+  texture->source = std::move(source);
+  texture->tail_level = tail_level(texture->source);
+  texture->resident_level = texture->tail_level;
+  texture->requested_level = texture->tail_level + 1;
+  texture->image = create_levels(batch, *texture, texture->tail_level);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _resident_bytes += chain_bytes(texture->source, texture->tail_level, last_level(texture->source));
+  _texture_count++;
+
+  uint32_t id;
+  if (_free_ids.empty()) {
+    id = static_cast<uint32_t>(_textures.size());
+    _textures.push_back(std::move(texture));
+  } else {
+    id = _free_ids.back();
+    _free_ids.pop_back();
+    _textures[id] = std::move(texture);
+  }
+  return id;
+}
+
+void TextureStreamer::remove(uint32_t id) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  StreamedTexture& texture = *_textures[id];
+
+  // a change in flight still owns its source and its new image, the slot is freed in update once it lands. its
+  // old image is already counted as releasing
+  const VkDeviceSize bytes = chain_bytes(texture.source, texture.resident_level, last_level(texture.source));
+  if (!texture.changing()) {
+    _releasing_bytes += bytes;
+  }
+  _texture_count--;
+  retire(texture.image, bytes);
+  texture.removed = true;
+  texture.watchers.clear();
+
+  if (!texture.changing()) {
+    _textures[id].reset();
+    _free_ids.push_back(id);
+  }
+}
+
+AllocatedImage TextureStreamer::image(uint32_t id) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _textures[id]->image;
+}
+
+void TextureStreamer::watch(uint32_t id, const void* owner, std::function<void(const AllocatedImage&)> on_change) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _textures[id]->watchers.push_back(Watcher{owner, std::move(on_change)});
+}
+
+void TextureStreamer::unwatch(const void* owner) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (std::unique_ptr<StreamedTexture>& texture : _textures) {
+    if (texture != nullptr) {
+      std::erase_if(texture->watchers, [&](const Watcher& watcher) { return watcher.owner == owner; });
+    }
+  }
+}
+
+void TextureStreamer::request(std::span<const std::pair<uint32_t, float>> footprints) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (const auto& [id, pixels] : footprints) {
+    // a scene that is unloading may still report textures that are gone
+    if (id >= _textures.size() || _textures[id] == nullptr || _textures[id]->removed) {
+      continue;
+    }
+    StreamedTexture& texture = *_textures[id];
+
+    // level whose larger side is closest to the covered pixels without going under them
+    const uint32_t extent = std::max(texture.source.width, texture.source.height);
+    const float ratio = float(extent) / std::max(pixels, 1.f);
+    const uint32_t level = ratio <= 1.f ? 0 : static_cast<uint32_t>(std::floor(std::log2(ratio)));
+
+    texture.requested_level = std::min({texture.requested_level, level, texture.tail_level});
+    texture.last_needed_frame = _frame;
+  }
+}
+
+void TextureStreamer::retire(const AllocatedImage& image, VkDeviceSize bytes) {
+  _engine->get_current_frame().deletion_queue.push_function([this, image, bytes]() {
+    _engine->destroy_image(image);
+    std::lock_guard<std::mutex> lock(_mutex);
+    _resident_bytes -= bytes;
+    _releasing_bytes -= bytes;
+  });
+}
+
+// the old image keeps counting until it is retired after the swap, so both chains are counted while the change is
+// in flight
+void TextureStreamer::start_change(StreamedTexture& texture, uint32_t level) {
+  const Ktx2Image& source = texture.source;
+  _resident_bytes += chain_bytes(source, level, last_level(source));
+  _releasing_bytes += chain_bytes(source, texture.resident_level, last_level(source));
+
+  texture.pending_level = level;
+  _pending_count++;
+
+  StreamedTexture* target = &texture;
+  texture.pending = _engine->_thread_pool.submit([this, target, level]() {
+    UploadBatch batch{_engine};
+    LevelChange change;
+    change.image = create_levels(batch, *target, level);
+    change.ticket = _engine->_async_uploader.submit(std::move(batch));
+    return change;
+  });
+}
+
+void TextureStreamer::set_budget(VkDeviceSize budget) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _budget = budget;
+}
+
+void TextureStreamer::update(uint64_t frame) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // the uploader has to have handed a new image to the graphics queue before any descriptor points at it
+  for (uint32_t id = 0; id < _textures.size(); id++) {
+    StreamedTexture* texture = _textures[id].get();
+    if (texture == nullptr || !texture->changing()) {
+      continue;
+    }
+    if (texture->pending.valid() && texture->pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+      texture->uploaded = texture->pending.get();
+    }
+    if (!texture->uploaded.has_value() || !_engine->_async_uploader.is_resident(texture->uploaded->ticket)) {
+      continue;
+    }
+
+    LevelChange change = *texture->uploaded;
+    texture->uploaded.reset();
+    _pending_count--;
+
+    const VkDeviceSize new_bytes = chain_bytes(texture->source, texture->pending_level, last_level(texture->source));
+    if (texture->removed) {
+      _releasing_bytes += new_bytes;
+      retire(change.image, new_bytes);
+      _textures[id].reset();
+      _free_ids.push_back(id);
+      continue;
+    }
+
+    retire(texture->image, chain_bytes(texture->source, texture->resident_level, last_level(texture->source)));
+    texture->image = change.image;
+    texture->resident_level = texture->pending_level;
+    for (Watcher& watcher : texture->watchers) {
+      watcher.on_change(texture->image);
+    }
+  }
+
+  // textures asked for more detail last frame, the ones covering the most of the screen go first
+  std::vector<StreamedTexture*> upgrades;
+  std::vector<StreamedTexture*> victims;
+  for (std::unique_ptr<StreamedTexture>& texture : _textures) {
+    if (texture == nullptr || texture->removed || texture->changing()) {
+      continue;
+    }
+    if (texture->requested_level < texture->resident_level) {
+      upgrades.push_back(texture.get());
+    } else if (texture->resident_level < texture->tail_level && texture->last_needed_frame < _frame) {
+      victims.push_back(texture.get());
+    }
+  }
+  std::sort(upgrades.begin(), upgrades.end(),
+            [](const StreamedTexture* a, const StreamedTexture* b) { return a->requested_level < b->requested_level; });
+  // least recently needed first
+  std::sort(victims.begin(), victims.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+    return a->last_needed_frame < b->last_needed_frame;
+  });
+
+  size_t next_victim = 0;
+  for (StreamedTexture* texture : upgrades) {
+    if (_pending_count >= MAX_PENDING_CHANGES) {
+      break;
+    }
+
+    // the new chain is created next to the old one, which only goes once the frames sampling it retire
+    const uint32_t last = last_level(texture->source);
+    const VkDeviceSize requested = chain_bytes(texture->source, texture->requested_level, last);
+    const VkDeviceSize resident = chain_bytes(texture->source, texture->resident_level, last);
+
+    // make room by dropping the least recently needed textures to their tail. what they free only counts once
+    // their old images are destroyed, so the upgrade may have to wait a few frames for it
+    while (_resident_bytes - _releasing_bytes - resident + requested > _budget && next_victim < victims.size() &&
+           _pending_count < MAX_PENDING_CHANGES) {
+      StreamedTexture* victim = victims[next_victim++];
+      start_change(*victim, victim->tail_level);
+    }
+    if (_pending_count >= MAX_PENDING_CHANGES) {
+      break;
+    }
+
+    // take the finest level that fits next to everything still alive, which may be short of the request
+    for (uint32_t level = texture->requested_level; level < texture->resident_level; level++) {
+      if (_resident_bytes + chain_bytes(texture->source, level, last) <= _budget) {
+        start_change(*texture, level);
+        break;
+      }
+    }
+  }
+
+  // the next frame's culling fills these in again
+  for (std::unique_ptr<StreamedTexture>& texture : _textures) {
+    if (texture != nullptr) {
+      texture->requested_level = texture->tail_level + 1;
+    }
+  }
+  _frame = frame;
+}
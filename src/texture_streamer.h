@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <ktx2.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+#include <vk_types.h>
+
+class VulkanEngine;
+class UploadBatch;
+
+// levels no larger than this stay resident for as long as the texture is loaded, everything finer is streamed
+constexpr uint32_t STREAM_TAIL_EXTENT = 64;
+
+// keeps block compressed textures with prebuilt mip chains at the detail the screen needs. a texture starts out
+// with only its tail levels, culling reports how many pixels each texture covers, and finer levels are uploaded
+// from worker threads while the resident total stays under a vram budget. when it doesn't fit, the textures needed
+// least recently drop back to their tail.
+//
+// a level change makes a new image, so anything that samples a texture has to watch it and rebind
+class TextureStreamer {
+public:
+  void init(VulkanEngine* engine, VkDeviceSize budget);
+  // waits for the level changes on workers, which submit to the engine's uploader. for shutdown, before the uploader
+  // goes and once update no longer runs
+  void drain();
+  void cleanup();
+
+  // true when the chain has levels above the tail, smaller textures are cheaper to keep whole
+  static bool worth_streaming(const Ktx2Image& source);
+
+  // takes over the chain, keeps it in system memory and stages only the tail into batch. returns the texture's id
+  uint32_t add(Ktx2Image&& source, UploadBatch& batch);
+  // the image goes once the frames that might sample it retire
+  void remove(uint32_t id);
+  AllocatedImage image(uint32_t id);
+
+  // on_change gets the new image after every level change, on the thread that calls update. owner lets
+  // unwatch drop every callback a scene registered
+  void watch(uint32_t id, const void* owner, std::function<void(const AllocatedImage&)> on_change);
+  void unwatch(const void* owner);
+
+  // screen pixels each texture covered this frame, from culling. a texture covering fewer pixels than its
+  // finest level has texels doesn't need that level
+  void request(std::span<const std::pair<uint32_t, float>> footprints);
+
+  // once per frame after the frame's deletion queue flushed: swaps in finished level changes, then starts new
+  // ones for the textures that need more detail, evicting within the budget
+  void update(uint64_t frame);
+
+  void set_budget(VkDeviceSize budget);
+  VkDeviceSize budget() const { return _budget; }
+  VkDeviceSize resident_bytes() const { return _resident_bytes; }
+  uint32_t texture_count() const { return _texture_count; }
+  uint32_t pending_count() const { return _pending_count; }
+
+private:
+  struct LevelChange {
+    AllocatedImage image;
+    uint64_t ticket;
+  };
+
+  struct Watcher {
+    const void* owner;
+    std::function<void(const AllocatedImage&)> on_change;
+  };
+
+  struct StreamedTexture {
+    Ktx2Image source;
+    AllocatedImage image;
+    // finest level in image, and the coarsest level that always stays
+    uint32_t resident_level;
+    uint32_t tail_level;
+    // finest level asked for this frame, tail_level + 1 when nothing asked
+    uint32_t requested_level;
+    uint64_t last_needed_frame{0};
+    // a level change being staged on a worker, then uploaded until the graphics queue has acquired it. at most
+    // one per texture
+    std::future<LevelChange> pending;
+    std::optional<LevelChange> uploaded;
+    uint32_t pending_level;
+    bool removed{false};
+    std::vector<Watcher> watchers;
+
+    bool changing() const { return pending.valid() || uploaded.has_value(); }
+  };
+
+  // bytes of levels first..tail of the chain
+  static VkDeviceSize chain_bytes(const Ktx2Image& source, uint32_t first, uint32_t last);
+  // image holding levels first..tail_level staged into batch
+  AllocatedImage create_levels(UploadBatch& batch, const StreamedTexture& texture, uint32_t first);
+  void start_change(StreamedTexture& texture, uint32_t level);
+  // destroys the image once the frames that might sample it retire. its bytes, which have to be counted in
+  // _releasing_bytes already, stop counting then
+  void retire(const AllocatedImage& image, VkDeviceSize bytes);
+
+  VulkanEngine* _engine;
+  VkDeviceSize _budget{0};
+  // bytes of every image that exists: the resident ones, the new images of changes in flight and the images
+  // replaced or removed that frames in flight may still sample
+  VkDeviceSize _resident_bytes{0};
+  // the part of _resident_bytes that is on its way out, the images that changes in flight will replace and the
+  // retired ones
+  VkDeviceSize _releasing_bytes{0};
+  uint64_t _frame{0};
+  uint32_t _texture_count{0};
+  uint32_t _pending_count{0};
+
+  // loaders add textures from their own threads
+  std::mutex _mutex;
+  std::vector<std::unique_ptr<StreamedTexture>> _textures;
+  std::vector<uint32_t> _free_ids;
+};
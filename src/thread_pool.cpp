@@ -0,0 +1,39 @@
+#include <thread_pool.h>
+
+ThreadPool::ThreadPool(uint32_t thread_count) {
+  _workers.reserve(thread_count);
+  for (uint32_t i{0}; i < thread_count; ++i) {
+    _workers.emplace_back([this]() { worker_loop(); });
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _cv.notify_all();
+
+  for (auto& worker : _workers) {
+    worker.join();
+  }
+}
+
+void ThreadPool::worker_loop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _cv.wait(lock, [this]() { return _stopping || !_tasks.empty(); });
+
+      // finish whatever is still queued before shutting down
+      if (_stopping && _tasks.empty()) {
+        return;
+      }
+
+      task = std::move(_tasks.front());
+      _tasks.pop_front();
+    }
+    task();
+  }
+}
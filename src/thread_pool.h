@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// fixed size pool of worker threads. used for cpu heavy loading work like image decoding
+class ThreadPool {
+public:
+  explicit ThreadPool(uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency()));
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // queue a task and get a future for its result
+  template <typename F> std::future<std::invoke_result_t<F>> submit(F&& func) {
+    using Result = std::invoke_result_t<F>;
+
+    // std::function needs a copyable callable, so the task lives behind a shared_ptr
+    auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(func));
+    std::future<Result> result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _tasks.emplace_back([task]() { (*task)(); });
+    }
+    _cv.notify_one();
+    return result;
+  }
+
+  uint32_t thread_count() const { return static_cast<uint32_t>(_workers.size()); }
+
+private:
+  void worker_loop();
+
+  std::vector<std::thread> _workers;
+  std::deque<std::function<void()>> _tasks;
+  std::mutex _mutex;
+  std::condition_variable _cv;
+  bool _stopping{false};
+};
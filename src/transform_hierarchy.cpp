@@ -0,0 +1,136 @@
+#include <algorithm>
+#include <transform_hierarchy.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRANSFORM_HIERARCHY_SSE
+#endif
+
+// out = a * b for column major matrices. every column of out is a sum of a's columns, four lanes at a time
+static inline void multiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& out) {
+#ifdef TRANSFORM_HIERARCHY_SSE
+  // glm stores the columns back to back
+  const float* lhs = reinterpret_cast<const float*>(&a);
+  const float* rhs = reinterpret_cast<const float*>(&b);
+  float* result = reinterpret_cast<float*>(&out);
+  const __m128 a0 = _mm_loadu_ps(lhs);
+  const __m128 a1 = _mm_loadu_ps(lhs + 4);
+  const __m128 a2 = _mm_loadu_ps(lhs + 8);
+  const __m128 a3 = _mm_loadu_ps(lhs + 12);
+  for (int column = 0; column < 4; column++) {
+    const float* b_column = rhs + column * 4;
+    __m128 sum = _mm_mul_ps(a0, _mm_set1_ps(b_column[0]));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a1, _mm_set1_ps(b_column[1])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a2, _mm_set1_ps(b_column[2])));
+    sum = _mm_add_ps(sum, _mm_mul_ps(a3, _mm_set1_ps(b_column[3])));
+    _mm_storeu_ps(result + column * 4, sum);
+  }
+#else
+  out = a * b;
+#endif
+}
+
+std::vector<uint32_t> TransformHierarchy::build(std::span<const uint32_t> parents, std::span<const glm::mat4> locals) {
+  const uint32_t count = static_cast<uint32_t>(parents.size());
+
+  std::vector<std::vector<uint32_t>> children(count);
+  for (uint32_t node = 0; node < count; node++) {
+    if (parents[node] != NO_PARENT) {
+      children[parents[node]].push_back(node);
+    }
+  }
+
+  _local.clear();
+  _parent.clear();
+  _subtree_size.clear();
+  _local.reserve(count);
+  _parent.reserve(count);
+  _subtree_size.reserve(count);
+
+  std::vector<uint32_t> index(count, NO_PARENT);
+  // pre order depth first walk. subtree sizes are filled in once a node's whole subtree has been placed
+  struct Visit {
+    uint32_t node;
+    uint32_t next_child;
+  };
+  std::vector<Visit> stack;
+  auto place = [&](uint32_t node, uint32_t parent_index) {
+    index[node] = static_cast<uint32_t>(_parent.size());
+    _local.push_back(locals[node]);
+    _parent.push_back(parent_index);
+    _subtree_size.push_back(1);
+    stack.push_back(Visit{node, 0});
+  };
+  auto walk = [&](uint32_t root) {
+    place(root, NO_PARENT);
+    while (!stack.empty()) {
+      Visit& visit = stack.back();
+      if (visit.next_child < children[visit.node].size()) {
+        const uint32_t child = children[visit.node][visit.next_child++];
+        // a node reached twice would break the parents before children order, it keeps its first place
+        if (index[child] == NO_PARENT) {
+          place(child, index[visit.node]);
+        }
+        continue;
+      }
+      const uint32_t placed = index[visit.node];
+      _subtree_size[placed] = static_cast<uint32_t>(_parent.size()) - placed;
+      stack.pop_back();
+    }
+  };
+
+  for (uint32_t node = 0; node < count; node++) {
+    if (parents[node] == NO_PARENT) {
+      walk(node);
+    }
+  }
+  // nodes on a parent cycle are never reached from a root, they become roots themselves
+  for (uint32_t node = 0; node < count; node++) {
+    if (index[node] == NO_PARENT) {
+      walk(node);
+    }
+  }
+
+  _world.assign(count, glm::mat4{1.f});
+  _dirty.assign(count, 1);
+  _first_dirty = 0;
+  return index;
+}
+
+void TransformHierarchy::set_local(uint32_t node, const glm::mat4& local) {
+  _local[node] = local;
+  _dirty[node] = 1;
+  _first_dirty = std::min(_first_dirty, node);
+}
+
+size_t TransformHierarchy::update() {
+  const uint32_t count = static_cast<uint32_t>(_parent.size());
+  size_t updated = 0;
+  _updated.clear();
+
+  uint32_t node = _first_dirty;
+  while (node < count) {
+    if (_dirty[node] == 0) {
+      node++;
+      continue;
+    }
+
+    // the whole subtree is recomputed in order, every parent's world matrix is final before its children read it
+    const uint32_t end = node + _subtree_size[node];
+    for (uint32_t i = node; i < end; i++) {
+      const uint32_t parent = _parent[i];
+      if (parent == NO_PARENT) {
+        _world[i] = _local[i];
+      } else {
+        multiply(_world[parent], _local[i], _world[i]);
+      }
+      _dirty[i] = 0;
+    }
+    updated += end - node;
+    _updated.push_back(Range{node, end - node});
+    node = end;
+  }
+
+  _first_dirty = UINT32_MAX;
+  return updated;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+#include <span>
+#include <vector>
+
+// flat store of a node hierarchy's transforms, structure of arrays. nodes are laid out depth first, so every parent
+// comes before its children and a node's subtree is the range right after it. world matrices are recomputed in one
+// linear pass that only visits the subtrees of nodes whose local matrix changed
+class TransformHierarchy {
+public:
+  static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+  // nodes first to first + count - 1
+  struct Range {
+    uint32_t first;
+    uint32_t count;
+  };
+
+  // replaces the store with the given nodes, in any order. parents index the same spans, NO_PARENT for roots.
+  // returns each node's index in the store. every node starts out dirty
+  std::vector<uint32_t> build(std::span<const uint32_t> parents, std::span<const glm::mat4> locals);
+
+  void set_local(uint32_t node, const glm::mat4& local);
+
+  const glm::mat4& local(uint32_t node) const { return _local[node]; }
+  const glm::mat4& world(uint32_t node) const { return _world[node]; }
+  uint32_t parent(uint32_t node) const { return _parent[node]; }
+  size_t size() const { return _parent.size(); }
+
+  // recomputes the world matrices of dirty nodes and everything below them. returns how many were recomputed
+  size_t update();
+  // nodes whose world matrix the last update recomputed, in order
+  std::span<const Range> updated() const { return _updated; }
+
+private:
+  std::vector<glm::mat4> _local;
+  std::vector<glm::mat4> _world;
+  std::vector<uint32_t> _parent;
+  // nodes in the subtree, the node included
+  std::vector<uint32_t> _subtree_size;
+  std::vector<uint8_t> _dirty;
+  // no node before this one is dirty
+  uint32_t _first_dirty{UINT32_MAX};
+  std::vector<Range> _updated;
+};
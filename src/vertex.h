@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+// interleaved vertex as read by the mesh shaders through the vertex buffer address. kept free of vulkan
+// headers so cpu side mesh processing can be built on its own
+struct Vertex {
+  glm::vec3 position;
+  float uv_x;
+  glm::vec3 normal;
+  float uv_y;
+  glm::vec4 color;
+};
+
+// 16 byte vertex used with VertexFormat::Packed, decoded in mesh_packed.vert
+struct PackedVertex {
+  // unorm16, relative to the surface's VertexQuantization
+  uint16_t position[3];
+  // octahedral encoded, snorm8
+  int8_t normal[2];
+  // half2
+  uint32_t uv;
+  // unorm8x4
+  uint32_t color;
+};
+
+// maps packed positions back to object space: position = offset + q / 65535 * scale
+struct VertexQuantization {
+  glm::vec3 offset;
+  glm::vec3 scale;
+};
+
+enum class VertexFormat : uint8_t {
+  Full,
+  Packed,
+};
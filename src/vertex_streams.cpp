@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <glm/glm.hpp>
+#include <limits>
+#include <vertex_streams.h>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// the sse path stores position + uv_x and normal + uv_y as two 16 byte halves
+static_assert(sizeof(Vertex) == 48);
+static_assert(offsetof(Vertex, uv_x) == 12 && offsetof(Vertex, normal) == 16 && offsetof(Vertex, color) == 32);
+// mesh_packed.vert reads every packed vertex as one uvec4
+static_assert(sizeof(PackedVertex) == 16);
+static_assert(offsetof(PackedVertex, normal) == 6 && offsetof(PackedVertex, uv) == 8);
+
+PositionBounds write_positions(std::span<Vertex> dst, std::span<const glm::vec3> positions) {
+  const size_t count = positions.size();
+
+#if defined(__SSE2__)
+  const float* src = &positions[0].x;
+
+  // clears the lane that lands on uv_x
+  const __m128 xyz_mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+  const __m128 default_normal = _mm_set_ps(0.f, 0.f, 0.f, 1.f);
+  const __m128 default_color = _mm_set1_ps(1.f);
+
+  __m128 min = _mm_set1_ps(std::numeric_limits<float>::max());
+  __m128 max = _mm_set1_ps(std::numeric_limits<float>::lowest());
+
+  auto write = [&](size_t i, __m128 position) {
+    // the fourth lane of the bounds is never read, so it doesn't matter what ends up in it
+    min = _mm_min_ps(min, position);
+    max = _mm_max_ps(max, position);
+
+    float* out = &dst[i].position.x;
+    _mm_storeu_ps(out, _mm_and_ps(position, xyz_mask));
+    _mm_storeu_ps(out + 4, default_normal);
+    _mm_storeu_ps(out + 8, default_color);
+  };
+
+  // a 16 byte load reads one float past the position, so the last one is loaded separately
+  for (size_t i{0}; i + 1 < count; ++i) {
+    write(i, _mm_loadu_ps(src + i * 3));
+  }
+  const float* last = src + (count - 1) * 3;
+  write(count - 1, _mm_set_ps(0.f, last[2], last[1], last[0]));
+
+  alignas(16) float min_out[4];
+  alignas(16) float max_out[4];
+  _mm_store_ps(min_out, min);
+  _mm_store_ps(max_out, max);
+
+  return {{min_out[0], min_out[1], min_out[2]}, {max_out[0], max_out[1], max_out[2]}};
+#else
+  PositionBounds bounds{positions[0], positions[0]};
+  for (size_t i{0}; i < count; ++i) {
+    const glm::vec3 p = positions[i];
+    bounds.min = glm::min(bounds.min, p);
+    bounds.max = glm::max(bounds.max, p);
+
+    Vertex& v = dst[i];
+    v.position = p;
+    v.uv_x = 0.f;
+    v.normal = {1.f, 0.f, 0.f};
+    v.uv_y = 0.f;
+    v.color = glm::vec4{1.f};
+  }
+  return bounds;
+#endif
+}
+
+void write_normals(std::span<Vertex> dst, std::span<const glm::vec3> normals) {
+  for (size_t i{0}; i < normals.size(); ++i) {
+    dst[i].normal = normals[i];
+  }
+}
+
+void write_uvs(std::span<Vertex> dst, std::span<const glm::vec2> uvs) {
+  for (size_t i{0}; i < uvs.size(); ++i) {
+    dst[i].uv_x = uvs[i].x;
+    dst[i].uv_y = uvs[i].y;
+  }
+}
+
+void write_colors(std::span<Vertex> dst, std::span<const glm::vec4> colors) {
+  for (size_t i{0}; i < colors.size(); ++i) {
+    dst[i].color = colors[i];
+  }
+}
+
+VertexQuantization quantization_for_bounds(const PositionBounds& bounds) {
+  glm::vec3 scale = bounds.max - bounds.min;
+  for (int axis{0}; axis < 3; ++axis) {
+    if (!(scale[axis] > 0.f)) {
+      scale[axis] = 1.f;
+    }
+  }
+  return {bounds.min, scale};
+}
+
+static int8_t pack_snorm8(float v) { return static_cast<int8_t>(std::round(std::clamp(v, -1.f, 1.f) * 127.f)); }
+
+// octahedral mapping of the unit sphere onto [-1, 1]^2, the lower hemisphere is folded over the diagonals
+static glm::vec2 octahedral_encode(glm::vec3 n) {
+  n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  glm::vec2 e{n.x, n.y};
+  if (n.z < 0.f) {
+    e.x = (1.f - std::abs(n.y)) * (n.x >= 0.f ? 1.f : -1.f);
+    e.y = (1.f - std::abs(n.x)) * (n.y >= 0.f ? 1.f : -1.f);
+  }
+  return e;
+}
+
+void pack_vertices(std::span<PackedVertex> dst, std::span<const Vertex> src, const VertexQuantization& quantization) {
+  const glm::vec3 to_grid = 65535.f / quantization.scale;
+
+  for (size_t i{0}; i < src.size(); ++i) {
+    const Vertex& v = src[i];
+    PackedVertex& p = dst[i];
+
+    const glm::vec3 q = glm::clamp(glm::round((v.position - quantization.offset) * to_grid), 0.f, 65535.f);
+    p.position[0] = static_cast<uint16_t>(q.x);
+    p.position[1] = static_cast<uint16_t>(q.y);
+    p.position[2] = static_cast<uint16_t>(q.z);
+
+    // a zero normal would divide by zero in the encode, point it somewhere instead
+    const bool has_normal = std::abs(v.normal.x) + std::abs(v.normal.y) + std::abs(v.normal.z) > 0.f;
+    const glm::vec2 n = octahedral_encode(has_normal ? v.normal : glm::vec3{0.f, 0.f, 1.f});
+    p.normal[0] = pack_snorm8(n.x);
+    p.normal[1] = pack_snorm8(n.y);
+
+    p.uv = glm::packHalf2x16(glm::vec2{v.uv_x, v.uv_y});
+    p.color = glm::packUnorm4x8(v.color);
+  }
+}
+
+void offset_indices(std::span<uint32_t> indices, uint32_t base) {
+  for (uint32_t& index : indices) {
+    index += base;
+  }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <span>
+#include <vertex.h>
+
+// bulk conversion of tightly packed attribute streams into the interleaved Vertex layout. the loader copies
+// each glTF accessor into a contiguous stream first, so these loops run over plain arrays with no per element
+// callbacks
+
+struct PositionBounds {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// writes positions into dst and resets every other attribute to its default. the bounds of the written
+// positions are gathered in the same pass. dst and positions must be the same size and not empty
+PositionBounds write_positions(std::span<Vertex> dst, std::span<const glm::vec3> positions);
+
+void write_normals(std::span<Vertex> dst, std::span<const glm::vec3> normals);
+void write_uvs(std::span<Vertex> dst, std::span<const glm::vec2> uvs);
+void write_colors(std::span<Vertex> dst, std::span<const glm::vec4> colors);
+
+// range that covers the bounds. degenerate axes get a unit scale so packing never divides by zero
+VertexQuantization quantization_for_bounds(const PositionBounds& bounds);
+
+// quantizes vertices into the packed layout. positions are rounded onto the 16 bit grid described by quantization
+void pack_vertices(std::span<PackedVertex> dst, std::span<const Vertex> src, const VertexQuantization& quantization);
+
+// adds base to every index so a primitive's indices point at its range of the mesh vertex array
+void offset_indices(std::span<uint32_t> indices, uint32_t base);
@@ -1,6 +1,7 @@
 #include "vk_types.h"
 #include <cstdint>
 #include <vk_descriptors.h>
+#include <vk_object_cache.h>
 #include <vulkan/vulkan_core.h>
 
 void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType type) {
@@ -15,7 +16,7 @@ void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType typ
 
 void DescriptorLayoutBuilder::clear() { bindings.clear(); }
 
-VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderStageFlags shader_stages) {
+VkDescriptorSetLayout DescriptorLayoutBuilder::build(ObjectCache& cache, VkShaderStageFlags shader_stages) {
 
   for (auto& binding : bindings) {
     binding.stageFlags |= shader_stages;
@@ -28,11 +29,7 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderSt
   info.bindingCount = static_cast<uint32_t>(bindings.size());
   info.flags = 0;
 
-  VkDescriptorSetLayout set{};
-
-  VK_CHECK(vkCreateDescriptorSetLayout(device, &info, nullptr, &set));
-
-  return set;
+  return cache.descriptor_set_layout(info);
 }
 
 void DescriptorAllocator::init_pool(VkDevice device, uint32_t max_sets, std::span<PoolSizeRatio> pool_ratios) {
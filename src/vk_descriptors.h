@@ -6,11 +6,14 @@
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+class ObjectCache;
+
 struct DescriptorLayoutBuilder {
   std::vector<VkDescriptorSetLayoutBinding> bindings;
   void add_binding(uint32_t binding, VkDescriptorType type);
   void clear();
-  VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shader_stages);
+  // layouts come from the cache, so building the same bindings twice hands back the same layout
+  VkDescriptorSetLayout build(ObjectCache& cache, VkShaderStageFlags shader_stages);
 };
 
 struct DescriptorAllocator {
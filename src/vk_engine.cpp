@@ -15,14 +15,17 @@
 #include "vk_loader.h"
 #include "vk_mem_alloc.h"
 #include "vk_pipelines.h"
+#include "vk_upload.h"
 #include <GLFW/glfw3.h>
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
 #include <cstring>
+#include <frustum_cull.h>
 #include <functional>
 #include <glm/gtx/transform.hpp>
 #include <iostream>
@@ -53,36 +56,42 @@ VulkanEngine* loaded_engine = nullptr;
 
 VulkanEngine& VulkanEngine::Get() { return *loaded_engine; }
 
-bool is_visible(const RenderObject& obj, const glm::mat4& viewproj) {
-  std::array<glm::vec3, 8> corners{
-      glm::vec3{1, 1, 1},  glm::vec3{1, 1, -1},  glm::vec3{1, -1, 1},  glm::vec3{1, -1, -1},
-      glm::vec3{-1, 1, 1}, glm::vec3{-1, 1, -1}, glm::vec3{-1, -1, 1}, glm::vec3{-1, -1, -1},
-  };
-
-  glm::mat4 matrix = viewproj * obj.transform;
+// screen pixels across the object's bounding sphere, which is roughly how many texels of its texture show. the
+// sphere is the one transform_sphere gives for its bounds
+static float screen_footprint(const glm::vec4& sphere, const LodSelection& lod) {
+  const float distance = glm::length(glm::vec3(sphere) - lod.camera_position);
+  if (distance <= sphere.w) {
+    return INFINITY;
+  }
+  return 2.f * sphere.w / distance * lod.projection_scale;
+}
 
-  glm::vec3 min = {1.5, 1.5, 1.5};
-  glm::vec3 max = {-1.5, -1.5, -1.5};
+// picks the coarsest level whose error stays under the threshold once projected, starting from the level
+// used last frame. sphere is the surface's bounds placed by transform_sphere
+static uint32_t select_lod(const GeoSurface& s, const glm::vec4& sphere, const LodSelection& lod, uint32_t current) {
+  if (s.lod_count == 0 || lod.error_threshold <= 0.f || s.bounds.sphere_radius <= 0.f) {
+    return 0;
+  }
 
-  for (int c = 0; c < 8; c++) {
-    // project each corner into clip space
-    glm::vec4 v = matrix * glm::vec4(obj.bounds.origin + (corners[c] * obj.bounds.extents), 1.f);
+  const float distance = glm::length(glm::vec3(sphere) - lod.camera_position);
+  if (distance <= sphere.w) {
+    return 0;
+  }
 
-    // perspective correction
-    v.x = v.x / v.w;
-    v.y = v.y / v.w;
-    v.z = v.z / v.w;
+  // the level's error as a fraction of the bounding sphere, scaled by how many pixels the sphere covers
+  const float screen_radius = sphere.w / distance * lod.projection_scale;
+  auto screen_error = [&](uint32_t level) {
+    return level == 0 ? 0.f : s.lods[level - 1].error / s.bounds.sphere_radius * screen_radius;
+  };
 
-    min = glm::min(glm::vec3{v.x, v.y, v.z}, min);
-    max = glm::max(glm::vec3{v.x, v.y, v.z}, max);
+  uint32_t level = std::min(current, s.lod_count);
+  while (level > 0 && screen_error(level) > lod.error_threshold) {
+    level--;
   }
-
-  // check the clip space box is within the view
-  if (min.z > 1.f || max.z < 0.f || min.x > 1.f || max.x < -1.f || min.y > 1.f || max.y < -1.f) {
-    return false;
-  } else {
-    return true;
+  while (level < s.lod_count && screen_error(level + 1) <= lod.error_threshold * (1.f - lod.hysteresis)) {
+    level++;
   }
+  return level;
 }
 
 bool check_validation_support() {
@@ -172,6 +181,7 @@ void VulkanEngine::init() {
   // only one engine initialization is allowed with the application.
   assert(loaded_engine == nullptr);
   loaded_engine = this;
+  _init_start = std::chrono::steady_clock::now();
 
   use_validation_layers ? fmt::println("in debug") : fmt::println("in release");
 
@@ -186,6 +196,11 @@ void VulkanEngine::init() {
   create_image_views();
   init_commands();
   init_sync_structures();
+  init_async_uploads();
+  init_geometry_pool();
+  _texture_cache.init(this);
+  _texture_streamer.init(this, VkDeviceSize(_texture_budget_mb) << 20);
+  _object_cache.init(_device);
   init_descriptors();
   init_pipelines();
   init_imgui();
@@ -193,11 +208,16 @@ void VulkanEngine::init() {
   init_default_data();
   init_camera();
 
-  std::string structure_path = "../../assets/structure.glb";
-  auto structure_file = load_gltf_meshes(this, structure_path);
-  assert(structure_file.has_value());
+  // the main thread culls a part of the scene itself, the pool has the other threads
+  const uint32_t cull_threads =
+      _cull_threads > 0 ? _cull_threads : std::clamp(std::thread::hardware_concurrency(), 1u, 8u);
+  if (cull_threads > 1) {
+    _cull_pool = std::make_unique<ThreadPool>(cull_threads - 1);
+  }
 
-  _loaded_scenes["structure"] = *structure_file;
+  // frames start right away and the scene shows up mesh by mesh as its uploads land
+  std::string structure_path = "../../assets/structure.glb";
+  _loaded_scenes["structure"] = load_gltf_async(this, structure_path);
 }
 
 void VulkanEngine::init_camera() {
@@ -254,11 +274,11 @@ void VulkanEngine::init_default_data() {
   sampl.magFilter = VK_FILTER_NEAREST;
   sampl.minFilter = VK_FILTER_NEAREST;
 
-  vkCreateSampler(_device, &sampl, nullptr, &_default_sampler_nearest);
+  _default_sampler_nearest = _object_cache.sampler(sampl);
 
   sampl.magFilter = VK_FILTER_LINEAR;
   sampl.minFilter = VK_FILTER_LINEAR;
-  vkCreateSampler(_device, &sampl, nullptr, &_default_sampler_linear);
+  _default_sampler_linear = _object_cache.sampler(sampl);
 
   GLTFMettallicRoughness::MaterialResources material_resources;
   material_resources.color_image = _white_image;
@@ -266,8 +286,10 @@ void VulkanEngine::init_default_data() {
   material_resources.metal_rough_image = _white_image;
   material_resources.metal_rough_sampler = _default_sampler_linear;
 
-  AllocatedBuffer material_constants = create_buffer(sizeof(GLTFMettallicRoughness::MaterialConstants),
-                                                     VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+  AllocatedBuffer material_constants =
+      create_buffer(sizeof(GLTFMettallicRoughness::MaterialConstants),
+                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                    VMA_MEMORY_USAGE_CPU_TO_GPU);
 
   GLTFMettallicRoughness::MaterialConstants* sceneUniformData =
       (GLTFMettallicRoughness::MaterialConstants*)material_constants.allocation->GetMappedData();
@@ -276,8 +298,8 @@ void VulkanEngine::init_default_data() {
 
   _main_deletion_queue.push_function([=, this]() { destroy_buffer(material_constants); });
 
-  material_resources.data_buffer = material_constants.buffer;
-  material_resources.data_buffer_offset = 0;
+  material_resources.data_address = buffer_address(material_constants.buffer);
+  material_resources.data_index = 0;
 
   default_data = metal_rough_material.write_material(_device, MaterialPass::MainColor, material_resources,
                                                      _global_descriptor_allocator);
@@ -300,8 +322,6 @@ void VulkanEngine::init_default_data() {
     destroy_image(_grey_image);
     destroy_image(_black_image);
     destroy_image(_error_checkerboard_image);
-    vkDestroySampler(_device, _default_sampler_nearest, nullptr);
-    vkDestroySampler(_device, _default_sampler_linear, nullptr);
   });
 }
 
@@ -333,60 +353,59 @@ AllocatedBuffer VulkanEngine::create_buffer(size_t alloc_size, VkBufferUsageFlag
   return new_buffer;
 }
 
+VkDeviceAddress VulkanEngine::buffer_address(VkBuffer buffer) {
+  VkBufferDeviceAddressInfo address_info{.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO};
+  address_info.buffer = buffer;
+  return vkGetBufferDeviceAddress(_device, &address_info);
+}
+
 void VulkanEngine::destroy_buffer(const AllocatedBuffer& buffer) {
   vmaDestroyBuffer(_allocator, buffer.buffer, buffer.allocation);
 }
 
-GPUMeshBuffers VulkanEngine::upload_mesh(std::span<uint32_t> indices, std::span<Vertex> vertices) {
-  const size_t vertex_buf_size = vertices.size() * sizeof(Vertex);
-  const size_t index_buf_size = indices.size() * sizeof(uint32_t);
-
-  GPUMeshBuffers new_surface{};
-  new_surface.vertex_buf = create_buffer(vertex_buf_size,
-                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-                                             VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-                                         VMA_MEMORY_USAGE_GPU_ONLY);
-
-  new_surface.index_buf = create_buffer(
-      index_buf_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
-
-  VkBufferDeviceAddressInfo device_address_info{};
-  device_address_info.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
-  device_address_info.buffer = new_surface.vertex_buf.buffer;
-
-  new_surface.vertex_buf_address = vkGetBufferDeviceAddress(_device, &device_address_info);
+std::optional<GeometryAllocation> VulkanEngine::upload_mesh(std::span<const uint32_t> indices,
+                                                            std::span<const Vertex> vertices) {
+  UploadBatch batch{this};
+  std::optional<GeometryAllocation> allocation = upload_mesh(batch, indices, vertices);
+  batch.flush();
 
-  AllocatedBuffer staging =
-      create_buffer(vertex_buf_size + index_buf_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_COPY);
-
-  void* data = staging.allocation->GetMappedData();
-
-  memcpy(data, vertices.data(), vertex_buf_size);
-  memcpy((char*)data + vertex_buf_size, indices.data(), index_buf_size);
-
-  immediate_submit([&](VkCommandBuffer cmd) {
-    VkBufferCopy vertex_copy{};
-    vertex_copy.dstOffset = 0;
-    vertex_copy.srcOffset = 0;
-    vertex_copy.size = vertex_buf_size;
+  return allocation;
+}
 
-    vkCmdCopyBuffer(cmd, staging.buffer, new_surface.vertex_buf.buffer, 1, &vertex_copy);
+std::optional<GeometryAllocation> VulkanEngine::upload_mesh(UploadBatch& batch, std::span<const uint32_t> indices,
+                                                            std::span<const Vertex> vertices,
+                                                            std::span<const Meshlet> meshlets) {
+  return upload_mesh(batch, indices, vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(Vertex),
+                     meshlets);
+}
 
-    VkBufferCopy index_copy{};
-    index_copy.dstOffset = 0;
-    index_copy.srcOffset = vertex_buf_size;
-    index_copy.size = index_buf_size;
+std::optional<GeometryAllocation> VulkanEngine::upload_mesh(UploadBatch& batch, std::span<const uint32_t> indices,
+                                                            std::span<const PackedVertex> vertices,
+                                                            std::span<const Meshlet> meshlets) {
+  return upload_mesh(batch, indices, vertices.data(), static_cast<uint32_t>(vertices.size()), sizeof(PackedVertex),
+                     meshlets);
+}
 
-    vkCmdCopyBuffer(cmd, staging.buffer, new_surface.index_buf.buffer, 1, &index_copy);
-  });
+std::optional<GeometryAllocation> VulkanEngine::upload_mesh(UploadBatch& batch, std::span<const uint32_t> indices,
+                                                            const void* vertex_data, uint32_t vertex_count,
+                                                            uint32_t vertex_stride, std::span<const Meshlet> meshlets) {
+  std::optional<GeometryAllocation> allocation = _geometry_pool.allocate(
+      vertex_count, vertex_stride, static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(meshlets.size()));
+  if (!allocation.has_value()) {
+    fmt::println("geometry pool can't grow, no room for a mesh with {} vertices, {} indices and {} meshlets",
+                 vertex_count, indices.size(), meshlets.size());
+    return {};
+  }
 
-  destroy_buffer(staging);
-  _main_deletion_queue.push_function([=, this]() {
-    destroy_buffer(new_surface.index_buf);
-    destroy_buffer(new_surface.vertex_buf);
-  });
+  const GeometryBlock& block = _geometry_pool.block(allocation->block);
+  batch.upload_buffer(block.vertex_buffer.buffer, VkDeviceSize(allocation->vertex_offset) * vertex_stride,
+                      vertex_data, size_t(vertex_count) * vertex_stride, _geometry_pool.concurrent_sharing());
+  batch.upload_buffer(block.index_buffer.buffer, VkDeviceSize(allocation->first_index) * sizeof(uint32_t),
+                      indices.data(), indices.size_bytes(), _geometry_pool.concurrent_sharing());
+  batch.upload_buffer(block.meshlet_buffer.buffer, VkDeviceSize(allocation->first_meshlet) * sizeof(Meshlet),
+                      meshlets.data(), meshlets.size_bytes(), _geometry_pool.concurrent_sharing());
 
-  return new_surface;
+  return allocation;
 }
 
 void VulkanEngine::create_surface() { VK_CHECK(glfwCreateWindowSurface(_instance, _window, nullptr, &_surface)); }
@@ -451,9 +470,13 @@ bool VulkanEngine::is_device_suitable(VkPhysicalDevice physical_device) {
   dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
   dynamic_rendering_features.pNext = &sync_features;
 
+  VkPhysicalDeviceVulkan12Features features_1_2{};
+  features_1_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  features_1_2.pNext = &dynamic_rendering_features;
+
   VkPhysicalDeviceFeatures2 physical_features{};
   physical_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
-  physical_features.pNext = &dynamic_rendering_features;
+  physical_features.pNext = &features_1_2;
 
   vkGetPhysicalDeviceFeatures2(physical_device, &physical_features);
   if (sync_features.synchronization2 != VK_TRUE || dynamic_rendering_features.dynamicRendering != VK_TRUE) {
@@ -465,10 +488,14 @@ bool VulkanEngine::is_device_suitable(VkPhysicalDevice physical_device) {
   }
 
   _device_features = physical_features.features;
+  // meshlet commands carry their object's instance, so they need a first instance other than 0 too
+  _meshlet_culling_supported = physical_features.features.multiDrawIndirect &&
+                               physical_features.features.drawIndirectFirstInstance && features_1_2.drawIndirectCount;
 
   if (queue_families.is_complete()) {
     _graphics_queue_family = queue_families.graphics_family.value();
     _present_queue_family = queue_families.present_family.value();
+    _transfer_queue_family = queue_families.transfer_family.value_or(_graphics_queue_family);
     return true;
   }
   return false;
@@ -521,6 +548,24 @@ QueueFamilyIndices VulkanEngine::find_queue_families(VkPhysicalDevice physical_d
     }
   }
 
+  // prefer a pure copy engine for uploads, then any family without graphics
+  for (uint32_t i{0}; i < queue_families.size(); ++i) {
+    VkQueueFlags flags = queue_families[i].queueFlags;
+    if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && !(flags & VK_QUEUE_COMPUTE_BIT)) {
+      indices.transfer_family = i;
+      break;
+    }
+  }
+  if (!indices.transfer_family.has_value()) {
+    for (uint32_t i{0}; i < queue_families.size(); ++i) {
+      VkQueueFlags flags = queue_families[i].queueFlags;
+      if ((flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT)) && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+        indices.transfer_family = i;
+        break;
+      }
+    }
+  }
+
   return indices;
 };
 
@@ -588,7 +633,8 @@ VkExtent2D VulkanEngine::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capa
 void VulkanEngine::create_logical_device() {
 
   std::vector<VkDeviceQueueCreateInfo> queue_create_infos{};
-  std::set<uint32_t> unique_queue_family_indices{_graphics_queue_family, _present_queue_family};
+  std::set<uint32_t> unique_queue_family_indices{_graphics_queue_family, _present_queue_family,
+                                                 _transfer_queue_family};
   constexpr float queue_priority{1.0f};
   for (const uint32_t& index : unique_queue_family_indices) {
     VkDeviceQueueCreateInfo queue_create_info{};
@@ -609,6 +655,10 @@ void VulkanEngine::create_logical_device() {
   features_1_2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
   features_1_2.bufferDeviceAddress = VK_TRUE;
   features_1_2.descriptorIndexing = VK_TRUE;
+  // async uploads signal a timeline semaphore
+  features_1_2.timelineSemaphore = VK_TRUE;
+  // meshlet draws are issued with one indirect count draw per surface
+  features_1_2.drawIndirectCount = _meshlet_culling_supported ? VK_TRUE : VK_FALSE;
   features_1_2.pNext = &features_1_3;
 
   VkDeviceCreateInfo device_create_info{};
@@ -632,6 +682,7 @@ void VulkanEngine::create_logical_device() {
 
   vkGetDeviceQueue(_device, _graphics_queue_family, 0, &_graphics_queue);
   vkGetDeviceQueue(_device, _present_queue_family, 0, &_present_queue);
+  vkGetDeviceQueue(_device, _transfer_queue_family, 0, &_transfer_queue);
 };
 
 void VulkanEngine::create_swapchain(uint32_t width, uint32_t height) {
@@ -864,6 +915,18 @@ void VulkanEngine::init_sync_structures() {
   VK_CHECK(vkCreateFence(_device, &fence_create_info, nullptr, &_imm_fence));
 };
 
+void VulkanEngine::init_async_uploads() {
+  _async_uploader.init(this);
+
+  _main_deletion_queue.push_function([&]() { _async_uploader.cleanup(); });
+}
+
+void VulkanEngine::init_geometry_pool() {
+  _geometry_pool.init(this, _geometry_block_vertex_bytes, _geometry_block_index_bytes, _geometry_block_meshlet_bytes);
+
+  _main_deletion_queue.push_function([&]() { _geometry_pool.cleanup(); });
+}
+
 void VulkanEngine::destroy_sync_structures() {
   for (FrameData& frame_data : _frames) {
 
@@ -883,13 +946,13 @@ void VulkanEngine::init_descriptors() {
   {
     DescriptorLayoutBuilder builder;
     builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-    _draw_image_descriptor_layout = builder.build(_device, VK_SHADER_STAGE_COMPUTE_BIT);
+    _draw_image_descriptor_layout = builder.build(_object_cache, VK_SHADER_STAGE_COMPUTE_BIT);
   }
 
   {
     DescriptorLayoutBuilder builder;
     builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    _single_image_desc_layout = builder.build(_device, VK_SHADER_STAGE_FRAGMENT_BIT);
+    _single_image_desc_layout = builder.build(_object_cache, VK_SHADER_STAGE_FRAGMENT_BIT);
   }
 
   // allocate a set from the pool just created
@@ -918,7 +981,7 @@ void VulkanEngine::init_descriptors() {
   DescriptorLayoutBuilder scene_desc_layout_builder;
   scene_desc_layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
   _gpu_scene_descriptor_layout =
-      scene_desc_layout_builder.build(_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+      scene_desc_layout_builder.build(_object_cache, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
 
   _main_deletion_queue.push_function([&]() { _global_descriptor_allocator.destroy_pools(_device); });
 }
@@ -926,6 +989,7 @@ void VulkanEngine::init_descriptors() {
 void VulkanEngine::init_pipelines() {
 
   init_background_pipelines();
+  init_meshlet_cull_pipeline();
   init_mesh_pipeline();
   metal_rough_material.build_pipelines(this);
 }
@@ -962,7 +1026,7 @@ void VulkanEngine::init_background_pipelines() {
   compute_layout.pPushConstantRanges = &push_constant_range;
   compute_layout.pushConstantRangeCount = 1;
 
-  VK_CHECK(vkCreatePipelineLayout(_device, &compute_layout, nullptr, &_gradient_pipeline_layout));
+  _gradient_pipeline_layout = _object_cache.pipeline_layout(compute_layout);
 
   VkComputePipelineCreateInfo compute_pipeline_create_info{};
   compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
@@ -997,12 +1061,47 @@ void VulkanEngine::init_background_pipelines() {
   vkDestroyShaderModule(_device, sky_shader, nullptr);
 
   _main_deletion_queue.push_function([=, this]() {
-    vkDestroyPipelineLayout(_device, _gradient_pipeline_layout, nullptr);
     vkDestroyPipeline(_device, gradient.pipeline, nullptr);
     vkDestroyPipeline(_device, sky.pipeline, nullptr);
   });
 }
 
+void VulkanEngine::init_meshlet_cull_pipeline() {
+  VkShaderModule cull_shader{};
+  if (!vkutil::load_shader_module("../../shaders/meshlet_cull.comp.spv", _device, &cull_shader)) {
+    fmt::println("Error building compute shader");
+  }
+
+  // every buffer the pass touches is reached through a device address, so there are no descriptor sets
+  VkPushConstantRange push_constant_range{};
+  push_constant_range.size = sizeof(GPUMeshletCullPushConstants);
+  push_constant_range.offset = 0;
+  push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkPipelineLayoutCreateInfo layout_info = vkinit::pipeline_layout_create_info();
+  layout_info.pPushConstantRanges = &push_constant_range;
+  layout_info.pushConstantRangeCount = 1;
+
+  _meshlet_cull_pipeline_layout = _object_cache.pipeline_layout(layout_info);
+
+  VkComputePipelineCreateInfo compute_pipeline_create_info{};
+  compute_pipeline_create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  compute_pipeline_create_info.layout = _meshlet_cull_pipeline_layout;
+  compute_pipeline_create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  compute_pipeline_create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  compute_pipeline_create_info.stage.module = cull_shader;
+  compute_pipeline_create_info.stage.pName = "main";
+
+  VK_CHECK(vkCreateComputePipelines(_device, nullptr, 1, &compute_pipeline_create_info, nullptr,
+                                    &_meshlet_cull_pipeline));
+
+  vkDestroyShaderModule(_device, cull_shader, nullptr);
+
+  _main_deletion_queue.push_function([=, this]() {
+    vkDestroyPipeline(_device, _meshlet_cull_pipeline, nullptr);
+  });
+}
+
 void VulkanEngine::init_mesh_pipeline() {
   VkShaderModule triangle_vert_shader{};
   if (!vkutil::load_shader_module("../../shaders/colored_triangle_mesh.vert.spv", _device, &triangle_vert_shader)) {
@@ -1024,7 +1123,7 @@ void VulkanEngine::init_mesh_pipeline() {
   pipeline_layout_ci.pSetLayouts = &_single_image_desc_layout;
   pipeline_layout_ci.setLayoutCount = 1;
 
-  VK_CHECK(vkCreatePipelineLayout(_device, &pipeline_layout_ci, nullptr, &_mesh_pipeline_layout));
+  _mesh_pipeline_layout = _object_cache.pipeline_layout(pipeline_layout_ci);
 
   PipelineBuilder pipeline_builder;
   pipeline_builder._pipeline_layout = _mesh_pipeline_layout;
@@ -1045,7 +1144,6 @@ void VulkanEngine::init_mesh_pipeline() {
   vkDestroyShaderModule(_device, triangle_frag_shader, nullptr);
 
   _main_deletion_queue.push_function([&]() {
-    vkDestroyPipelineLayout(_device, _mesh_pipeline_layout, nullptr);
     vkDestroyPipeline(_device, _mesh_pipeline, nullptr);
   });
 }
@@ -1124,17 +1222,38 @@ void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& f
 
   VkCommandBufferSubmitInfo cmd_info = vkinit::command_buffer_submit_info(_imm_cmd_buffer);
   VkSubmitInfo2 submit_info = vkinit::submit_info(&cmd_info, nullptr, nullptr);
-  VK_CHECK(vkQueueSubmit2(_graphics_queue, 1, &submit_info, _imm_fence));
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    VK_CHECK(vkQueueSubmit2(_graphics_queue, 1, &submit_info, _imm_fence));
+  }
   VK_CHECK(vkWaitForFences(_device, 1, &_imm_fence, VK_TRUE, 9999999999));
 };
 
 void VulkanEngine::cleanup() {
+  // loader threads and streaming workers use the uploader and the pools the main deletion queue destroys
+  for (auto& [name, scene] : _loaded_scenes) {
+    scene->cancel_load();
+  }
+  _texture_streamer.drain();
+  // nothing submits anymore, but the last uploads can still be running on the transfer queue
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    vkDeviceWaitIdle(_device);
+  }
+  // scenes give their pool ranges and textures back through the frame deletion queues, which have to run while the
+  // geometry pool is still around
+  _loaded_scenes.clear();
+  for (FrameData& frame_data : _frames) {
+    frame_data.deletion_queue.flush();
+  }
   _main_deletion_queue.flush();
+  _cull_pool.reset();
   metal_rough_material._deletion_queue.flush();
-  _loaded_scenes.clear();
-  vkDestroyDescriptorSetLayout(_device, _gpu_scene_descriptor_layout, nullptr);
-  vkDestroyDescriptorSetLayout(_device, _draw_image_descriptor_layout, nullptr);
-  vkDestroyDescriptorSetLayout(_device, _single_image_desc_layout, nullptr);
+  // anything still cached has no user left
+  _texture_cache.cleanup();
+  _texture_streamer.cleanup();
+  // samplers and layouts are shared, so they go once nothing that was created with them is left
+  _object_cache.cleanup();
   vkDestroyDescriptorPool(_device, _imm_descriptor_pool, nullptr);
 
   destroy_swapchain();
@@ -1142,6 +1261,13 @@ void VulkanEngine::cleanup() {
   for (FrameData& frame_data : _frames) {
     vkDestroyCommandPool(_device, frame_data.command_pool, nullptr);
     frame_data.deletion_queue.flush();
+    if (frame_data.meshlet_jobs.buffer != VK_NULL_HANDLE) {
+      destroy_buffer(frame_data.meshlet_jobs);
+      destroy_buffer(frame_data.meshlet_draws);
+    }
+    if (frame_data.instances.buffer != VK_NULL_HANDLE) {
+      destroy_buffer(frame_data.instances);
+    }
   }
   vmaDestroyAllocator(_allocator);
 
@@ -1185,9 +1311,28 @@ void VulkanEngine::run() {
       //  ImGui::InputFloat4("data4", (float*)&effect.data.data4);
       ImGui::Text("frametime %f ms", stats.frame_time);
       ImGui::Text("draw time %f ms", stats.mesh_draw_time);
-      ImGui::Text("update time %f ms", stats.scene_update_time);
+      ImGui::Text("update time %f ms, %i render list changes", stats.scene_update_time, stats.render_list_changes);
+      ImGui::Text("cull %.3f ms, %zu threads, %.0f%% balanced", stats.cull_time, stats.cull_thread_ms.size(),
+                  stats.cull_balance * 100.f);
+      for (size_t i = 0; i < stats.cull_thread_ms.size(); i++) {
+        ImGui::Text("  thread %zu: %.3f ms", i, stats.cull_thread_ms[i]);
+      }
       ImGui::Text("triangles %i", stats.triangle_count);
-      ImGui::Text("draws %i", stats.drawcall_count);
+      ImGui::Text("draws %i, %i objects, %i material binds", stats.drawcall_count, stats.instance_count,
+                  stats.material_binds);
+      ImGui::Checkbox("instancing", &_instancing);
+      ImGui::Checkbox("bvh culling", &_bvh_culling);
+      ImGui::Text("first frame %.1f ms, with geometry %.1f ms", stats.first_frame_ms, stats.first_geometry_frame_ms);
+      ImGui::Text("meshlets tested %i", stats.meshlet_count);
+      ImGui::SliderFloat("lod error (px)", &_lod_error_threshold, 0.f, 8.f);
+      if (_meshlet_culling_supported) {
+        ImGui::Checkbox("meshlet culling", &_meshlet_culling);
+      }
+      ImGui::Text("streamed textures %u, %.1f MB resident, %u uploading", _texture_streamer.texture_count(),
+                  _texture_streamer.resident_bytes() / (1024.f * 1024.f), _texture_streamer.pending_count());
+      if (ImGui::SliderInt("texture budget (MB)", &_texture_budget_mb, 32, 2048)) {
+        _texture_streamer.set_budget(VkDeviceSize(_texture_budget_mb) << 20);
+      }
     }
 
     ImGui::End();
@@ -1199,6 +1344,7 @@ void VulkanEngine::run() {
     auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
     stats.frame_time = elapsed.count() / 1000.f;
   }
+  std::lock_guard<std::mutex> lock(_queue_mutex);
   vkDeviceWaitIdle(_device);
 }
 
@@ -1227,6 +1373,8 @@ void VulkanEngine::draw() {
 
   get_current_frame().deletion_queue.flush();
   get_current_frame().descriptor_allocator.clear_pools(_device);
+  // swaps and evictions retire images into the deletion queue that was just flushed
+  _texture_streamer.update(_frame_number);
 
   uint32_t image_index{};
   VkResult result = vkAcquireNextImageKHR(_device, _swap_chain, 10000000000, get_current_frame()._swapchain_semaphore,
@@ -1254,6 +1402,10 @@ void VulkanEngine::draw() {
   VK_CHECK(vkBeginCommandBuffer(cmd, &command_begin_info));
 
   // transition drawing image to a writeable mode
+  // take ownership of whatever the transfer queue finished since the last frame. batches that are still in
+  // flight are skipped by the scene, so the frame only ever waits on uploads that are already complete
+  uint64_t upload_wait_value = _async_uploader.record_acquires(cmd);
+
   vkutil::transition_image(cmd, _draw_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
   draw_background(cmd);
@@ -1295,6 +1447,15 @@ void VulkanEngine::draw() {
   wait_semaphore_info.deviceIndex = 0;
   wait_semaphore_info.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
 
+  std::array<VkSemaphoreSubmitInfo, 2> wait_infos{wait_semaphore_info};
+  uint32_t wait_count = 1;
+  if (upload_wait_value != 0) {
+    VkSemaphoreSubmitInfo upload_wait_info =
+        vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _async_uploader.timeline());
+    upload_wait_info.value = upload_wait_value;
+    wait_infos[wait_count++] = upload_wait_info;
+  }
+
   VkSemaphoreSubmitInfo signal_semaphore_info{};
   signal_semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
   signal_semaphore_info.semaphore = get_current_frame()._render_semaphore;
@@ -1313,12 +1474,15 @@ void VulkanEngine::draw() {
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
   submit_info.commandBufferInfoCount = 1;
   submit_info.pCommandBufferInfos = &cmd_submit_info;
-  submit_info.waitSemaphoreInfoCount = 1;
-  submit_info.pWaitSemaphoreInfos = &wait_semaphore_info;
+  submit_info.waitSemaphoreInfoCount = wait_count;
+  submit_info.pWaitSemaphoreInfos = wait_infos.data();
   submit_info.signalSemaphoreInfoCount = 1;
   submit_info.pSignalSemaphoreInfos = &signal_semaphore_info;
 
-  VK_CHECK(vkQueueSubmit2(_graphics_queue, 1, &submit_info, get_current_frame()._render_fence));
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    VK_CHECK(vkQueueSubmit2(_graphics_queue, 1, &submit_info, get_current_frame()._render_fence));
+  }
 
   VkPresentInfoKHR present_info{};
   present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -1329,7 +1493,11 @@ void VulkanEngine::draw() {
   present_info.pWaitSemaphores = &get_current_frame()._render_semaphore;
   present_info.pNext = nullptr;
 
-  result = vkQueuePresentKHR(_graphics_queue, &present_info);
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    result = vkQueuePresentKHR(_graphics_queue, &present_info);
+  }
+  log_first_frames();
   if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
     _resize_requested = true;
     return;
@@ -1338,6 +1506,21 @@ void VulkanEngine::draw() {
   ++_frame_number;
 }
 
+void VulkanEngine::log_first_frames() {
+  if (stats.first_geometry_frame_ms > 0.f) {
+    return;
+  }
+  const std::chrono::duration<float, std::milli> elapsed = std::chrono::steady_clock::now() - _init_start;
+  if (stats.first_frame_ms == 0.f) {
+    stats.first_frame_ms = elapsed.count();
+    fmt::println("first frame after {:.1f} ms", stats.first_frame_ms);
+  }
+  if (stats.drawcall_count > 0) {
+    stats.first_geometry_frame_ms = elapsed.count();
+    fmt::println("first frame with scene geometry after {:.1f} ms", stats.first_geometry_frame_ms);
+  }
+}
+
 void VulkanEngine::draw_background(VkCommandBuffer cmd) {
 
   const ComputeEffect& effect = _background_effects[_current_background_effect];
@@ -1354,31 +1537,345 @@ void VulkanEngine::draw_background(VkCommandBuffer cmd) {
   vkCmdDispatch(cmd, std::ceil(_draw_extent.width / 16.0), std::ceil(_draw_extent.height / 16.0), 1);
 };
 
+// normal cones can only be moved to world space by transforms that keep angles and winding, meaning a rotation
+// with a uniform positive scale
+static bool preserves_cones(const glm::mat4& transform) {
+  const glm::mat3 m{transform};
+  const float scale_x = glm::length(m[0]);
+  const float scale_y = glm::length(m[1]);
+  const float scale_z = glm::length(m[2]);
+  const float tolerance = 1e-3f * std::max(scale_x, std::max(scale_y, scale_z));
+  const bool uniform = std::abs(scale_x - scale_y) <= tolerance && std::abs(scale_x - scale_z) <= tolerance;
+  const bool orthogonal = std::abs(glm::dot(m[0], m[1])) <= tolerance * scale_x &&
+                          std::abs(glm::dot(m[0], m[2])) <= tolerance * scale_x &&
+                          std::abs(glm::dot(m[1], m[2])) <= tolerance * scale_y;
+  return uniform && orthogonal && glm::determinant(m) > 0.f;
+}
+
+// the frame's job buffer holds the view, then a meshlet buffer address per geometry pool block, then the jobs
+constexpr size_t MESHLET_CULL_JOBS_OFFSET = sizeof(GPUMeshletCullView) + MAX_GEOMETRY_BLOCKS * sizeof(VkDeviceAddress);
+static_assert(MESHLET_CULL_JOBS_OFFSET % 16 == 0, "jobs hold a mat4 and have to stay 16 byte aligned");
+
+void VulkanEngine::cull_meshlets(VkCommandBuffer cmd, std::span<const uint32_t> opaque_indices,
+                                 std::vector<MeshletDraw>& draws) {
+  draws.assign(opaque_indices.size(), MeshletDraw{});
+  stats.meshlet_count = 0;
+  if (!_meshlet_culling || !_meshlet_culling_supported) {
+    return;
+  }
+
+  const std::span<const RenderObject> opaque = _render_list.opaque();
+  uint32_t job_count = 0;
+  uint32_t command_count = 0;
+  for (uint32_t index : opaque_indices) {
+    const RenderObject& obj = opaque[index];
+    if (obj.meshlet_count > 0) {
+      job_count++;
+      command_count += obj.meshlet_count;
+    }
+  }
+  if (job_count == 0) {
+    return;
+  }
+
+  // the frame's fence has been waited on, so nothing reads its old buffers anymore
+  FrameData& frame = get_current_frame();
+  if (job_count > frame.meshlet_job_capacity || command_count > frame.meshlet_command_capacity) {
+    if (frame.meshlet_jobs.buffer != VK_NULL_HANDLE) {
+      destroy_buffer(frame.meshlet_jobs);
+      destroy_buffer(frame.meshlet_draws);
+    }
+    // some headroom so a slowly growing scene doesn't reallocate every frame
+    frame.meshlet_job_capacity = std::max(job_count, frame.meshlet_job_capacity) * 3 / 2;
+    frame.meshlet_command_capacity = std::max(command_count, frame.meshlet_command_capacity) * 3 / 2;
+
+    frame.meshlet_jobs = create_buffer(
+        MESHLET_CULL_JOBS_OFFSET + size_t(frame.meshlet_job_capacity) * sizeof(GPUMeshletCullJob),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    frame.meshlet_draws = create_buffer(
+        size_t(frame.meshlet_job_capacity) * sizeof(uint32_t) +
+            size_t(frame.meshlet_command_capacity) * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+  }
+
+  // draw counts come first, then the commands
+  const VkDeviceSize commands_offset = VkDeviceSize(frame.meshlet_job_capacity) * sizeof(uint32_t);
+
+  auto* view = (GPUMeshletCullView*)frame.meshlet_jobs.info.pMappedData;
+  // near and far are left to the per surface test
+  const Frustum frustum = extract_frustum(_scene_data.viewproj);
+  std::copy(frustum.planes.begin(), frustum.planes.begin() + 4, view->frustum_planes);
+  view->camera_position = glm::vec4(_main_camera.position, 1.f);
+
+  // the meshlet buffer of every pool block, jobs pick theirs
+  auto* meshlet_blocks = (VkDeviceAddress*)(view + 1);
+  for (uint32_t block = 0; block < _geometry_pool.block_count(); block++) {
+    meshlet_blocks[block] = _geometry_pool.block(block).meshlet_address;
+  }
+
+  auto* jobs = (GPUMeshletCullJob*)((char*)frame.meshlet_jobs.info.pMappedData + MESHLET_CULL_JOBS_OFFSET);
+  uint32_t job = 0;
+  uint32_t first_command = 0;
+  for (size_t i = 0; i < opaque_indices.size(); i++) {
+    const RenderObject& obj = opaque[opaque_indices[i]];
+    if (obj.meshlet_count == 0) {
+      continue;
+    }
+
+    GPUMeshletCullJob cull_job{};
+    cull_job.transform = obj.transform;
+    cull_job.meshlet_block = obj.geometry_block;
+    cull_job.first_meshlet = obj.first_meshlet;
+    cull_job.meshlet_count = obj.meshlet_count;
+    cull_job.first_command = first_command;
+    cull_job.first_index = obj.first_index;
+    cull_job.vertex_offset = static_cast<int32_t>(obj.vertex_offset);
+    // glTF only allows dropping back faces of single sided materials
+    cull_job.flags = !obj.double_sided && preserves_cones(obj.transform) ? MESHLET_CULL_CONE : 0;
+    // draw_geometry writes the opaque transforms first, in the order of opaque_indices
+    cull_job.instance = static_cast<uint32_t>(i);
+    jobs[job] = cull_job;
+
+    draws[i].count_offset = VkDeviceSize(job) * sizeof(uint32_t);
+    draws[i].command_offset = commands_offset + VkDeviceSize(first_command) * sizeof(VkDrawIndexedIndirectCommand);
+    draws[i].max_draw_count = obj.meshlet_count;
+
+    job++;
+    first_command += obj.meshlet_count;
+  }
+  stats.meshlet_count = static_cast<int>(command_count);
+
+  const VkDeviceAddress jobs_address = buffer_address(frame.meshlet_jobs.buffer);
+  const VkDeviceAddress draws_address = buffer_address(frame.meshlet_draws.buffer);
+
+  // every job's count starts at zero and is bumped once per surviving meshlet
+  vkCmdFillBuffer(cmd, frame.meshlet_draws.buffer, 0, VkDeviceSize(job_count) * sizeof(uint32_t), 0);
+
+  VkMemoryBarrier2 clear_barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2, .pNext = nullptr};
+  clear_barrier.srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT;
+  clear_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+  clear_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  clear_barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+
+  VkDependencyInfo dep_info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .pNext = nullptr};
+  dep_info.memoryBarrierCount = 1;
+  dep_info.pMemoryBarriers = &clear_barrier;
+  vkCmdPipelineBarrier2(cmd, &dep_info);
+
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _meshlet_cull_pipeline);
+
+  GPUMeshletCullPushConstants push_constants{};
+  push_constants.view = jobs_address;
+  push_constants.meshlet_blocks = jobs_address + sizeof(GPUMeshletCullView);
+  push_constants.jobs = jobs_address + MESHLET_CULL_JOBS_OFFSET;
+  push_constants.draw_counts = draws_address;
+  push_constants.draw_commands = draws_address + commands_offset;
+  push_constants.job_count = job_count;
+
+  // one workgroup per job
+  const uint32_t max_workgroups = 65535;
+  for (uint32_t first_job = 0; first_job < job_count; first_job += max_workgroups) {
+    push_constants.first_job = first_job;
+    vkCmdPushConstants(cmd, _meshlet_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(GPUMeshletCullPushConstants), &push_constants);
+    vkCmdDispatch(cmd, std::min(max_workgroups, job_count - first_job), 1, 1);
+  }
+
+  VkMemoryBarrier2 draw_barrier{.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2, .pNext = nullptr};
+  draw_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+  draw_barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+  draw_barrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+  draw_barrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+  dep_info.pMemoryBarriers = &draw_barrier;
+  vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
+// true when b can be drawn as another instance of a's draw
+static bool same_draw(const RenderObject& a, const RenderObject& b) {
+  return a.material == b.material && a.geometry_block == b.geometry_block && a.first_index == b.first_index &&
+         a.index_count == b.index_count && a.vertex_offset == b.vertex_offset;
+}
+
+void VulkanEngine::write_instances(std::span<const uint32_t> opaque_indices) {
+  const size_t instance_count = opaque_indices.size() + _render_list.transparent().size();
+  if (instance_count == 0) {
+    return;
+  }
+
+  // the frame's fence has been waited on, so nothing reads its old buffer anymore
+  FrameData& frame = get_current_frame();
+  if (instance_count > frame.instance_capacity) {
+    if (frame.instances.buffer != VK_NULL_HANDLE) {
+      destroy_buffer(frame.instances);
+    }
+    frame.instance_capacity = static_cast<uint32_t>(instance_count) * 3 / 2;
+    frame.instances = create_buffer(size_t(frame.instance_capacity) * sizeof(glm::mat4),
+                                    VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                    VMA_MEMORY_USAGE_CPU_TO_GPU);
+    frame.instance_address = buffer_address(frame.instances.buffer);
+  }
+
+  // opaque objects in draw order, then the transparent ones
+  auto* transforms = (glm::mat4*)frame.instances.info.pMappedData;
+  for (uint32_t index : opaque_indices) {
+    *transforms++ = _render_list.opaque()[index].transform;
+  }
+  for (const RenderObject& obj : _render_list.transparent()) {
+    *transforms++ = obj.transform;
+  }
+}
+
+// a culling part gets at least this many objects, fewer aren't worth handing to another thread
+constexpr size_t MIN_CULL_PART_OBJECTS = 4096;
+
+// draw order of the visible opaque objects. materials sharing textures end up next to each other so their set is
+// bound once, and copies of the same surface level too, so they can be instanced. ties go by index, so the order
+// doesn't depend on how the culling was split
+static bool draw_order(const RenderObject& a, uint32_t a_index, const RenderObject& b, uint32_t b_index) {
+  if (a.material->pipeline != b.material->pipeline) {
+    return a.material->pipeline < b.material->pipeline;
+  }
+  if (a.material->material_desc_set != b.material->material_desc_set) {
+    return a.material->material_desc_set < b.material->material_desc_set;
+  }
+  if (a.material != b.material) {
+    return a.material < b.material;
+  }
+  if (a.geometry_block != b.geometry_block) {
+    return a.geometry_block < b.geometry_block;
+  }
+  if (a.first_index != b.first_index) {
+    return a.first_index < b.first_index;
+  }
+  if (a.index_count != b.index_count) {
+    return a.index_count < b.index_count;
+  }
+  return a_index < b_index;
+}
+
+void VulkanEngine::build_draw_list(std::vector<uint32_t>& opaque_indices) {
+  auto start = std::chrono::steady_clock::now();
+
+  const std::span<RenderObject> opaque = _render_list.opaque();
+  const CullSpheres& spheres = _render_list.opaque_spheres();
+  const CullBvh& bvh = _render_list.opaque_bvh();
+  const Frustum frustum = extract_frustum(_scene_data.viewproj);
+  auto in_draw_order = [&](uint32_t a, uint32_t b) { return draw_order(opaque[a], a, opaque[b], b); };
+
+  // objects in the hierarchy are culled a subtree at a time, the ones added since it was built one by one
+  const size_t tree_items = _bvh_culling ? bvh.item_count() : 0;
+  const size_t linear_items = opaque.size() - tree_items;
+
+  // the main thread takes the first part itself. every part gets a share of the subtrees and a range of the linear
+  // objects, starting on a multiple of 8 so only the last one has a partial avx2 group
+  const size_t max_parts = _cull_pool ? _cull_pool->thread_count() + 1 : 1;
+  const size_t parts = std::clamp(opaque.size() / MIN_CULL_PART_OBJECTS, size_t(1), max_parts);
+  const size_t part_size = ((linear_items + parts - 1) / parts + 7) / 8 * 8;
+  _cull_parts.resize(std::max(_cull_parts.size(), parts));
+  stats.cull_thread_ms.assign(parts, 0.f);
+  // a few subtrees per part, so parts whose subtrees are mostly off screen don't leave their thread idle
+  if (tree_items > 0) {
+    bvh.split(parts * 4, _cull_roots);
+  } else {
+    _cull_roots.clear();
+  }
+
+  // every part culls its share, picks the lod of what it kept and sorts it. parts only write their own objects,
+  // output and stat
+  auto run_part = [&](size_t part) {
+    auto part_start = std::chrono::steady_clock::now();
+    std::vector<uint32_t>& visible = _cull_parts[part];
+    visible.clear();
+    for (size_t root = part; root < _cull_roots.size(); root += parts) {
+      bvh.cull(frustum, spheres, _cull_roots[root], visible);
+    }
+    cull_spheres(frustum, spheres, visible, tree_items + part * part_size, tree_items + (part + 1) * part_size);
+    for (uint32_t i : visible) {
+      RenderObject& obj = opaque[i];
+      set_lod(obj, select_lod(*obj.surface, spheres.get(i), _main_draw_context.lod, obj.lod));
+    }
+    std::sort(visible.begin(), visible.end(), in_draw_order);
+    auto part_end = std::chrono::steady_clock::now();
+    stats.cull_thread_ms[part] = std::chrono::duration<float, std::milli>(part_end - part_start).count();
+  };
+
+  std::vector<std::future<void>> jobs;
+  jobs.reserve(parts - 1);
+  for (size_t part = 1; part < parts; part++) {
+    jobs.push_back(_cull_pool->submit([&run_part, part]() { run_part(part); }));
+  }
+  run_part(0);
+  for (std::future<void>& job : jobs) {
+    job.get();
+  }
+
+  // the sorted parts are appended in part order and merged pairwise. the order is total, so the result is the same
+  // for any number of parts
+  opaque_indices.clear();
+  std::vector<size_t> run_starts;
+  run_starts.reserve(parts + 1);
+  for (size_t part = 0; part < parts; part++) {
+    run_starts.push_back(opaque_indices.size());
+    opaque_indices.insert(opaque_indices.end(), _cull_parts[part].begin(), _cull_parts[part].end());
+  }
+  run_starts.push_back(opaque_indices.size());
+  for (size_t width = 1; width < parts; width *= 2) {
+    for (size_t run = 0; run + width < parts; run += 2 * width) {
+      std::inplace_merge(opaque_indices.begin() + run_starts[run], opaque_indices.begin() + run_starts[run + width],
+                         opaque_indices.begin() + run_starts[std::min(run + 2 * width, parts)], in_draw_order);
+    }
+  }
+
+  // 1 when every part took as long as the slowest one
+  const float slowest = *std::max_element(stats.cull_thread_ms.begin(), stats.cull_thread_ms.end());
+  float total = 0.f;
+  for (float ms : stats.cull_thread_ms) {
+    total += ms;
+  }
+  stats.cull_balance = slowest > 0.f ? total / (slowest * parts) : 1.f;
+  auto end = std::chrono::steady_clock::now();
+  stats.cull_time = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
 void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
   stats.drawcall_count = 0;
+  stats.instance_count = 0;
+  stats.material_binds = 0;
   stats.triangle_count = 0;
 
+  // the objects persist across frames, only their lod follows the view. it is picked for the ones drawn
+  const std::span<RenderObject> opaque = _render_list.opaque();
+  const std::span<RenderObject> transparent = _render_list.transparent();
   std::vector<uint32_t> opaque_indices;
-  opaque_indices.reserve(_main_draw_context.opaque_surfaces.size());
-  for (int i = 0; i < _main_draw_context.opaque_surfaces.size(); i++) {
-    if (is_visible(_main_draw_context.opaque_surfaces[i], _scene_data.viewproj)) {
-      opaque_indices.push_back(i);
-    }
-  }
+  build_draw_list(opaque_indices);
 
-  std::sort(opaque_indices.begin(), opaque_indices.end(), [&](const auto& iA, const auto& iB) {
-    const RenderObject& a = _main_draw_context.opaque_surfaces[iA];
-    const RenderObject& b = _main_draw_context.opaque_surfaces[iB];
-
-    if (a.material == b.material) {
-      return a.index_buffer < b.index_buffer;
-    } else {
-      return a.material < b.material;
+  // streamed textures get the detail of the largest surface drawn with them, next frame
+  std::vector<std::pair<uint32_t, float>> footprints;
+  auto add_footprint = [&](const RenderObject& obj, const glm::vec4& sphere) {
+    if (obj.material->streamed_texture != NO_STREAMED_TEXTURE) {
+      footprints.emplace_back(obj.material->streamed_texture, screen_footprint(sphere, _main_draw_context.lod));
     }
-  });
+  };
+  // the render list keeps the opaque objects' spheres for culling, the transparent ones are placed here
+  const CullSpheres& opaque_spheres = _render_list.opaque_spheres();
+  for (uint32_t i : opaque_indices) {
+    add_footprint(opaque[i], opaque_spheres.get(i));
+  }
+  for (RenderObject& obj : transparent) {
+    const glm::vec4 sphere = transform_sphere(obj.bounds.origin, obj.bounds.sphere_radius, obj.transform);
+    set_lod(obj, select_lod(*obj.surface, sphere, _main_draw_context.lod, obj.lod));
+    add_footprint(obj, sphere);
+  }
+  _texture_streamer.request(footprints);
 
   auto start = std::chrono::system_clock::now();
 
+  std::vector<MeshletDraw> meshlet_draws;
+  cull_meshlets(cmd, opaque_indices, meshlet_draws);
+  write_instances(opaque_indices);
+
   VkRenderingAttachmentInfo color_attachment_info =
       vkinit::attachment_info(_draw_image.image_view, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 
@@ -1407,68 +1904,101 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
   writer.update_set(_device, scene_data_descriptors);
 
   MaterialPipeline* last_pipeline = nullptr;
-  MaterialInstance* last_material = nullptr;
-  VkBuffer last_index_buffer = VK_NULL_HANDLE;
-  auto draw = [&](const RenderObject& render_obj) {
-    if (render_obj.material != last_material) {
-      last_material = render_obj.material;
-      if (render_obj.material->pipeline != last_pipeline) {
-        last_pipeline = render_obj.material->pipeline;
-        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_obj.material->pipeline->pipeline);
-        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_obj.material->pipeline->layout, 0, 1,
-                                &scene_data_descriptors, 0, nullptr);
-
-        VkViewport viewport = {};
-        viewport.x = 0;
-        viewport.y = 0;
-        viewport.width = _draw_extent.width;
-        viewport.height = _draw_extent.height;
-        viewport.minDepth = 0.f;
-        viewport.maxDepth = 1.f;
-
-        vkCmdSetViewport(cmd, 0, 1, &viewport);
-
-        VkRect2D scissor = {};
-        scissor.offset.x = 0;
-        scissor.offset.y = 0;
-        scissor.extent.width = viewport.width;
-        scissor.extent.height = viewport.height;
-
-        vkCmdSetScissor(cmd, 0, 1, &scissor);
-      }
+  VkDescriptorSet last_texture_set = VK_NULL_HANDLE;
+  uint32_t last_block = MAX_GEOMETRY_BLOCKS;
+  const VkBuffer meshlet_draw_buffer = get_current_frame().meshlet_draws.buffer;
+  const VkDeviceAddress instance_address = get_current_frame().instance_address;
+  auto draw = [&](const RenderObject& render_obj, const MeshletDraw& meshlet_draw, uint32_t first_instance,
+                  uint32_t instance_count) {
+    if (render_obj.material->pipeline != last_pipeline) {
+      last_pipeline = render_obj.material->pipeline;
+      vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_obj.material->pipeline->pipeline);
+      vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_obj.material->pipeline->layout, 0, 1,
+                              &scene_data_descriptors, 0, nullptr);
+
+      VkViewport viewport = {};
+      viewport.x = 0;
+      viewport.y = 0;
+      viewport.width = _draw_extent.width;
+      viewport.height = _draw_extent.height;
+      viewport.minDepth = 0.f;
+      viewport.maxDepth = 1.f;
+
+      vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+      VkRect2D scissor = {};
+      scissor.offset.x = 0;
+      scissor.offset.y = 0;
+      scissor.extent.width = viewport.width;
+      scissor.extent.height = viewport.height;
+
+      vkCmdSetScissor(cmd, 0, 1, &scissor);
+    }
+    // the constants come from the material table, so only a different set of textures needs a bind
+    if (render_obj.material->material_desc_set != last_texture_set) {
+      last_texture_set = render_obj.material->material_desc_set;
       vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, render_obj.material->pipeline->layout, 1, 1,
                               &render_obj.material->material_desc_set, 0, nullptr);
+      stats.material_binds++;
     }
 
-    if (render_obj.index_buffer != last_index_buffer) {
-      last_index_buffer = render_obj.index_buffer;
-      vkCmdBindIndexBuffer(cmd, render_obj.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+    // every mesh lives in a geometry pool block, the index buffer only changes with it
+    const GeometryBlock& block = _geometry_pool.block(render_obj.geometry_block);
+    if (render_obj.geometry_block != last_block) {
+      last_block = render_obj.geometry_block;
+      vkCmdBindIndexBuffer(cmd, block.index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
     }
 
     GPUDrawPushConstants push_constants;
-    push_constants.vertex_buf_address = render_obj.vertex_buf_addr;
-    push_constants.world_mat = render_obj.transform;
+    push_constants.vertex_buf_address = block.vertex_address;
+    push_constants.instance_buf_address = instance_address;
+    push_constants.material_buf_address = render_obj.material->data_address;
+    push_constants.material_index = render_obj.material->data_index;
+    push_constants.position_offset = glm::vec4(render_obj.quantization.offset, 0.f);
+    push_constants.position_scale = glm::vec4(render_obj.quantization.scale / 65535.f, 0.f);
     vkCmdPushConstants(cmd, render_obj.material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
                        sizeof(GPUDrawPushConstants), &push_constants);
-    vkCmdDrawIndexed(cmd, render_obj.index_count, 1, render_obj.first_index, 0, 0);
+    // the vertex offset is added to every index, so gl_VertexIndex lands inside the mesh's pool range.
+    // gl_InstanceIndex starts at first_instance, which picks the transform
+    if (meshlet_draw.max_draw_count > 0) {
+      // one command per meshlet that survived culling, the count was written next to them. they carry the
+      // instance of their job
+      vkCmdDrawIndexedIndirectCount(cmd, meshlet_draw_buffer, meshlet_draw.command_offset, meshlet_draw_buffer,
+                                    meshlet_draw.count_offset, meshlet_draw.max_draw_count,
+                                    sizeof(VkDrawIndexedIndirectCommand));
+    } else {
+      vkCmdDrawIndexed(cmd, render_obj.index_count, instance_count, render_obj.first_index,
+                       render_obj.vertex_offset, first_instance);
+    }
 
     stats.drawcall_count++;
-    stats.triangle_count += render_obj.index_count / 3;
+    stats.instance_count += instance_count;
+    // counted before meshlet culling
+    stats.triangle_count += render_obj.index_count / 3 * instance_count;
   };
 
-  for (auto& idx : opaque_indices) {
-
-    draw(_main_draw_context.opaque_surfaces[idx]);
+  // a run of the same surface level drawn whole becomes one instanced draw. meshlet culled surfaces keep their own
+  // indirect draws, since every copy culls different meshlets
+  for (size_t i = 0; i < opaque_indices.size();) {
+    const RenderObject& obj = opaque[opaque_indices[i]];
+    size_t end = i + 1;
+    if (_instancing && meshlet_draws[i].max_draw_count == 0) {
+      while (end < opaque_indices.size() && meshlet_draws[end].max_draw_count == 0 &&
+             same_draw(obj, opaque[opaque_indices[end]])) {
+        end++;
+      }
+    }
+    draw(obj, meshlet_draws[i], static_cast<uint32_t>(i), static_cast<uint32_t>(end - i));
+    i = end;
   }
-  for (auto& obj : _main_draw_context.transparent_surfaces) {
-    draw(obj);
+  // blending depends on submission order, so transparent objects stay one draw each
+  uint32_t instance = static_cast<uint32_t>(opaque_indices.size());
+  for (const RenderObject& obj : transparent) {
+    draw(obj, MeshletDraw{}, instance++, 1);
   }
 
   vkCmdEndRendering(cmd);
 
-  _main_draw_context.opaque_surfaces.clear();
-  _main_draw_context.transparent_surfaces.clear();
-
   auto end = std::chrono::system_clock::now();
 
   // convert to microseconds (integer), and then come back to miliseconds
@@ -1479,18 +2009,25 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
 void VulkanEngine::update_scene() {
   auto start = std::chrono::system_clock::now();
 
-  _main_draw_context.opaque_surfaces.clear();
-
   _main_camera.update();
   _scene_data.view = _main_camera.get_view_matrix();
 
   glm::mat4 rotate = glm::rotate(glm::mat4(1.f), glm::radians((float)_frame_number), glm::vec3{0, 1, 0});
 
-  //  _loaded_nodes["Suzanne"]->Draw(rotate, _main_draw_context);
-  _loaded_scenes["structure"]->Draw(glm::mat4{1.f}, _main_draw_context);
+  const float fov_y = glm::radians(70.f);
+  _main_draw_context.lod.camera_position = _main_camera.position;
+  _main_draw_context.lod.projection_scale = (float)_window_extent.height / (2.f * std::tan(fov_y / 2.f));
+  _main_draw_context.lod.error_threshold = _lod_error_threshold;
+  _main_draw_context.lod.hysteresis = _lod_hysteresis;
+  _main_draw_context.resident_ticket = _async_uploader.resident_ticket();
+
+  // the list keeps last frame's objects, scenes only apply what changed since
+  _loaded_scenes["structure"]->update_render_list(_render_list, _main_draw_context);
+  stats.render_list_changes = static_cast<int>(_render_list.take_change_count());
+  _render_list.update_bvh();
 
   _scene_data.proj =
-      glm::perspective(glm::radians(70.f), (float)_window_extent.width / (float)_window_extent.height, 10000.f, 0.1f);
+      glm::perspective(fov_y, (float)_window_extent.width / (float)_window_extent.height, 10000.f, 0.1f);
   _scene_data.proj[1][1] *= -1;
   _scene_data.viewproj = _scene_data.proj * _scene_data.view;
   _scene_data.ambient_color = glm::vec4(0.1f);
@@ -1518,7 +2055,10 @@ void VulkanEngine::destroy_swapchain() {
   }
 };
 void VulkanEngine::resize_swapchain() {
-  vkDeviceWaitIdle(_device);
+  {
+    std::lock_guard<std::mutex> lock(_queue_mutex);
+    vkDeviceWaitIdle(_device);
+  }
   destroy_swapchain();
   destroy_sync_structures();
   int w, h;
@@ -1533,16 +2073,23 @@ void VulkanEngine::resize_swapchain() {
   _resize_requested = false;
 }
 
-// allocate image with vma, then make an image view for it
 AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped) {
+  uint32_t mip_levels = 1;
+  if (mipmapped) {
+    mip_levels = static_cast<uint32_t>(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
+  }
+  return allocate_image(size, format, usage, mip_levels);
+}
+
+// allocate image with vma, then make an image view for it
+AllocatedImage VulkanEngine::allocate_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
+                                            uint32_t mip_levels) {
   AllocatedImage newImage;
   newImage.image_format = format;
   newImage.image_extent = size;
 
   VkImageCreateInfo img_info = vkinit::image_create_info(format, usage, size, VK_SAMPLE_COUNT_1_BIT);
-  if (mipmapped) {
-    img_info.mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
-  }
+  img_info.mipLevels = mip_levels;
 
   // always allocate images on dedicated GPU memory
   VmaAllocationCreateInfo allocinfo = {};
@@ -1570,43 +2117,33 @@ AllocatedImage VulkanEngine::create_image(VkExtent3D size, VkFormat format, VkIm
 
 AllocatedImage VulkanEngine::create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
                                           bool mipmapped) {
-  size_t data_size = size.depth * size.width * size.height * 4;
-  AllocatedBuffer uploadbuffer =
-      create_buffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+  UploadBatch batch{this};
+  AllocatedImage new_image = create_image(batch, data, size, format, usage, mipmapped);
+  batch.flush();
 
-  memcpy(uploadbuffer.info.pMappedData, data, data_size);
+  return new_image;
+}
+
+AllocatedImage VulkanEngine::create_image(UploadBatch& batch, void* data, VkExtent3D size, VkFormat format,
+                                          VkImageUsageFlags usage, bool mipmapped) {
+  size_t data_size = size.depth * size.width * size.height * 4;
 
   AllocatedImage new_image =
       create_image(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, mipmapped);
 
-  immediate_submit([&](VkCommandBuffer cmd) {
-    vkutil::transition_image(cmd, new_image.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-
-    VkBufferImageCopy copyRegion = {};
-    copyRegion.bufferOffset = 0;
-    copyRegion.bufferRowLength = 0;
-    copyRegion.bufferImageHeight = 0;
+  batch.upload_image(new_image, data, data_size, mipmapped);
 
-    copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copyRegion.imageSubresource.mipLevel = 0;
-    copyRegion.imageSubresource.baseArrayLayer = 0;
-    copyRegion.imageSubresource.layerCount = 1;
-    copyRegion.imageExtent = size;
-
-    // copy the buffer into the image
-    vkCmdCopyBufferToImage(cmd, uploadbuffer.buffer, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-                           &copyRegion);
+  return new_image;
+}
 
-    if (mipmapped) {
-      VkExtent2D image_extent{.width = new_image.image_extent.width, .height = new_image.image_extent.height};
-      vkutil::generate_mipmaps(cmd, new_image.image, image_extent);
-    } else {
-      vkutil::transition_image(cmd, new_image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-    }
-  });
+AllocatedImage VulkanEngine::create_compressed_image(UploadBatch& batch, const void* data, size_t data_size,
+                                                     std::span<const VkDeviceSize> level_offsets, VkExtent3D size,
+                                                     VkFormat format, VkImageUsageFlags usage) {
+  // the mip chain comes with the data, nothing is blitted so the image is never a transfer source
+  AllocatedImage new_image = allocate_image(size, format, usage | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                                            static_cast<uint32_t>(level_offsets.size()));
 
-  destroy_buffer(uploadbuffer);
+  batch.upload_image_levels(new_image, data, data_size, level_offsets);
 
   return new_image;
 }
@@ -1617,8 +2154,11 @@ void VulkanEngine::destroy_image(const AllocatedImage& img) {
 }
 
 void GLTFMettallicRoughness::build_pipelines(VulkanEngine* engine) {
+  // the packed format decodes its vertices in a separate shader, everything after the vertex fetch is shared
+  const char* mesh_vert_path = engine->_vertex_format == VertexFormat::Packed ? "../../shaders/mesh_packed.vert.spv"
+                                                                              : "../../shaders/mesh.vert.spv";
   VkShaderModule mesh_vert_shader;
-  if (!vkutil::load_shader_module("../../shaders/mesh.vert.spv", engine->_device, &mesh_vert_shader)) {
+  if (!vkutil::load_shader_module(mesh_vert_path, engine->_device, &mesh_vert_shader)) {
     fmt::println("Error when building the mesh vertex shader module");
   }
 
@@ -1632,13 +2172,12 @@ void GLTFMettallicRoughness::build_pipelines(VulkanEngine* engine) {
   matrix_range.size = sizeof(GPUDrawPushConstants);
   matrix_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
+  // material constants are read through the push constants, the set only holds the textures
   DescriptorLayoutBuilder layout_builder{};
-  layout_builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
   layout_builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
   layout_builder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
-  material_desc_layout =
-      layout_builder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+  material_desc_layout = layout_builder.build(engine->_object_cache, VK_SHADER_STAGE_FRAGMENT_BIT);
 
   std::array<VkDescriptorSetLayout, 2> layouts{engine->_gpu_scene_descriptor_layout, material_desc_layout};
 
@@ -1648,8 +2187,7 @@ void GLTFMettallicRoughness::build_pipelines(VulkanEngine* engine) {
   mesh_layout_info.pPushConstantRanges = &matrix_range;
   mesh_layout_info.pushConstantRangeCount = 1;
 
-  VkPipelineLayout new_layout{};
-  VK_CHECK(vkCreatePipelineLayout(engine->_device, &mesh_layout_info, nullptr, &new_layout));
+  VkPipelineLayout new_layout = engine->_object_cache.pipeline_layout(mesh_layout_info);
 
   opaque_pipeline.layout = new_layout;
   transparent_pipeline.layout = new_layout;
@@ -1679,17 +2217,16 @@ void GLTFMettallicRoughness::build_pipelines(VulkanEngine* engine) {
   vkDestroyShaderModule(engine->_device, mesh_frag_shader, nullptr);
 
   _deletion_queue.push_function([=, this]() {
-    vkDestroyDescriptorSetLayout(engine->_device, material_desc_layout, nullptr);
     vkDestroyPipeline(engine->_device, opaque_pipeline.pipeline, nullptr);
     vkDestroyPipeline(engine->_device, transparent_pipeline.pipeline, nullptr);
-    // they both use the same layout
-    vkDestroyPipelineLayout(engine->_device, opaque_pipeline.layout, nullptr);
   });
 }
 
 MaterialInstance GLTFMettallicRoughness::write_material(VkDevice device, MaterialPass pass,
                                                         const MaterialResources& resources,
-                                                        DescriptorAllocatorGrowable& descriptorAllocator) {
+                                                        DescriptorAllocatorGrowable& descriptorAllocator,
+                                                        MaterialTextureSets* shared_sets,
+                                                        std::vector<VkDescriptorSet>* free_sets) {
   MaterialInstance matData;
   matData.pass_type = pass;
   if (pass == MaterialPass::Transparent) {
@@ -1697,12 +2234,33 @@ MaterialInstance GLTFMettallicRoughness::write_material(VkDevice device, Materia
   } else {
     matData.pipeline = &opaque_pipeline;
   }
+  matData.data_address = resources.data_address;
+  matData.data_index = resources.data_index;
+
+  const auto textures = std::make_tuple(resources.color_image.image_view, resources.color_sampler,
+                                        resources.metal_rough_image.image_view, resources.metal_rough_sampler);
+  if (shared_sets != nullptr) {
+    auto it = shared_sets->find(textures);
+    if (it != shared_sets->end()) {
+      matData.material_desc_set = it->second;
+      return matData;
+    }
+  }
 
-  matData.material_desc_set = descriptorAllocator.allocate(device, material_desc_layout);
+  // background loads and the frame loop both write materials through the shared writer
+  std::lock_guard<std::mutex> lock(desc_writer_mutex);
+
+  if (free_sets != nullptr && !free_sets->empty()) {
+    matData.material_desc_set = free_sets->back();
+    free_sets->pop_back();
+  } else {
+    matData.material_desc_set = descriptorAllocator.allocate(device, material_desc_layout);
+  }
+  if (shared_sets != nullptr) {
+    shared_sets->emplace(textures, matData.material_desc_set);
+  }
 
   desc_writer.clear();
-  desc_writer.write_buffer(0, resources.data_buffer, sizeof(MaterialConstants), resources.data_buffer_offset,
-                           VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
   desc_writer.write_image(1, resources.color_image.image_view, resources.color_sampler,
                           VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
   desc_writer.write_image(2, resources.metal_rough_image.image_view, resources.metal_rough_sampler,
@@ -1713,24 +2271,3 @@ MaterialInstance GLTFMettallicRoughness::write_material(VkDevice device, Materia
   return matData;
 }
 
-void MeshNode::Draw(const glm::mat4& top_matrix, DrawContext& ctx) {
-  glm::mat4 node_matrix = world_transform * top_matrix;
-
-  for (auto& s : mesh->surfaces) {
-    RenderObject obj;
-    obj.material = &s.material->data;
-    obj.index_count = s.count;
-    obj.first_index = s.startIndex;
-    obj.index_buffer = mesh->meshBuffers.index_buf.buffer;
-    obj.bounds = s.bounds;
-    obj.transform = node_matrix;
-    obj.vertex_buf_addr = mesh->meshBuffers.vertex_buf_address;
-
-    if (s.material->data.pass_type == MaterialPass::Transparent) {
-      ctx.transparent_surfaces.push_back(obj);
-    } else {
-      ctx.opaque_surfaces.push_back(obj);
-    }
-  }
-  Node::Draw(top_matrix, ctx);
-}
@@ -5,41 +5,77 @@
 #include "vk_mem_alloc.h"
 #include "vulkan/vulkan_core.h"
 #include <camera.h>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <meshlets.h>
+#include <mutex>
+#include <render_list.h>
 #include <span>
 #include <string>
+#include <texture_cache.h>
+#include <texture_streamer.h>
+#include <thread_pool.h>
+#include <vk_geometry_pool.h>
 #include <vk_loader.h>
+#include <vk_object_cache.h>
 #include <vk_types.h>
+#include <vk_upload.h>
 
 struct EngineStats {
   float frame_time;
   int triangle_count;
   int drawcall_count;
+  // objects drawn, more than drawcall_count once surfaces are instanced
+  int instance_count;
+  // material texture sets bound
+  int material_binds;
+  int meshlet_count;
   float scene_update_time;
   float mesh_draw_time;
+  // render list objects added, removed or updated by the last scene update
+  int render_list_changes;
+  // culling and draw list building, the whole step and each thread's part of it
+  float cull_time;
+  std::vector<float> cull_thread_ms;
+  // average part time over the slowest one's, 1 when the threads were evenly loaded
+  float cull_balance;
+  // from the start of init to the first presented frame, and to the first one with scene geometry in it
+  float first_frame_ms{0.f};
+  float first_geometry_frame_ms{0.f};
 };
 
 struct MeshNode : public Node {
   std::shared_ptr<MeshAsset> mesh;
-  virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx) override;
+  // an object per surface in the engine's render list, empty until the mesh is resident
+  std::vector<RenderHandle> render_objects;
 };
 
-struct RenderObject {
-  uint32_t index_count;
-  uint32_t first_index;
-  VkBuffer index_buffer;
+// view parameters draw_geometry picks surface lods with
+struct LodSelection {
+  glm::vec3 camera_position;
+  // screen pixels covered by one unit at a distance of one unit
+  float projection_scale;
+  // largest simplification error allowed on screen, in pixels. 0 always draws full detail
+  float error_threshold;
+  // a coarser level is only picked once its error is this fraction below the threshold, so objects
+  // near the switching distance don't flicker between levels
+  float hysteresis;
+};
 
-  Bounds bounds;
-  MaterialInstance* material;
-  glm::mat4 transform;
-  VkDeviceAddress vertex_buf_addr;
+// indirect draw cull_meshlets leaves for one surface. offsets are into the frame's meshlet_draws buffer,
+// max_draw_count is 0 for surfaces that are drawn directly
+struct MeshletDraw {
+  VkDeviceSize command_offset;
+  VkDeviceSize count_offset;
+  uint32_t max_draw_count;
 };
 
 struct DrawContext {
-  std::vector<RenderObject> opaque_surfaces;
-  std::vector<RenderObject> transparent_surfaces;
+  LodSelection lod;
+  // async uploads up to this ticket can be drawn
+  uint64_t resident_ticket{0};
 };
 
 struct GLTFMettallicRoughness {
@@ -49,11 +85,11 @@ struct GLTFMettallicRoughness {
   VkDescriptorSetLayout material_desc_layout;
   DeletionQueue _deletion_queue;
 
+  // one record of a material table, a tightly packed storage buffer the vertex shaders index with the draw's
+  // material index. layout matches MaterialData in input_structures.glsl
   struct MaterialConstants {
     glm::vec4 color_factors;
     glm::vec4 metal_rough_factors;
-    // padding
-    glm::vec4 extra[14];
   };
 
   struct MaterialResources {
@@ -61,17 +97,23 @@ struct GLTFMettallicRoughness {
     VkSampler color_sampler;
     AllocatedImage metal_rough_image;
     VkSampler metal_rough_sampler;
-    VkBuffer data_buffer;
-    uint32_t data_buffer_offset;
+    // device address of the material table and the material's record in it
+    VkDeviceAddress data_address;
+    uint32_t data_index;
   };
 
   DescriptorWriter desc_writer;
+  std::mutex desc_writer_mutex;
 
   void build_pipelines(VulkanEngine* engine);
   void clear_resources(VkDevice device);
 
+  // the texture set comes from shared_sets when one was already written for the same textures, otherwise it is
+  // taken from free_sets, or allocated from descriptor_allocator when there are none, and added there
   MaterialInstance write_material(VkDevice device, MaterialPass pass, const MaterialResources&,
-                                  DescriptorAllocatorGrowable& descriptor_allocator);
+                                  DescriptorAllocatorGrowable& descriptor_allocator,
+                                  MaterialTextureSets* shared_sets = nullptr,
+                                  std::vector<VkDescriptorSet>* free_sets = nullptr);
 };
 
 constexpr static uint32_t FRAME_OVERLAP = 3;
@@ -87,7 +129,51 @@ struct VulkanEngine {
   Camera _main_camera;
   EngineStats stats;
 
+  // workers for cpu side loading work
+  ThreadPool _thread_pool;
+
+  // layout meshes are uploaded in and the mesh pipelines read. has to be set before init()
+  VertexFormat _vertex_format{VertexFormat::Full};
+  // weld and reorder meshes for the vertex cache and fetch locality while importing them
+  bool _optimize_meshes{true};
+
+  // size of each geometry pool block. the pool adds a block whenever a mesh fits in none of the ones it has, so
+  // this trades unused vram against how often draws switch blocks. has to be set before init()
+  VkDeviceSize _geometry_block_vertex_bytes{128ull * 1024 * 1024};
+  VkDeviceSize _geometry_block_index_bytes{64ull * 1024 * 1024};
+  VkDeviceSize _geometry_block_meshlet_bytes{16ull * 1024 * 1024};
+
+  // surface lod selection, see LodSelection
+  float _lod_error_threshold{1.f};
+  float _lod_hysteresis{0.25f};
+
+  // keep only the mip levels the screen needs of large KTX2 and cooked textures, within a vram budget
+  bool _texture_streaming{true};
+  int _texture_budget_mb{256};
+
+  // cull full detail surfaces per meshlet in a compute pass and draw the survivors indirectly. needs the
+  // multiDrawIndirect, drawIndirectFirstInstance and drawIndirectCount features, surfaces are drawn whole without
+  // them
+  bool _meshlet_culling{true};
+  bool _meshlet_culling_supported{false};
+
+  // visible copies of a surface level with the same material go out as one instanced draw
+  bool _instancing{true};
+
+  // threads culling the render list and sorting the draw list, the main thread included. 0 picks one per core,
+  // up to 8. has to be set before init()
+  uint32_t _cull_threads{0};
+  std::unique_ptr<ThreadPool> _cull_pool;
+  // visible objects of each culling part, kept so they keep their capacity
+  std::vector<std::vector<uint32_t>> _cull_parts;
+  // render list hierarchy subtrees the parts share out
+  std::vector<uint32_t> _cull_roots;
+  // cull through the render list's bounding volume hierarchy instead of testing every object
+  bool _bvh_culling{true};
+
   DrawContext _main_draw_context;
+  // every drawable surface of the loaded scenes, kept up to date by update_scene
+  RenderList _render_list;
   std::unordered_map<std::string, std::shared_ptr<Node>> _loaded_nodes;
   std::unordered_map<std::string, std::shared_ptr<LoadedGLTF>> _loaded_scenes;
 
@@ -100,6 +186,12 @@ struct VulkanEngine {
   uint32_t _graphics_queue_family;
   VkQueue _present_queue;
   uint32_t _present_queue_family;
+  // dedicated transfer queue when the device has one, otherwise the graphics queue
+  VkQueue _transfer_queue;
+  uint32_t _transfer_queue_family;
+  // queue submits need external synchronization. uploads are submitted from loader and streaming threads, and
+  // on devices without a separate transfer family they share the graphics queue
+  std::mutex _queue_mutex;
 
   VkPhysicalDeviceFeatures _device_features;
   VkSurfaceKHR _surface;
@@ -133,6 +225,15 @@ struct VulkanEngine {
   VkCommandPool _imm_cmd_pool;
   VkDescriptorPool _imm_descriptor_pool = VK_NULL_HANDLE;
 
+  AsyncUploader _async_uploader;
+  GeometryPool _geometry_pool;
+  // uploaded textures shared by every loaded scene
+  TextureCache _texture_cache;
+  // mip levels of the cached textures too large to keep whole
+  TextureStreamer _texture_streamer;
+  // samplers and layouts shared by everything that asks for the same create info
+  ObjectCache _object_cache;
+
   std::vector<ComputeEffect> _background_effects;
   int32_t _current_background_effect{0};
 
@@ -140,6 +241,8 @@ struct VulkanEngine {
   VkPipeline _triangle_pipeline;
   VkPipelineLayout _mesh_pipeline_layout;
   VkPipeline _mesh_pipeline;
+  VkPipelineLayout _meshlet_cull_pipeline_layout;
+  VkPipeline _meshlet_cull_pipeline;
 
   GPUMeshBuffers rectangle;
   std::vector<std::shared_ptr<MeshAsset>> _test_meshes;
@@ -173,9 +276,12 @@ struct VulkanEngine {
   void create_image_views();
   void init_commands();
   void init_sync_structures();
+  void init_async_uploads();
+  void init_geometry_pool();
   void init_descriptors();
   void init_pipelines();
   void init_background_pipelines();
+  void init_meshlet_cull_pipeline();
   void init_imgui();
   void init_default_data();
   void init_camera();
@@ -186,10 +292,22 @@ struct VulkanEngine {
 
   // draws
   void draw_background(VkCommandBuffer cmd);
+  // records the meshlet cull dispatch for the visible opaque surfaces, has to happen outside of rendering.
+  // fills draws with the indirect draw of each entry in opaque_indices
+  void cull_meshlets(VkCommandBuffer cmd, std::span<const uint32_t> opaque_indices, std::vector<MeshletDraw>& draws);
+  // culls the opaque objects on the cull threads, a hierarchy subtree or a range of objects at a time, picks the lod
+  // of the visible ones and returns them in draw order
+  void build_draw_list(std::vector<uint32_t>& opaque_indices);
+  // fills the frame's instance buffer with the transforms of the visible opaque objects, in the order of
+  // opaque_indices, followed by the transparent ones
+  void write_instances(std::span<const uint32_t> opaque_indices);
   void draw_geometry(VkCommandBuffer cmd);
   void draw_imgui(VkCommandBuffer cmd, VkImageView target_image_view);
 
   void update_scene();
+  // time to first frame, logged once for the first present and once for the first one that drew the scene
+  void log_first_frames();
+  std::chrono::steady_clock::time_point _init_start;
 
   // utils
   static VKAPI_ATTR VkBool32 VKAPI_CALL debug_callback(VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
@@ -199,22 +317,43 @@ struct VulkanEngine {
 
   bool is_device_suitable(VkPhysicalDevice physical_device);
   QueueFamilyIndices find_queue_families(VkPhysicalDevice physical_device);
+  AllocatedImage allocate_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, uint32_t mip_levels);
   SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice physical_device);
   VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities);
   void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
   AllocatedBuffer create_buffer(size_t alloc_size, VkBufferUsageFlags buf_usage, VmaMemoryUsage mem_usage);
+  // for buffers created with VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT
+  VkDeviceAddress buffer_address(VkBuffer buffer);
   AllocatedImage create_image(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
   AllocatedImage create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage,
                               bool mipmapped = false);
+  // records the upload into batch instead of submitting it. the pixels are only valid after batch.flush()
+  AllocatedImage create_image(UploadBatch& batch, void* data, VkExtent3D size, VkFormat format,
+                              VkImageUsageFlags usage, bool mipmapped = false);
+  // block compressed image with a prebuilt mip chain, data holds every level starting at level_offsets.
+  // the upload is recorded into batch like above
+  AllocatedImage create_compressed_image(UploadBatch& batch, const void* data, size_t data_size,
+                                         std::span<const VkDeviceSize> level_offsets, VkExtent3D size,
+                                         VkFormat format, VkImageUsageFlags usage);
   void destroy_buffer(const AllocatedBuffer& buffer);
   void destroy_image(const AllocatedImage& img);
+  std::optional<GeometryAllocation> upload_mesh(UploadBatch& batch, std::span<const uint32_t> indices,
+                                                const void* vertex_data, uint32_t vertex_count,
+                                                uint32_t vertex_stride, std::span<const Meshlet> meshlets);
 
   void destroy_swapchain();
   void destroy_sync_structures();
   void resize_swapchain();
 
 public:
-  GPUMeshBuffers upload_mesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+  // places the mesh in the geometry pool. indices are relative to the mesh's first vertex
+  std::optional<GeometryAllocation> upload_mesh(std::span<const uint32_t> indices, std::span<const Vertex> vertices);
+  std::optional<GeometryAllocation> upload_mesh(UploadBatch& batch, std::span<const uint32_t> indices,
+                                                std::span<const Vertex> vertices,
+                                                std::span<const Meshlet> meshlets = {});
+  std::optional<GeometryAllocation> upload_mesh(UploadBatch& batch, std::span<const uint32_t> indices,
+                                                std::span<const PackedVertex> vertices,
+                                                std::span<const Meshlet> meshlets = {});
   int _frame_number{0};
   VkExtent2D _window_extent{1700, 900};
 
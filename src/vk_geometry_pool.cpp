@@ -0,0 +1,216 @@
+#include "vk_engine.h"
+#include <algorithm>
+#include <array>
+#include <meshlets.h>
+#include <vk_geometry_pool.h>
+
+void RangeAllocator::init(uint64_t capacity) {
+  _free_ranges.clear();
+  _free_ranges[0] = capacity;
+  _capacity = capacity;
+  _used = 0;
+}
+
+std::optional<uint64_t> RangeAllocator::allocate(uint64_t size, uint64_t alignment) {
+  if (size == 0) {
+    return 0;
+  }
+
+  for (auto it = _free_ranges.begin(); it != _free_ranges.end(); ++it) {
+    auto [range_offset, range_size] = *it;
+
+    uint64_t aligned = (range_offset + alignment - 1) / alignment * alignment;
+    uint64_t padding = aligned - range_offset;
+    if (padding + size > range_size) {
+      continue;
+    }
+
+    _free_ranges.erase(it);
+
+    // give back whatever is left on either side of the allocation
+    if (padding > 0) {
+      _free_ranges[range_offset] = padding;
+    }
+    if (padding + size < range_size) {
+      _free_ranges[aligned + size] = range_size - padding - size;
+    }
+
+    _used += size;
+    return aligned;
+  }
+
+  return {};
+}
+
+void RangeAllocator::free(uint64_t offset, uint64_t size) {
+  if (size == 0) {
+    return;
+  }
+  _used -= size;
+
+  auto next = _free_ranges.lower_bound(offset);
+
+  // merge with the free range right after
+  if (next != _free_ranges.end() && offset + size == next->first) {
+    size += next->second;
+    next = _free_ranges.erase(next);
+  }
+
+  // merge with the free range right before
+  if (next != _free_ranges.begin()) {
+    auto prev = std::prev(next);
+    if (prev->first + prev->second == offset) {
+      prev->second += size;
+      return;
+    }
+  }
+
+  _free_ranges[offset] = size;
+}
+
+void GeometryPool::init(VulkanEngine* engine, VkDeviceSize vertex_capacity, VkDeviceSize index_capacity,
+                        VkDeviceSize meshlet_capacity) {
+  _engine = engine;
+  _vertex_capacity = vertex_capacity;
+  _index_capacity = index_capacity;
+  _meshlet_capacity = meshlet_capacity;
+
+  // concurrent sharing lets the transfer queue write new meshes while the graphics queue reads the rest of the pool
+  _concurrent_sharing = _engine->_graphics_queue_family != _engine->_transfer_queue_family;
+}
+
+void GeometryPool::cleanup() {
+  for (uint32_t i = 0; i < block_count(); i++) {
+    _engine->destroy_buffer(_blocks[i].vertex_buffer);
+    _engine->destroy_buffer(_blocks[i].index_buffer);
+    _engine->destroy_buffer(_blocks[i].meshlet_buffer);
+  }
+  _block_count.store(0, std::memory_order_release);
+}
+
+bool GeometryPool::add_block(VkDeviceSize vertex_bytes, VkDeviceSize index_bytes, VkDeviceSize meshlet_bytes) {
+  const uint32_t index = block_count();
+  if (index == MAX_GEOMETRY_BLOCKS) {
+    return false;
+  }
+
+  std::array<uint32_t, 2> families{_engine->_graphics_queue_family, _engine->_transfer_queue_family};
+  auto create_pool_buffer = [&](VkDeviceSize size, VkBufferUsageFlags usage, AllocatedBuffer& new_buffer) {
+    VkBufferCreateInfo buffer_ci{};
+    buffer_ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    buffer_ci.usage = usage;
+    buffer_ci.size = size;
+    if (_concurrent_sharing) {
+      buffer_ci.sharingMode = VK_SHARING_MODE_CONCURRENT;
+      buffer_ci.queueFamilyIndexCount = static_cast<uint32_t>(families.size());
+      buffer_ci.pQueueFamilyIndices = families.data();
+    }
+
+    VmaAllocationCreateInfo vma_ai{};
+    vma_ai.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+    return vmaCreateBuffer(_engine->_allocator, &buffer_ci, &vma_ai, &new_buffer.buffer, &new_buffer.allocation,
+                           &new_buffer.info) == VK_SUCCESS;
+  };
+
+  // running out of device memory fails the allocation instead of the engine
+  GeometryBlock block{};
+  if (!create_pool_buffer(vertex_bytes,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                          block.vertex_buffer)) {
+    return false;
+  }
+  if (!create_pool_buffer(index_bytes,
+                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                              VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          block.index_buffer)) {
+    _engine->destroy_buffer(block.vertex_buffer);
+    return false;
+  }
+  if (!create_pool_buffer(meshlet_bytes,
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+                              VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                          block.meshlet_buffer)) {
+    _engine->destroy_buffer(block.vertex_buffer);
+    _engine->destroy_buffer(block.index_buffer);
+    return false;
+  }
+  block.vertex_address = _engine->buffer_address(block.vertex_buffer.buffer);
+  block.meshlet_address = _engine->buffer_address(block.meshlet_buffer.buffer);
+
+  _blocks[index] = block;
+  _ranges[index].vertex.init(vertex_bytes);
+  _ranges[index].index.init(index_bytes);
+  _ranges[index].meshlet.init(meshlet_bytes);
+  // published last, the frame loop reads blocks below the count without the lock
+  _block_count.store(index + 1, std::memory_order_release);
+  return true;
+}
+
+std::optional<GeometryAllocation> GeometryPool::allocate(uint32_t vertex_count, uint32_t vertex_stride,
+                                                         uint32_t index_count, uint32_t meshlet_count) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  const uint64_t vertex_bytes = uint64_t(vertex_count) * vertex_stride;
+  const uint64_t index_bytes = uint64_t(index_count) * sizeof(uint32_t);
+  const uint64_t meshlet_bytes = uint64_t(meshlet_count) * sizeof(Meshlet);
+
+  // all of a mesh's ranges sit in one block, so its draws bind a single index buffer and vertex address
+  auto place = [&](uint32_t block) -> std::optional<GeometryAllocation> {
+    BlockRanges& ranges = _ranges[block];
+    // vertices are addressed as gl_VertexIndex * stride, so every range has to start on a multiple of its stride
+    std::optional<uint64_t> vertex_offset = ranges.vertex.allocate(vertex_bytes, vertex_stride);
+    if (!vertex_offset.has_value()) {
+      return {};
+    }
+
+    std::optional<uint64_t> index_offset = ranges.index.allocate(index_bytes, sizeof(uint32_t));
+    if (!index_offset.has_value()) {
+      ranges.vertex.free(*vertex_offset, vertex_bytes);
+      return {};
+    }
+
+    std::optional<uint64_t> meshlet_offset = ranges.meshlet.allocate(meshlet_bytes, sizeof(Meshlet));
+    if (!meshlet_offset.has_value()) {
+      ranges.vertex.free(*vertex_offset, vertex_bytes);
+      ranges.index.free(*index_offset, index_bytes);
+      return {};
+    }
+
+    GeometryAllocation allocation{};
+    allocation.block = block;
+    allocation.first_index = static_cast<uint32_t>(*index_offset / sizeof(uint32_t));
+    allocation.index_count = index_count;
+    allocation.vertex_offset = static_cast<uint32_t>(*vertex_offset / vertex_stride);
+    allocation.vertex_count = vertex_count;
+    allocation.vertex_stride = vertex_stride;
+    allocation.first_meshlet = static_cast<uint32_t>(*meshlet_offset / sizeof(Meshlet));
+    allocation.meshlet_count = meshlet_count;
+    return allocation;
+  };
+
+  for (uint32_t block = 0; block < block_count(); block++) {
+    if (std::optional<GeometryAllocation> allocation = place(block)) {
+      return allocation;
+    }
+  }
+
+  // a new block is at least the configured size, and large enough for the mesh on its own
+  if (!add_block(std::max(_vertex_capacity, vertex_bytes), std::max(_index_capacity, index_bytes),
+                 std::max(_meshlet_capacity, meshlet_bytes))) {
+    return {};
+  }
+  return place(block_count() - 1);
+}
+
+void GeometryPool::free(const GeometryAllocation& allocation) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  BlockRanges& ranges = _ranges[allocation.block];
+  ranges.vertex.free(uint64_t(allocation.vertex_offset) * allocation.vertex_stride,
+                     uint64_t(allocation.vertex_count) * allocation.vertex_stride);
+  ranges.index.free(uint64_t(allocation.first_index) * sizeof(uint32_t),
+                    uint64_t(allocation.index_count) * sizeof(uint32_t));
+  ranges.meshlet.free(uint64_t(allocation.first_meshlet) * sizeof(Meshlet),
+                      uint64_t(allocation.meshlet_count) * sizeof(Meshlet));
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <vk_types.h>
+
+class VulkanEngine;
+
+// first fit allocator over an abstract range. free ranges are kept sorted so neighbours merge on free
+class RangeAllocator {
+public:
+  void init(uint64_t capacity);
+  // empty allocations always succeed, at offset 0
+  std::optional<uint64_t> allocate(uint64_t size, uint64_t alignment = 1);
+  void free(uint64_t offset, uint64_t size);
+
+  uint64_t capacity() const { return _capacity; }
+  uint64_t used() const { return _used; }
+
+private:
+  // offset -> size
+  std::map<uint64_t, uint64_t> _free_ranges;
+  uint64_t _capacity{0};
+  uint64_t _used{0};
+};
+
+// where a mesh lives inside the geometry pool
+struct GeometryAllocation {
+  // the pool block holding all of the mesh's ranges
+  uint32_t block;
+  // in index buffer elements
+  uint32_t first_index;
+  uint32_t index_count;
+  // in vertices, passed to vkCmdDrawIndexed as the vertex offset
+  uint32_t vertex_offset;
+  uint32_t vertex_count;
+  uint32_t vertex_stride;
+  // in meshlets, indexes the meshlet buffer
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+};
+
+// most blocks the pool grows to, the meshlet cull pass gets a table of this many meshlet buffer addresses
+constexpr uint32_t MAX_GEOMETRY_BLOCKS = 16;
+
+// one vertex, index and meshlet buffer of the pool. draws bind the index buffer and vertex address of their block
+struct GeometryBlock {
+  AllocatedBuffer vertex_buffer;
+  AllocatedBuffer index_buffer;
+  AllocatedBuffer meshlet_buffer;
+  VkDeviceAddress vertex_address;
+  VkDeviceAddress meshlet_address;
+};
+
+// engine wide vertex, index and meshlet buffers that every mesh is suballocated from. the pool starts empty and adds a
+// block whenever a mesh fits in none of the existing ones, blocks never move so meshes keep their place
+class GeometryPool {
+public:
+  // the capacities are per block, a mesh larger than them gets a block of its own size
+  void init(VulkanEngine* engine, VkDeviceSize vertex_capacity, VkDeviceSize index_capacity,
+            VkDeviceSize meshlet_capacity);
+  void cleanup();
+
+  // empty when the device is out of memory or the pool out of blocks
+  std::optional<GeometryAllocation> allocate(uint32_t vertex_count, uint32_t vertex_stride, uint32_t index_count,
+                                             uint32_t meshlet_count = 0);
+  void free(const GeometryAllocation& allocation);
+
+  // blocks below the count are complete and never change
+  uint32_t block_count() const { return _block_count.load(std::memory_order_acquire); }
+  const GeometryBlock& block(uint32_t index) const { return _blocks[index]; }
+
+  // true when the buffers are shared with the transfer queue family, so uploads need no ownership transfer
+  bool concurrent_sharing() const { return _concurrent_sharing; }
+
+private:
+  bool add_block(VkDeviceSize vertex_bytes, VkDeviceSize index_bytes, VkDeviceSize meshlet_bytes);
+
+  VulkanEngine* _engine;
+
+  VkDeviceSize _vertex_capacity;
+  VkDeviceSize _index_capacity;
+  VkDeviceSize _meshlet_capacity;
+  bool _concurrent_sharing{false};
+
+  std::array<GeometryBlock, MAX_GEOMETRY_BLOCKS> _blocks{};
+  std::atomic<uint32_t> _block_count{0};
+
+  // all allocators work in bytes. background loads allocate while the frame loop frees
+  struct BlockRanges {
+    RangeAllocator vertex;
+    RangeAllocator index;
+    RangeAllocator meshlet;
+  };
+  std::mutex _mutex;
+  std::array<BlockRanges, MAX_GEOMETRY_BLOCKS> _ranges;
+};
@@ -1,9 +1,22 @@
 #define GLM_ENABLE_EXPERIMENTAL 1
 
+#include <algorithm>
+#include <chrono>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <vk_loader.h>
 
+#include "cooked_texture.h"
+#include "hash.h"
+#include "ktx2.h"
+#include "mapped_file.h"
+#include "mapped_gltf.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "mesh_simplifier.h"
+#include "meshlets.h"
+#include "vertex_streams.h"
 #include "vk_engine.h"
 #include "vk_types.h"
 
@@ -23,6 +36,14 @@
 
 constexpr bool MIPMAP_ENABLED = true;
 
+// every lod aims for half the triangles of the level above it. the chain ends at MAX_SURFACE_LODS, when a level
+// would need more than LOD_MAX_ERROR of the primitive's size, or when it can't get below 3/4 of its source
+constexpr float LOD_MAX_ERROR = 0.05f;
+constexpr size_t LOD_MIN_TRIANGLES = 64;
+
+// geometry staged per transfer submit while a scene streams in
+constexpr size_t PROGRESSIVE_BATCH_BYTES = 32 * 1024 * 1024;
+
 static VkFilter extract_filter(fastgltf::Filter filter) {
   switch (filter) {
   // nearest samplers
@@ -53,145 +74,358 @@ static VkSamplerMipmapMode extract_mipmap_mode(fastgltf::Filter filter) {
   }
 }
 
-void LoadedGLTF::Draw(const glm::mat4& top_matrix, DrawContext& ctx) {
-  for (auto& n : top_nodes) {
-    n->Draw(top_matrix, ctx);
+void LoadedGLTF::update_render_list(RenderList& list, const DrawContext& ctx) {
+  // a background load may still be building the hierarchy
+  if (!hierarchy_ready.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  // one linear pass over the dirty subtrees, then only the listed mesh nodes inside the recomputed ranges
+  transforms.update();
+  for (const TransformHierarchy::Range& range : transforms.updated()) {
+    auto it = std::lower_bound(mesh_nodes.begin(), mesh_nodes.end(), range.first,
+                               [](const MeshNode* node, uint32_t index) { return node->transform < index; });
+    for (; it != mesh_nodes.end() && (*it)->transform < range.first + range.count; it++) {
+      for (RenderHandle handle : (*it)->render_objects) {
+        list.set_transform(handle, (*it)->world_transform());
+      }
+    }
+  }
+
+  // meshes show up as their uploads become resident
+  std::erase_if(pending_nodes, [&](MeshNode* node) {
+    const MeshAsset& mesh = *node->mesh;
+    if (mesh.upload_ticket.load(std::memory_order_acquire) > ctx.resident_ticket) {
+      return false;
+    }
+    node->render_objects.reserve(mesh.surfaces.size());
+    for (const GeoSurface& surface : mesh.surfaces) {
+      node->render_objects.push_back(list.add(surface_object(mesh, surface, node->world_transform())));
+    }
+    return true;
+  });
+}
+
+void LoadedGLTF::cancel_load() {
+  load_cancelled.store(true, std::memory_order_relaxed);
+  if (loader.valid()) {
+    loader.wait();
   }
 }
 
 void LoadedGLTF::clear_all() {
   VkDevice dv = creator->_device;
+  for (MeshNode* node : mesh_nodes) {
+    for (RenderHandle handle : node->render_objects) {
+      creator->_render_list.remove(handle);
+    }
+    node->render_objects.clear();
+  }
+
   descriptor_pool.destroy_pools(dv);
   creator->destroy_buffer(material_data_buffer);
 
-  for (auto& [k, v] : images) {
+  // frames in flight can still read these pool ranges, so give them back once the current frame retires
+  for (auto& [k, v] : meshes) {
+    GeometryAllocation geometry = v->geometry;
+    VulkanEngine* engine = creator;
+    creator->get_current_frame().deletion_queue.push_function([=]() { engine->_geometry_pool.free(geometry); });
+  }
 
-    if (v.image == creator->_error_checkerboard_image.image) {
-      // dont destroy the default images
-      continue;
-    }
-    creator->destroy_image(v);
+  // shared textures stay alive for the other scenes still using them
+  creator->_texture_streamer.unwatch(this);
+  for (uint64_t key : texture_keys) {
+    creator->_texture_cache.release(key);
   }
+}
 
-  for (auto& sampler : samplers) {
-    vkDestroySampler(dv, sampler, nullptr);
+// pixels of one gltf image. png and jpeg are decoded to rgba8 by stb_image, KTX2 files keep their block
+// compressed mip chain. decoding is pure cpu work so it can run on a worker thread
+struct DecodedImage {
+  unsigned char* pixels{nullptr};
+  int width{0};
+  int height{0};
+  std::optional<Ktx2Image> compressed;
+  // texture cache key for the source bytes in the format the loader wants, 0 when the source can't be read
+  uint64_t cache_key{0};
+  // set instead of pixels when another scene already uploaded the texture
+  std::optional<CachedTexture> cached;
+};
+
+static void decode_bytes(std::span<const std::byte> bytes, DecodedImage& decoded) {
+  if (is_ktx2(bytes)) {
+    decoded.compressed = read_ktx2(bytes);
+    return;
   }
+
+  int nrChannels;
+  decoded.pixels = stbi_load_from_memory((const stbi_uc*)bytes.data(), static_cast<int>(bytes.size()), &decoded.width,
+                                         &decoded.height, &nrChannels, 4);
 }
 
-std::optional<AllocatedImage> load_image(VulkanEngine* engine, fastgltf::Asset& asset, fastgltf::Image& image) {
-  AllocatedImage newImage{};
-
-  int width, height, nrChannels;
-  std::visit(fastgltf::visitor{
-                 [](auto& arg) {},
-                 [&](fastgltf::sources::URI& filePath) {
-                   assert(filePath.fileByteOffset == 0); // We don't support offsets with stbi.
-                   assert(filePath.uri.isLocalPath());   // We're only capable of loading
-                                                         // local files.
-
-                   const std::string path(filePath.uri.path().begin(),
-                                          filePath.uri.path().end()); // Thanks C++.
-                   unsigned char* data = stbi_load(path.c_str(), &width, &height, &nrChannels, 4);
-                   if (data) {
-                     VkExtent3D imagesize;
-                     imagesize.width = width;
-                     imagesize.height = height;
-                     imagesize.depth = 1;
-
-                     newImage = engine->create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                     VK_IMAGE_USAGE_SAMPLED_BIT, MIPMAP_ENABLED);
-
-                     stbi_image_free(data);
-                   }
-                 },
-                 [&](fastgltf::sources::Array& vector) {
-                   unsigned char* data = stbi_load_from_memory(
-                       vector.bytes.data(), static_cast<int>(vector.bytes.size()), &width, &height, &nrChannels, 4);
-                   if (data) {
-                     VkExtent3D imagesize;
-                     imagesize.width = width;
-                     imagesize.height = height;
-                     imagesize.depth = 1;
-
-                     newImage = engine->create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                     VK_IMAGE_USAGE_SAMPLED_BIT, MIPMAP_ENABLED);
-
-                     stbi_image_free(data);
-                   }
-                 },
-                 [&](fastgltf::sources::BufferView& view) {
-                   auto& bufferView = asset.bufferViews[view.bufferViewIndex];
-                   auto& buffer = asset.buffers[bufferView.bufferIndex];
-
-                   std::visit(fastgltf::visitor{// We only care about VectorWithMime here, because we
-                                                // specify LoadExternalBuffers, meaning all buffers
-                                                // are already loaded into a vector.
-                                                [](auto& arg) {},
-                                                [&](fastgltf::sources::Array& vector) {
-                                                  unsigned char* data =
-                                                      stbi_load_from_memory(vector.bytes.data() + bufferView.byteOffset,
-                                                                            static_cast<int>(bufferView.byteLength),
-                                                                            &width, &height, &nrChannels, 4);
-                                                  if (data) {
-                                                    VkExtent3D imagesize;
-                                                    imagesize.width = width;
-                                                    imagesize.height = height;
-                                                    imagesize.depth = 1;
-
-                                                    newImage = engine->create_image(
-                                                        data, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
-                                                        VK_IMAGE_USAGE_SAMPLED_BIT, MIPMAP_ENABLED);
-
-                                                    stbi_image_free(data);
-                                                  }
-                                                }},
-                              buffer.data);
-                 },
-             },
-             image.data);
-
-  // if any of the attempts to load the data failed, we havent written the image
-  // so handle is null
-  if (newImage.image == VK_NULL_HANDLE) {
+// a texture some other scene already uploaded is taken from the engine's texture cache without decoding anything.
+// otherwise the copy texture_cooker left for this image is preferred, which skips both the stb decode and the mip
+// generation. use_cooked is off on devices without BC support, which keep decoding the source
+static DecodedImage decode_image(VulkanEngine* engine, const MappedGltf& gltf, fastgltf::Image& image,
+                                 std::optional<TextureRole> role, bool use_cooked) {
+  DecodedImage decoded{};
+
+  MappedFile source_file;
+  std::span<const std::byte> source = image_source_bytes(gltf.asset(), image, source_file, gltf.buffers());
+  if (source.empty()) {
+    return decoded;
+  }
+
+  // KTX2 sources are uploaded in whatever format they store
+  const uint64_t source_hash = hash_bytes(source);
+  const bool cookable = use_cooked && role.has_value() && !is_ktx2(source);
+  const VkFormat format = cookable          ? cooked_texture_format(*role)
+                          : is_ktx2(source) ? VK_FORMAT_UNDEFINED
+                                            : VK_FORMAT_R8G8B8A8_UNORM;
+  decoded.cache_key = texture_cache_key(source_hash, format);
+  decoded.cached = engine->_texture_cache.acquire(decoded.cache_key);
+  if (decoded.cached.has_value()) {
+    return decoded;
+  }
+
+  if (cookable) {
+    MappedFile cooked_file;
+    if (cooked_file.open(cooked_texture_path(source_hash, *role))) {
+      decoded.compressed = read_ktx2(cooked_file.bytes());
+      if (decoded.compressed.has_value()) {
+        return decoded;
+      }
+    }
+
+    // without a cooked copy the source is decoded to rgba8, which is cached under its own key so a later load that
+    // finds the cooked copy doesn't get the rgba8 image for it
+    decoded.cache_key = texture_cache_key(source_hash, VK_FORMAT_R8G8B8A8_UNORM);
+    decoded.cached = engine->_texture_cache.acquire(decoded.cache_key);
+    if (decoded.cached.has_value()) {
+      return decoded;
+    }
+  }
+
+  decode_bytes(source, decoded);
+  return decoded;
+}
+
+// stages a decoded image for upload and frees the cpu side pixels
+std::optional<CachedTexture> load_image(VulkanEngine* engine, UploadBatch& uploads, DecodedImage& decoded) {
+  // block compressed chains go straight into an image of the same format, without any mip generation
+  if (decoded.compressed.has_value()) {
+    const Ktx2Image& ktx = *decoded.compressed;
+    if (!engine->_device_features.textureCompressionBC) {
+      fmt::println("device can't sample BC textures, skipping a KTX2 image");
+      return {};
+    }
+
+    // large chains start with only their tail levels, the streamer keeps the rest in system memory
+    if (engine->_texture_streaming && TextureStreamer::worth_streaming(ktx)) {
+      CachedTexture texture;
+      texture.stream = engine->_texture_streamer.add(std::move(*decoded.compressed), uploads);
+      texture.image = engine->_texture_streamer.image(texture.stream);
+      decoded.compressed.reset();
+      return texture;
+    }
+
+    VkExtent3D extent{ktx.width, ktx.height, 1};
+    AllocatedImage new_image = engine->create_compressed_image(uploads, ktx.data.data(), ktx.data.size(),
+                                                               ktx.level_offsets, extent, ktx.format,
+                                                               VK_IMAGE_USAGE_SAMPLED_BIT);
+    decoded.compressed.reset();
+    return CachedTexture{new_image};
+  }
+
+  // if decoding failed we dont have any pixels, so there is no image to create
+  if (decoded.pixels == nullptr) {
     return {};
+  }
+
+  VkExtent3D imagesize;
+  imagesize.width = decoded.width;
+  imagesize.height = decoded.height;
+  imagesize.depth = 1;
+
+  AllocatedImage newImage = engine->create_image(uploads, decoded.pixels, imagesize, VK_FORMAT_R8G8B8A8_UNORM,
+                                                 VK_IMAGE_USAGE_SAMPLED_BIT, MIPMAP_ENABLED);
+
+  stbi_image_free(decoded.pixels);
+  decoded.pixels = nullptr;
+
+  return CachedTexture{newImage};
+}
+
+// KHR_texture_basisu textures point at a KTX2 image and can keep a png or jpeg in the core source as a fallback
+// for loaders that can't use it
+static std::optional<size_t> texture_image(const fastgltf::Texture& texture, const std::vector<bool>& image_loaded) {
+  if (texture.basisuImageIndex.has_value() && image_loaded[*texture.basisuImageIndex]) {
+    return *texture.basisuImageIndex;
+  }
+  if (texture.imageIndex.has_value()) {
+    return *texture.imageIndex;
+  }
+  if (texture.basisuImageIndex.has_value()) {
+    return *texture.basisuImageIndex;
+  }
+  return {};
+}
+
+// KHR_mesh_quantization positions are already integers. quantizing them onto their own lattice keeps them exact
+// through the packed format, float positions are spread over the primitive's bounds instead
+static VertexQuantization position_quantization(const fastgltf::Accessor& accessor, const PositionBounds& bounds) {
+  float lowest;
+  float highest;
+  switch (accessor.componentType) {
+  case fastgltf::ComponentType::Byte:
+    lowest = -128.f;
+    highest = 127.f;
+    break;
+  case fastgltf::ComponentType::UnsignedByte:
+    lowest = 0.f;
+    highest = 255.f;
+    break;
+  case fastgltf::ComponentType::Short:
+    lowest = -32768.f;
+    highest = 32767.f;
+    break;
+  case fastgltf::ComponentType::UnsignedShort:
+    lowest = 0.f;
+    highest = 65535.f;
+    break;
+  default:
+    return quantization_for_bounds(bounds);
+  }
+
+  // normalized integers are divided by the largest positive value, so one source step is 1 / highest
+  const float step = accessor.normalized ? 1.f / highest : 1.f;
+  return {glm::vec3{lowest * step}, glm::vec3{65535.f * step}};
+}
+
+// totals over every primitive of a file, logged once it is loaded
+struct MeshOptimizeStats {
+  size_t source_vertices;
+  size_t optimized_vertices;
+  VertexCacheStats cache_before;
+  VertexCacheStats cache_after;
+  VertexFetchStats fetch_before;
+  VertexFetchStats fetch_after;
+};
+
+static void accumulate(VertexCacheStats& total, const VertexCacheStats& stats) {
+  total.vertices_transformed += stats.vertices_transformed;
+  total.triangles += stats.triangles;
+}
+
+static void accumulate(VertexFetchStats& total, const VertexFetchStats& stats) {
+  total.bytes_fetched += stats.bytes_fetched;
+  total.vertex_bytes += stats.vertex_bytes;
+}
+
+// simplifies a primitive into its lod chain. indices are local to vertices, the levels are appended to
+// lod_indices and their start indices are relative to it. returns the number of levels made
+static uint32_t build_lods(std::span<const uint32_t> indices, std::span<const Vertex> vertices, bool optimize,
+                           std::vector<uint32_t>& lod_indices, std::array<SurfaceLod, MAX_SURFACE_LODS>& lods) {
+  const float object_scale = simplify_scale(vertices);
+  std::vector<uint32_t> source(indices.begin(), indices.end());
+  std::vector<uint32_t> simplified;
+
+  uint32_t lod_count = 0;
+  float error = 0.f;
+  while (lod_count < MAX_SURFACE_LODS && source.size() / 3 >= LOD_MIN_TRIANGLES) {
+    simplified.resize(source.size());
+    float level_error = 0.f;
+    const size_t count = simplify_mesh(simplified, source, vertices, source.size() / 2, LOD_MAX_ERROR, &level_error);
+    if (count == 0 || count > source.size() * 3 / 4) {
+      break;
+    }
+    simplified.resize(count);
+    if (optimize) {
+      optimize_vertex_cache(simplified, vertices.size());
+    }
+
+    // every level is simplified from the one above, so the errors add up
+    error += level_error * object_scale;
+    lods[lod_count++] = {static_cast<uint32_t>(lod_indices.size()), static_cast<uint32_t>(count), error};
+    lod_indices.insert(lod_indices.end(), simplified.begin(), simplified.end());
+    std::swap(source, simplified);
+  }
+  return lod_count;
+}
+
+// size of a vertex as the gpu fetches it
+static size_t vertex_stride(VulkanEngine* engine) {
+  return engine->_vertex_format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+// uploads a mesh in the engine's vertex format. packed vertices are quantized surface by surface
+static std::optional<GeometryAllocation> upload_geometry(VulkanEngine* engine, UploadBatch& uploads,
+                                                         std::span<const CookedSurface> surfaces,
+                                                         std::span<const uint32_t> indices,
+                                                         std::span<const Vertex> vertices,
+                                                         std::span<const Meshlet> meshlets,
+                                                         std::vector<PackedVertex>& packed) {
+  if (engine->_vertex_format == VertexFormat::Full) {
+    return engine->upload_mesh(uploads, indices, vertices, meshlets);
+  }
+
+  packed.resize(vertices.size());
+  for (const CookedSurface& surface : surfaces) {
+    pack_vertices(std::span(packed).subspan(surface.first_vertex, surface.vertex_count),
+                  vertices.subspan(surface.first_vertex, surface.vertex_count), surface.quantization);
+  }
+  return engine->upload_mesh(uploads, indices, std::span<const PackedVertex>(packed), meshlets);
+}
+
+// a mesh the geometry pool had no room for keeps no surfaces, so it adds nothing to the render list instead of
+// drawing whatever sits at offset 0 of the pool
+static void place_geometry(MeshAsset& mesh, const std::optional<GeometryAllocation>& geometry) {
+  if (geometry.has_value()) {
+    mesh.geometry = *geometry;
   } else {
-    return newImage;
+    mesh.surfaces.clear();
   }
 }
 
-std::optional<std::shared_ptr<LoadedGLTF>> load_gltf_meshes(VulkanEngine* engine, std::filesystem::path filePath) {
+// fills file in on the calling thread. the node hierarchy is published first, then textures and materials, then
+// meshes in batches, each mesh becoming drawable once its batch and its materials' textures are resident
+static bool load_into(VulkanEngine* engine, LoadedGLTF& file, const std::filesystem::path& filePath) {
   std::cout << "Loading GLTF: " << filePath << std::endl;
-
-  std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
-  scene->creator = engine;
-  LoadedGLTF& file = *scene.get();
+  auto load_start = std::chrono::system_clock::now();
 
   static constexpr auto supported_extensions = fastgltf::Extensions::KHR_mesh_quantization |
                                                fastgltf::Extensions::KHR_texture_transform |
-                                               fastgltf::Extensions::KHR_materials_variants;
+                                               fastgltf::Extensions::KHR_texture_basisu |
+                                               fastgltf::Extensions::KHR_materials_variants |
+                                               fastgltf::Extensions::EXT_meshopt_compression;
 
   fastgltf::Parser parser(supported_extensions);
 
+  // buffers are left where they are, MappedGltf maps them instead of fastgltf reading them into arrays
   constexpr auto gltf_options = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble |
-                                fastgltf::Options::LoadGLBBuffers | fastgltf::Options::LoadExternalBuffers |
                                 fastgltf::Options::LoadExternalImages | fastgltf::Options::GenerateMeshIndices;
-  fastgltf::GltfDataBuffer data;
-  data.loadFromFile(filePath);
-
-  fastgltf::Asset gltf;
-
-  std::filesystem::path path = filePath;
+  const size_t rss_before = peak_rss_bytes();
 
-  auto load = parser.loadGltf(&data, path.parent_path(), gltf_options);
-  if (load) {
-    gltf = std::move(load.get());
-  } else {
-    std::cerr << "Failed to load glTF: " << fastgltf::to_underlying(load.error()) << std::endl;
-    return {};
+  MappedGltf source;
+  fastgltf::Error error = source.load(parser, filePath, gltf_options);
+  if (error != fastgltf::Error::None) {
+    std::cerr << "Failed to load glTF: " << fastgltf::to_underlying(error) << std::endl;
+    return false;
+  }
+  fastgltf::Asset& gltf = source.asset();
+  const MappedGltf::BufferAdapter buffers = source.adapter();
+
+  // compressed views have to be decoded before any accessor reads them
+  MeshoptDecodeStats meshopt_stats;
+  if (!source.decode_compressed_views(engine->_thread_pool, meshopt_stats)) {
+    std::cerr << "Failed to decode EXT_meshopt_compression buffer views in " << filePath << std::endl;
+    return false;
   }
-  std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3},
-                                                                   {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 3},
-                                                                   {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}};
+
+  // cooked mesh data is keyed on the exact bytes of the source file and its external buffers
+  const uint64_t source_hash = source.source_hash();
+  // material sets only hold textures, the constants live in material_data_buffer
+  std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2}};
   file.descriptor_pool.init(engine->_device, gltf.materials.size(), sizes);
 
   for (auto& gltf_sampler : gltf.samplers) {
@@ -204,42 +438,178 @@ std::optional<std::shared_ptr<LoadedGLTF>> load_gltf_meshes(VulkanEngine* engine
     sampler_ci.minFilter = extract_filter(gltf_sampler.minFilter.value_or(fastgltf::Filter::Nearest));
     sampler_ci.mipmapMode = extract_mipmap_mode(gltf_sampler.minFilter.value_or(fastgltf::Filter::Nearest));
 
-    VkSampler new_sampler;
-    vkCreateSampler(engine->_device, &sampler_ci, nullptr, &new_sampler);
-
-    file.samplers.push_back(new_sampler);
+    file.samplers.push_back(engine->_object_cache.sampler(sampler_ci));
   }
 
   std::vector<std::shared_ptr<MeshAsset>> meshes;
   std::vector<std::shared_ptr<Node>> nodes;
   std::vector<AllocatedImage> images;
+  std::vector<uint32_t> image_streams;
+  std::vector<uint64_t> image_tickets;
+  std::vector<bool> image_loaded;
   std::vector<std::shared_ptr<GLTFMaterial>> materials;
 
-  for (fastgltf::Image& image : gltf.images) {
-    std::optional<AllocatedImage> img = load_image(engine, gltf, image);
+  // meshes start out empty so the hierarchy can be drawn before any of them is uploaded
+  for (fastgltf::Mesh& mesh : gltf.meshes) {
+    std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
+    newmesh->name = mesh.name;
+    meshes.push_back(newmesh);
+    file.meshes[mesh.name.c_str()] = newmesh;
+  }
+
+  // load all nodes and their meshes. their matrices go into the file's flat transform store once the parents are
+  // known
+  std::vector<glm::mat4> local_transforms;
+  std::vector<uint32_t> parent_indices(gltf.nodes.size(), TransformHierarchy::NO_PARENT);
+  local_transforms.reserve(gltf.nodes.size());
+  for (fastgltf::Node& node : gltf.nodes) {
+    std::shared_ptr<Node> newNode;
+
+    // find if the node has a mesh, and if it does hook it to the mesh pointer and allocate it with the meshnode class
+    if (node.meshIndex.has_value()) {
+      newNode = std::make_shared<MeshNode>();
+      static_cast<MeshNode*>(newNode.get())->mesh = meshes[*node.meshIndex];
+    } else {
+      newNode = std::make_shared<Node>();
+    }
+
+    nodes.push_back(newNode);
+    file.nodes[node.name.c_str()] = newNode;
+
+    glm::mat4 local_transform;
+    std::visit(fastgltf::visitor{[&](fastgltf::Node::TransformMatrix matrix) {
+                                   local_transform = glm::make_mat4x4(matrix.data());
+                                 },
+                                 [&](fastgltf::TRS transform) {
+                                   glm::vec3 tl = glm::make_vec3(transform.translation.data());
+                                   glm::quat rot(transform.rotation[3], transform.rotation[0], transform.rotation[1],
+                                                 transform.rotation[2]);
+                                   glm::vec3 sc = glm::make_vec3(transform.scale.data());
+
+                                   glm::mat4 tm = glm::translate(glm::mat4(1.f), tl);
+                                   glm::mat4 rm = glm::toMat4(rot);
+                                   glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
+
+                                   local_transform = tm * rm * sm;
+                                 }},
+               node.transform);
+    local_transforms.push_back(local_transform);
 
+    // local_transform[1][1] *= -1;
+    // local_transform = glm::rotate(local_transform, glm::radians(-90.f), glm::vec3{1, 0, 0});
+  }
+
+  // run loop again to setup transform hierarchy
+  for (int i = 0; i < gltf.nodes.size(); i++) {
+    fastgltf::Node& node = gltf.nodes[i];
+    std::shared_ptr<Node>& sceneNode = nodes[i];
+
+    for (auto& c : node.children) {
+      sceneNode->children.push_back(nodes[c]);
+      nodes[c]->parent = sceneNode;
+      parent_indices[c] = static_cast<uint32_t>(i);
+    }
+  }
+
+  // find the top nodes, with no parents
+  for (auto& node : nodes) {
+    if (node->parent.lock() == nullptr) {
+      file.top_nodes.push_back(node);
+    }
+  }
+
+  const std::vector<uint32_t> transform_indices = file.transforms.build(parent_indices, local_transforms);
+  for (size_t i = 0; i < nodes.size(); i++) {
+    nodes[i]->transforms = &file.transforms;
+    nodes[i]->transform = transform_indices[i];
+    if (MeshNode* mesh_node = dynamic_cast<MeshNode*>(nodes[i].get())) {
+      file.mesh_nodes.push_back(mesh_node);
+    }
+  }
+  std::sort(file.mesh_nodes.begin(), file.mesh_nodes.end(),
+            [](const MeshNode* a, const MeshNode* b) { return a->transform < b->transform; });
+  file.pending_nodes = file.mesh_nodes;
+  file.transforms.update();
+
+  // the frame loop lists the mesh nodes from here on, and the loader only touches the meshes' contents after this
+  file.hierarchy_ready.store(true, std::memory_order_release);
+
+  // decode every image on the worker pool at once. images are staged in order on this thread
+  // as each decode finishes, so they keep their gltf index in the images vector
+  std::vector<std::future<DecodedImage>> decode_jobs;
+  decode_jobs.reserve(gltf.images.size());
+  const std::vector<std::optional<TextureRole>> image_role = image_roles(gltf);
+  const bool use_cooked = engine->_device_features.textureCompressionBC;
+  for (size_t i = 0; i < gltf.images.size(); i++) {
+    fastgltf::Image& image = gltf.images[i];
+    std::optional<TextureRole> role = image_role[i];
+    decode_jobs.push_back(engine->_thread_pool.submit([engine, &source, &image, role, use_cooked]() {
+      return decode_image(engine, source, image, role, use_cooked);
+    }));
+  }
+
+  size_t shared_images = 0;
+  size_t staged_bytes = 0;
+  for (size_t i = 0; i < gltf.images.size(); i++) {
+    fastgltf::Image& image = gltf.images[i];
+    DecodedImage decoded = decode_jobs[i].get();
+
+    // the same bytes can show up twice in one file, so a miss on the worker can still hit here
+    // each texture is submitted on its own, so its ticket is known before any other scene can find it cached
+    std::optional<CachedTexture> img = decoded.cached;
+    bool created = false;
+    if (!img.has_value() && decoded.cache_key != 0) {
+      img = engine->_texture_cache.acquire(decoded.cache_key, [&]() {
+        created = true;
+        UploadBatch image_upload{engine};
+        std::optional<CachedTexture> texture = load_image(engine, image_upload, decoded);
+        if (texture.has_value()) {
+          staged_bytes += image_upload.staged_bytes();
+          texture->ticket = engine->_async_uploader.submit(std::move(image_upload));
+        }
+        return texture;
+      });
+    }
+    if (img.has_value() && !created) {
+      shared_images++;
+    }
+    if (decoded.pixels != nullptr) {
+      stbi_image_free(decoded.pixels);
+    }
+
+    image_loaded.push_back(img.has_value());
     if (img.has_value()) {
-      images.push_back(*img);
-      file.images[image.name.c_str()] = *img;
+      file.texture_keys.push_back(decoded.cache_key);
+      images.push_back(img->image);
+      image_streams.push_back(img->stream);
+      image_tickets.push_back(img->ticket);
+      file.images[image.name.c_str()] = img->image;
     } else {
       // we failed to load, so lets give the slot a default white texture to not
       // completely break loading
       images.push_back(engine->_error_checkerboard_image);
+      image_streams.push_back(NO_STREAMED_TEXTURE);
+      image_tickets.push_back(0);
       std::cout << "gltf failed to load texture " << image.name << std::endl;
     }
   }
 
-  file.material_data_buffer =
-      engine->create_buffer(sizeof(GLTFMettallicRoughness::MaterialConstants) * gltf.materials.size(),
-                            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+  // one packed record per material, indexed by the material's data_index
+  file.material_data_buffer = engine->create_buffer(
+      sizeof(GLTFMettallicRoughness::MaterialConstants) * gltf.materials.size(),
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+  const VkDeviceAddress material_data_address = engine->buffer_address(file.material_data_buffer.buffer);
 
   uint32_t data_index{0};
   GLTFMettallicRoughness::MaterialConstants* scene_material_constants =
       (GLTFMettallicRoughness::MaterialConstants*)file.material_data_buffer.info.pMappedData;
 
+  std::vector<std::pair<uint32_t, std::function<void(const AllocatedImage&)>>> streamed_materials;
+
   // we have an asset now with materials. loop over the materials and load their properties into materials vector
   for (fastgltf::Material& mat : gltf.materials) {
     std::shared_ptr<GLTFMaterial> new_mat = std::make_shared<GLTFMaterial>();
+    new_mat->double_sided = mat.doubleSided;
     materials.push_back(new_mat);
     file.materials[mat.name.c_str()] = new_mat;
 
@@ -265,96 +635,239 @@ std::optional<std::shared_ptr<LoadedGLTF>> load_gltf_meshes(VulkanEngine* engine
     material_resources.color_sampler = engine->_default_sampler_linear;
     material_resources.metal_rough_image = engine->_white_image;
     material_resources.metal_rough_sampler = engine->_default_sampler_linear;
-    material_resources.data_buffer = file.material_data_buffer.buffer;
-    material_resources.data_buffer_offset = data_index * sizeof(GLTFMettallicRoughness::MaterialConstants);
+    material_resources.data_address = material_data_address;
+    material_resources.data_index = data_index;
 
     // grab gltf textures
+    uint32_t color_stream = NO_STREAMED_TEXTURE;
     if (mat.pbrData.baseColorTexture.has_value()) {
-      size_t img = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].imageIndex.value();
-      size_t sampler = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].samplerIndex.value();
-
-      material_resources.color_image = images[img];
+      const fastgltf::Texture& texture = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex];
+      std::optional<size_t> img = texture_image(texture, image_loaded);
+      size_t sampler = texture.samplerIndex.value();
+
+      if (img.has_value()) {
+        material_resources.color_image = images[*img];
+        color_stream = image_streams[*img];
+        new_mat->upload_ticket = image_tickets[*img];
+      }
       material_resources.color_sampler = file.samplers[sampler];
     }
 
     new_mat->data = engine->metal_rough_material.write_material(engine->_device, pass_type, material_resources,
-                                                                file.descriptor_pool);
+                                                                file.descriptor_pool, &file.texture_sets);
+    new_mat->data.streamed_texture = color_stream;
+
+    // a streamed color texture gets a new image with every level change. frames in flight still use the old set,
+    // so the material moves to another set for the new image and the old one is retired until those frames are
+    // done. the old view is about to be destroyed and its handle may come back, so no other material may find its
+    // set
+    if (color_stream != NO_STREAMED_TEXTURE) {
+      GLTFMaterial* material = new_mat.get();
+      streamed_materials.emplace_back(color_stream, [=, &file](const AllocatedImage& image) mutable {
+        const int frame = engine->_frame_number;
+        std::erase_if(file.retired_texture_sets, [&](const std::pair<VkDescriptorSet, int>& retired) {
+          if (retired.second + int(FRAME_OVERLAP) > frame) {
+            return false;
+          }
+          file.free_texture_sets.push_back(retired.first);
+          return true;
+        });
+
+        const VkImageView old_view = material_resources.color_image.image_view;
+        std::erase_if(file.texture_sets, [&](const auto& entry) {
+          if (std::get<0>(entry.first) != old_view) {
+            return false;
+          }
+          file.retired_texture_sets.emplace_back(entry.second, frame);
+          return true;
+        });
+        material_resources.color_image = image;
+        material->data =
+            engine->metal_rough_material.write_material(engine->_device, pass_type, material_resources,
+                                                        file.descriptor_pool, &file.texture_sets,
+                                                        &file.free_texture_sets);
+        material->data.streamed_texture = color_stream;
+      });
+    }
 
     data_index++;
   }
 
+  // level changes call back on the frame loop, which may only allocate from the pool once this thread is done
+  // with it
+  for (auto& [stream, on_change] : streamed_materials) {
+    engine->_texture_streamer.watch(stream, &file, std::move(on_change));
+  }
+
+  // on a cache hit the vertex and index arrays come straight out of the mapped cache file and no accessor is read.
+  // the json is still parsed since materials, images and nodes aren't cooked. optimized and unoptimized meshes are
+  // cooked into separate entries
+  const uint64_t cache_key = hash_combine(source_hash, engine->_optimize_meshes ? 1 : 0);
+  std::filesystem::path cache_path = mesh_cache_path(cache_key);
+  MeshCacheReader mesh_cache;
+  MeshCacheWriter mesh_cache_writer;
+  const bool cache_hit = mesh_cache.open(cache_path, cache_key) && mesh_cache.meshes().size() == gltf.meshes.size();
+  if (!cache_hit) {
+    mesh_cache_writer.open(cache_path, cache_key);
+  }
+
   std::vector<uint32_t> indices;
   std::vector<Vertex> vertices;
+  std::vector<CookedSurface> cooked_surfaces;
+
+  // attribute streams reused across primitives
+  std::vector<glm::vec3> position_stream;
+  std::vector<glm::vec3> normal_stream;
+  std::vector<glm::vec2> uv_stream;
+  std::vector<glm::vec4> color_stream;
+  std::vector<PackedVertex> packed_vertices;
+  MeshOptimizeStats mesh_stats{};
+  std::vector<uint32_t> lod_indices;
+  std::vector<Meshlet> meshlets;
+
+  // meshes go out in batches of about PROGRESSIVE_BATCH_BYTES, so the first ones show up while the rest load.
+  // a mesh can be drawn once its batch and the textures of its materials are resident
+  std::optional<UploadBatch> uploads;
+  uploads.emplace(engine);
+  std::vector<MeshAsset*> batch_meshes;
+  auto submit_batch = [&]() {
+    staged_bytes += uploads->staged_bytes();
+    const uint64_t ticket = engine->_async_uploader.submit(std::move(*uploads));
+    uploads.emplace(engine);
+    for (MeshAsset* mesh : batch_meshes) {
+      uint64_t ready = ticket;
+      for (const GeoSurface& surface : mesh->surfaces) {
+        ready = std::max(ready, surface.material->upload_ticket);
+      }
+      mesh->upload_ticket.store(ready, std::memory_order_release);
+    }
+    batch_meshes.clear();
+  };
 
-  for (fastgltf::Mesh& mesh : gltf.meshes) {
-    std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
-    meshes.push_back(newmesh);
-    file.meshes[mesh.name.c_str()] = newmesh;
-    newmesh->name = mesh.name;
+  for (size_t mesh_index = 0; mesh_index < gltf.meshes.size(); mesh_index++) {
+    if (file.load_cancelled.load(std::memory_order_relaxed)) {
+      break;
+    }
+    if (uploads->staged_bytes() >= PROGRESSIVE_BATCH_BYTES) {
+      submit_batch();
+    }
+
+    fastgltf::Mesh& mesh = gltf.meshes[mesh_index];
+    std::shared_ptr<MeshAsset> newmesh = meshes[mesh_index];
+
+    if (cache_hit) {
+      const CookedMesh& cooked = mesh_cache.meshes()[mesh_index];
+      for (const CookedSurface& cooked_surface : cooked.surfaces) {
+        GeoSurface newSurface;
+        newSurface.startIndex = cooked_surface.start_index;
+        newSurface.count = cooked_surface.count;
+        newSurface.bounds = cooked_surface.bounds;
+        newSurface.quantization = cooked_surface.quantization;
+        newSurface.lods = cooked_surface.lods;
+        newSurface.lod_count = cooked_surface.lod_count;
+        newSurface.first_meshlet = cooked_surface.first_meshlet;
+        newSurface.meshlet_count = cooked_surface.meshlet_count;
+        newSurface.material = materials[cooked_surface.material_index >= 0 ? cooked_surface.material_index : 0];
+        newmesh->surfaces.push_back(newSurface);
+      }
+
+      std::optional<GeometryAllocation> geometry =
+          upload_geometry(engine, *uploads, cooked.surfaces, cooked.indices, cooked.vertices, cooked.meshlets,
+                          packed_vertices);
+      place_geometry(*newmesh, geometry);
+      batch_meshes.push_back(newmesh.get());
+      continue;
+    }
 
     // clear the mesh arrays each mesh, we dont want to merge them by error
     indices.clear();
     vertices.clear();
+    meshlets.clear();
+    cooked_surfaces.clear();
 
     for (auto&& p : mesh.primitives) {
       GeoSurface newSurface;
       newSurface.startIndex = (uint32_t)indices.size();
       newSurface.count = (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
 
-      size_t initial_vtx = vertices.size();
+      const size_t initial_vtx = vertices.size();
 
-      // load indexes
-      {
-        fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
-        indices.reserve(indices.size() + indexaccessor.count);
+      // load indexes, they stay local to the primitive until its vertices are final
+      fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
+      indices.resize(indices.size() + indexaccessor.count);
+      std::span<uint32_t> primitive_indices = std::span(indices).subspan(newSurface.startIndex);
+      fastgltf::copyFromAccessor<std::uint32_t>(gltf, indexaccessor, primitive_indices.data(), buffers);
 
-        fastgltf::iterateAccessor<std::uint32_t>(gltf, indexaccessor,
-                                                 [&](std::uint32_t idx) { indices.push_back(idx + initial_vtx); });
-      }
+      // each attribute is copied out of its accessor as one tightly packed stream, then interleaved
+      fastgltf::Accessor& posAccessor = gltf.accessors[p.findAttribute("POSITION")->second];
+      vertices.resize(vertices.size() + posAccessor.count);
+      std::span<Vertex> primitive_vertices = std::span(vertices).subspan(initial_vtx);
 
-      // load vertex positions
-      {
-        fastgltf::Accessor& posAccessor = gltf.accessors[p.findAttribute("POSITION")->second];
-        vertices.resize(vertices.size() + posAccessor.count);
-
-        fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor, [&](glm::vec3 v, size_t index) {
-          Vertex newvtx;
-          newvtx.position = v;
-          newvtx.normal = {1, 0, 0};
-          newvtx.color = glm::vec4{1.f};
-          newvtx.uv_x = 0;
-          newvtx.uv_y = 0;
-          vertices[initial_vtx + index] = newvtx;
-        });
-      }
+      // load vertex positions, which also resets the other attributes and gives the primitive's bounds
+      position_stream.resize(posAccessor.count);
+      fastgltf::copyFromAccessor<glm::vec3>(gltf, posAccessor, position_stream.data(), buffers);
+      PositionBounds pos_bounds = write_positions(primitive_vertices, position_stream);
 
       // load vertex normals
       auto normals = p.findAttribute("NORMAL");
       if (normals != p.attributes.end()) {
-
-        fastgltf::iterateAccessorWithIndex<glm::vec3>(
-            gltf, gltf.accessors[(*normals).second],
-            [&](glm::vec3 v, size_t index) { vertices[initial_vtx + index].normal = v; });
+        normal_stream.resize(posAccessor.count);
+        fastgltf::copyFromAccessor<glm::vec3>(gltf, gltf.accessors[(*normals).second], normal_stream.data(),
+                                              buffers);
+        write_normals(primitive_vertices, normal_stream);
       }
 
       // load UVs
       auto uv = p.findAttribute("TEXCOORD_0");
       if (uv != p.attributes.end()) {
-
-        fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[(*uv).second],
-                                                      [&](glm::vec2 v, size_t index) {
-                                                        vertices[initial_vtx + index].uv_x = v.x;
-                                                        vertices[initial_vtx + index].uv_y = v.y;
-                                                      });
+        uv_stream.resize(posAccessor.count);
+        fastgltf::copyFromAccessor<glm::vec2>(gltf, gltf.accessors[(*uv).second], uv_stream.data(), buffers);
+        write_uvs(primitive_vertices, uv_stream);
       }
 
       // load vertex colors
       auto colors = p.findAttribute("COLOR_0");
       if (colors != p.attributes.end()) {
+        color_stream.resize(posAccessor.count);
+        fastgltf::copyFromAccessor<glm::vec4>(gltf, gltf.accessors[(*colors).second], color_stream.data(),
+                                              buffers);
+        write_colors(primitive_vertices, color_stream);
+      }
+
+      if (engine->_optimize_meshes) {
+        const size_t source_vertex_count = primitive_vertices.size();
+        mesh_stats.source_vertices += source_vertex_count;
+        accumulate(mesh_stats.cache_before, analyze_vertex_cache(primitive_indices, source_vertex_count));
+        accumulate(mesh_stats.fetch_before,
+                   analyze_vertex_fetch(primitive_indices, source_vertex_count, vertex_stride(engine)));
+
+        const size_t vertex_count = optimize_mesh(primitive_indices, primitive_vertices);
+        vertices.resize(initial_vtx + vertex_count);
+        primitive_vertices = primitive_vertices.first(vertex_count);
+
+        mesh_stats.optimized_vertices += vertex_count;
+        accumulate(mesh_stats.cache_after, analyze_vertex_cache(primitive_indices, vertex_count));
+        accumulate(mesh_stats.fetch_after,
+                   analyze_vertex_fetch(primitive_indices, vertex_count, vertex_stride(engine)));
+      }
 
-        fastgltf::iterateAccessorWithIndex<glm::vec4>(
-            gltf, gltf.accessors[(*colors).second],
-            [&](glm::vec4 v, size_t index) { vertices[initial_vtx + index].color = v; });
+      // built in the final triangle order, so every meshlet's triangles are also close in the vertex cache
+      std::vector<Meshlet> surface_meshlets = build_meshlets(primitive_indices, primitive_vertices);
+      newSurface.first_meshlet = static_cast<uint32_t>(meshlets.size());
+      newSurface.meshlet_count = static_cast<uint32_t>(surface_meshlets.size());
+      meshlets.insert(meshlets.end(), surface_meshlets.begin(), surface_meshlets.end());
+
+      lod_indices.clear();
+      newSurface.lod_count =
+          build_lods(primitive_indices, primitive_vertices, engine->_optimize_meshes, lod_indices, newSurface.lods);
+      offset_indices(primitive_indices, static_cast<uint32_t>(initial_vtx));
+
+      // the lod levels go right after the primitive's full detail indices
+      const uint32_t lod_base = static_cast<uint32_t>(indices.size());
+      offset_indices(lod_indices, static_cast<uint32_t>(initial_vtx));
+      indices.insert(indices.end(), lod_indices.begin(), lod_indices.end());
+      for (uint32_t level = 0; level < newSurface.lod_count; level++) {
+        newSurface.lods[level].start_index += lod_base;
       }
 
       if (p.materialIndex.has_value()) {
@@ -363,75 +876,92 @@ std::optional<std::shared_ptr<LoadedGLTF>> load_gltf_meshes(VulkanEngine* engine
         newSurface.material = materials[0];
       }
 
-      glm::vec3 min_pos = vertices[initial_vtx].position;
-      glm::vec3 max_pos = vertices[initial_vtx].position;
-      for (auto& vert : vertices) {
-        min_pos = glm::min(min_pos, vert.position);
-        max_pos = glm::max(max_pos, vert.position);
-      }
-      newSurface.bounds.origin = (max_pos + min_pos) / 2.f;
+      newSurface.bounds.origin = (pos_bounds.max + pos_bounds.min) / 2.f;
       // box size
-      newSurface.bounds.extents = (max_pos - min_pos) / 2.f;
+      newSurface.bounds.extents = (pos_bounds.max - pos_bounds.min) / 2.f;
       newSurface.bounds.sphere_radius = glm::length(newSurface.bounds.extents);
+      newSurface.quantization = position_quantization(posAccessor, pos_bounds);
       newmesh->surfaces.push_back(newSurface);
-    }
-
-    newmesh->meshBuffers = engine->upload_mesh(indices, vertices);
-  }
 
-  // load all nodes and their meshes
-  for (fastgltf::Node& node : gltf.nodes) {
-    std::shared_ptr<Node> newNode;
-
-    // find if the node has a mesh, and if it does hook it to the mesh pointer and allocate it with the meshnode class
-    if (node.meshIndex.has_value()) {
-      newNode = std::make_shared<MeshNode>();
-      static_cast<MeshNode*>(newNode.get())->mesh = meshes[*node.meshIndex];
-    } else {
-      newNode = std::make_shared<Node>();
+      CookedSurface cooked_surface{};
+      cooked_surface.start_index = newSurface.startIndex;
+      cooked_surface.count = newSurface.count;
+      cooked_surface.first_vertex = static_cast<uint32_t>(initial_vtx);
+      cooked_surface.vertex_count = static_cast<uint32_t>(primitive_vertices.size());
+      cooked_surface.material_index = p.materialIndex.has_value() ? static_cast<int32_t>(*p.materialIndex) : -1;
+      cooked_surface.bounds = newSurface.bounds;
+      cooked_surface.quantization = newSurface.quantization;
+      cooked_surface.lods = newSurface.lods;
+      cooked_surface.lod_count = newSurface.lod_count;
+      cooked_surface.first_meshlet = newSurface.first_meshlet;
+      cooked_surface.meshlet_count = newSurface.meshlet_count;
+      cooked_surfaces.push_back(cooked_surface);
     }
 
-    nodes.push_back(newNode);
-    file.nodes[node.name.c_str()];
+    mesh_cache_writer.add_mesh(mesh.name.c_str(), cooked_surfaces, vertices, indices, meshlets);
+    std::optional<GeometryAllocation> geometry =
+        upload_geometry(engine, *uploads, cooked_surfaces, indices, vertices, meshlets, packed_vertices);
+    place_geometry(*newmesh, geometry);
+    batch_meshes.push_back(newmesh.get());
+  }
 
-    std::visit(fastgltf::visitor{[&](fastgltf::Node::TransformMatrix matrix) {
-                                   newNode->local_transform = glm::make_mat4x4(matrix.data());
-                                 },
-                                 [&](fastgltf::TRS transform) {
-                                   glm::vec3 tl = glm::make_vec3(transform.translation.data());
-                                   glm::quat rot(transform.rotation[3], transform.rotation[0], transform.rotation[1],
-                                                 transform.rotation[2]);
-                                   glm::vec3 sc = glm::make_vec3(transform.scale.data());
+  // a cancelled load leaves a partial scene that is about to be destroyed, and nothing should be cooked from it
+  if (file.load_cancelled.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  if (!batch_meshes.empty()) {
+    submit_batch();
+  }
 
-                                   glm::mat4 tm = glm::translate(glm::mat4(1.f), tl);
-                                   glm::mat4 rm = glm::toMat4(rot);
-                                   glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
+  if (!cache_hit && !mesh_cache_writer.finish()) {
+    fmt::println("failed to write mesh cache {}", cache_path.string());
+  }
 
-                                   newNode->local_transform = tm * rm * sm;
-                                 }},
-               node.transform);
+  if (!cache_hit && engine->_optimize_meshes) {
+    fmt::println("optimized meshes: {} -> {} vertices, acmr {:.3f} -> {:.3f}, overfetch {:.3f} -> {:.3f}",
+                 mesh_stats.source_vertices, mesh_stats.optimized_vertices, mesh_stats.cache_before.acmr(),
+                 mesh_stats.cache_after.acmr(), mesh_stats.fetch_before.overfetch(),
+                 mesh_stats.fetch_after.overfetch());
+  }
 
-    // newNode->local_transform[1][1] *= -1;
-    // newNode->local_transform = glm::rotate(newNode->local_transform, glm::radians(-90.f), glm::vec3{1, 0, 0});
+  auto load_end = std::chrono::system_clock::now();
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(load_end - load_start);
+  fmt::println("loaded {} meshes ({}) and {} images ({} shared, {} MB staged) in {} ms, gpu uploads pending",
+               meshes.size(), cache_hit ? "cooked" : "parsed", images.size(), shared_images,
+               staged_bytes / (1024 * 1024), elapsed.count() / 1000.f);
+  if (meshopt_stats.view_count > 0) {
+    fmt::println("decoded {} meshopt views, {} MB -> {} MB in {} ms ({:.1f} MB/s)", meshopt_stats.view_count,
+                 meshopt_stats.compressed_bytes / (1024 * 1024), meshopt_stats.decoded_bytes / (1024 * 1024),
+                 meshopt_stats.decode_ms, meshopt_stats.megabytes_per_second());
   }
+  // mapped pages of the source count toward rss as they are read, but the kernel can drop them again
+  const size_t rss_after = peak_rss_bytes();
+  fmt::println("peak rss {} MB, {} MB above the peak before loading", rss_after / (1024 * 1024),
+               (rss_after - rss_before) / (1024 * 1024));
 
-  // run loop again to setup transform hierarchy
-  for (int i = 0; i < gltf.nodes.size(); i++) {
-    fastgltf::Node& node = gltf.nodes[i];
-    std::shared_ptr<Node>& sceneNode = nodes[i];
+  return true;
+}
 
-    for (auto& c : node.children) {
-      sceneNode->children.push_back(nodes[c]);
-      nodes[c]->parent = sceneNode;
-    }
+std::optional<std::shared_ptr<LoadedGLTF>> load_gltf_meshes(VulkanEngine* engine, std::filesystem::path filePath) {
+  std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
+  scene->creator = engine;
+  if (!load_into(engine, *scene, filePath)) {
+    return {};
   }
+  scene->state.store(LoadState::loaded, std::memory_order_release);
+  return scene;
+}
 
-  // find the top nodes, with no parents
-  for (auto& node : nodes) {
-    if (node->parent.lock() == nullptr) {
-      file.top_nodes.push_back(node);
-      node->refresh_transform(glm::mat4{1.f});
-    }
-  }
+std::shared_ptr<LoadedGLTF> load_gltf_async(VulkanEngine* engine, std::filesystem::path filePath) {
+  std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
+  scene->creator = engine;
+
+  // a dedicated thread, since the load itself waits on jobs it queues on the engine's pool. the scene joins it
+  // before it is destroyed, so the raw pointer stays valid
+  LoadedGLTF* file = scene.get();
+  scene->loader = std::async(std::launch::async, [engine, file, filePath]() {
+    const bool loaded = load_into(engine, *file, filePath);
+    file->state.store(loaded ? LoadState::loaded : LoadState::failed, std::memory_order_release);
+  });
   return scene;
 }
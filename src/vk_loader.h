@@ -1,11 +1,19 @@
 #pragma once
 
 #include "vk_descriptors.h"
+#include <array>
+#include <atomic>
 #include <filesystem>
+#include <future>
+#include <vk_geometry_pool.h>
 #include <vk_types.h>
 
 struct GLTFMaterial {
   MaterialInstance data;
+  // both faces are visible, so the surface's meshlets can't be culled by their normal cones
+  bool double_sided;
+  // async upload holding the material's textures
+  uint64_t upload_ticket{0};
 };
 
 struct Bounds {
@@ -14,46 +22,109 @@ struct Bounds {
   glm::vec3 extents;
 };
 
+// simplified index range over the same vertices as its surface
+struct SurfaceLod {
+  uint32_t start_index;
+  uint32_t count;
+  // object space distance the level can deviate from full detail
+  float error;
+};
+
+// levels generated below full detail for every surface
+constexpr uint32_t MAX_SURFACE_LODS = 4;
+
 struct GeoSurface {
   uint32_t startIndex;
   uint32_t count;
   Bounds bounds;
+  // only used with VertexFormat::Packed
+  VertexQuantization quantization;
+  // coarser levels, each one simpler than the last. startIndex and count stay the full detail level
+  std::array<SurfaceLod, MAX_SURFACE_LODS> lods;
+  uint32_t lod_count;
+  // meshlets of the full detail level, relative to geometry.first_meshlet. their index ranges are relative
+  // to startIndex
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
   std::shared_ptr<GLTFMaterial> material;
 };
 
 struct MeshAsset {
   std::string name;
+  // surface index ranges are relative to geometry.first_index
   std::vector<GeoSurface> surfaces;
-  GPUMeshBuffers meshBuffers;
+  GeometryAllocation geometry{};
+  // async upload after which the geometry and the textures of every surface are resident. surfaces and geometry
+  // are only read once this is resident, since a background load fills them in while the scene is drawn
+  std::atomic<uint64_t> upload_ticket{UINT64_MAX};
+};
+
+enum class LoadState : uint8_t {
+  loading,
+  loaded,
+  failed,
 };
 
 // forward declaration
 class VulkanEngine;
+struct MeshNode;
 
 struct LoadedGLTF : public IRenderable {
 public:
   std::unordered_map<std::string, std::shared_ptr<MeshAsset>> meshes;
   std::unordered_map<std::string, std::shared_ptr<Node>> nodes;
+  // images by name. they belong to the engine's texture cache, the file only holds the references below
   std::unordered_map<std::string, AllocatedImage> images;
   std::unordered_map<std::string, std::shared_ptr<GLTFMaterial>> materials;
 
   // nodes that don't have a parent
   std::vector<std::shared_ptr<Node>> top_nodes;
-
+  // every node's local and world matrix. nodes hold their index in it
+  TransformHierarchy transforms;
+  // nodes with a mesh, in the order of their transforms. owned through nodes and top_nodes
+  std::vector<MeshNode*> mesh_nodes;
+  // mesh nodes whose surfaces aren't in the render list yet, because their mesh isn't resident
+  std::vector<MeshNode*> pending_nodes;
+
+  // shared through the engine's object cache, never destroyed by the file
   std::vector<VkSampler> samplers;
+  // texture cache entries this file took a reference to, released in clear_all
+  std::vector<uint64_t> texture_keys;
 
   DescriptorAllocatorGrowable descriptor_pool;
+  // materials with the same textures share one set from descriptor_pool
+  MaterialTextureSets texture_sets;
+  // sets dropped from texture_sets by a streamed texture's level change, with the frame it happened in. once the
+  // frames that might still bind them have retired they move to free_texture_sets and are written again
+  std::vector<std::pair<VkDescriptorSet, int>> retired_texture_sets;
+  std::vector<VkDescriptorSet> free_texture_sets;
 
   AllocatedBuffer material_data_buffer;
 
   VulkanEngine* creator;
 
-  ~LoadedGLTF() { clear_all(); }
+  // a background load owns the file until it finishes. the hierarchy can be drawn once hierarchy_ready is set,
+  // and each mesh once its own upload is resident
+  std::future<void> loader;
+  std::atomic<LoadState> state{LoadState::loading};
+  std::atomic<bool> hierarchy_ready{false};
+  std::atomic<bool> load_cancelled{false};
+
+  ~LoadedGLTF() {
+    cancel_load();
+    clear_all();
+  }
 
-  void Draw(const glm::mat4& top_matrix, DrawContext& ctx) override;
+  // adds the surfaces of meshes that became resident and moves the objects of nodes whose transform changed.
+  // objects point at their materials, so material edits show up without touching the list
+  void update_render_list(RenderList& list, const DrawContext& ctx) override;
+  // stops a background load between meshes and waits for it
+  void cancel_load();
 
 private:
   void clear_all();
 };
 
 std::optional<std::shared_ptr<LoadedGLTF>> load_gltf_meshes(VulkanEngine* engine, std::filesystem::path filePath);
+// returns right away with an empty scene that fills in from a loader thread
+std::shared_ptr<LoadedGLTF> load_gltf_async(VulkanEngine* engine, std::filesystem::path filePath);
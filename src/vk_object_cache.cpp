@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <vk_object_cache.h>
+#include <vk_types.h>
+
+template <typename T> static uint64_t handle_word(T handle) { return (uint64_t)handle; }
+
+// flattens create info fields into a key, enums and flags all fit a word
+template <typename... T> static void append(std::vector<uint64_t>& key, T... values) {
+  (key.push_back(static_cast<uint64_t>(values)), ...);
+}
+
+void ObjectCache::init(VkDevice device) { _device = device; }
+
+void ObjectCache::cleanup() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  // pipeline layouts reference set layouts, so they go first
+  for (auto& [key, layout] : _pipeline_layouts) {
+    vkDestroyPipelineLayout(_device, layout, nullptr);
+  }
+  for (auto& [key, layout] : _set_layouts) {
+    vkDestroyDescriptorSetLayout(_device, layout, nullptr);
+  }
+  for (auto& [key, sampler] : _samplers) {
+    vkDestroySampler(_device, sampler, nullptr);
+  }
+  _pipeline_layouts.clear();
+  _set_layouts.clear();
+  _samplers.clear();
+}
+
+VkSampler ObjectCache::sampler(const VkSamplerCreateInfo& info) {
+  assert(info.pNext == nullptr);
+
+  Key key;
+  append(key, info.flags, info.magFilter, info.minFilter, info.mipmapMode, info.addressModeU, info.addressModeV,
+         info.addressModeW, std::bit_cast<uint32_t>(info.mipLodBias), info.anisotropyEnable,
+         std::bit_cast<uint32_t>(info.maxAnisotropy), info.compareEnable, info.compareOp,
+         std::bit_cast<uint32_t>(info.minLod), std::bit_cast<uint32_t>(info.maxLod), info.borderColor,
+         info.unnormalizedCoordinates);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto [it, inserted] = _samplers.try_emplace(std::move(key), VK_NULL_HANDLE);
+  if (inserted) {
+    VK_CHECK(vkCreateSampler(_device, &info, nullptr, &it->second));
+  }
+  return it->second;
+}
+
+VkDescriptorSetLayout ObjectCache::descriptor_set_layout(const VkDescriptorSetLayoutCreateInfo& info) {
+  assert(info.pNext == nullptr);
+
+  // binding order doesn't change the layout, so the key lists bindings by number
+  std::vector<VkDescriptorSetLayoutBinding> bindings(info.pBindings, info.pBindings + info.bindingCount);
+  std::sort(bindings.begin(), bindings.end(),
+            [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b) {
+              return a.binding < b.binding;
+            });
+
+  Key key;
+  append(key, info.flags, info.bindingCount);
+  for (const VkDescriptorSetLayoutBinding& binding : bindings) {
+    const bool immutable = binding.pImmutableSamplers != nullptr;
+    append(key, binding.binding, binding.descriptorType, binding.descriptorCount, binding.stageFlags, immutable);
+    for (uint32_t i = 0; immutable && i < binding.descriptorCount; i++) {
+      key.push_back(handle_word(binding.pImmutableSamplers[i]));
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto [it, inserted] = _set_layouts.try_emplace(std::move(key), VK_NULL_HANDLE);
+  if (inserted) {
+    VK_CHECK(vkCreateDescriptorSetLayout(_device, &info, nullptr, &it->second));
+  }
+  return it->second;
+}
+
+VkPipelineLayout ObjectCache::pipeline_layout(const VkPipelineLayoutCreateInfo& info) {
+  assert(info.pNext == nullptr);
+
+  Key key;
+  append(key, info.flags, info.setLayoutCount, info.pushConstantRangeCount);
+  for (uint32_t i = 0; i < info.setLayoutCount; i++) {
+    key.push_back(handle_word(info.pSetLayouts[i]));
+  }
+  for (uint32_t i = 0; i < info.pushConstantRangeCount; i++) {
+    const VkPushConstantRange& range = info.pPushConstantRanges[i];
+    append(key, range.stageFlags, range.offset, range.size);
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  auto [it, inserted] = _pipeline_layouts.try_emplace(std::move(key), VK_NULL_HANDLE);
+  if (inserted) {
+    VK_CHECK(vkCreatePipelineLayout(_device, &info, nullptr, &it->second));
+  }
+  return it->second;
+}
+
+size_t ObjectCache::object_count() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _samplers.size() + _set_layouts.size() + _pipeline_layouts.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <hash.h>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+// engine wide cache of immutable vulkan objects, keyed on the contents of their create infos. asking twice for the
+// same sampler or layout returns the same handle, so reloading scenes doesn't grow the object count. handles are
+// owned by the cache and live until cleanup, callers never destroy them. pNext chains aren't part of the key and
+// have to be null
+class ObjectCache {
+public:
+  void init(VkDevice device);
+  void cleanup();
+
+  VkSampler sampler(const VkSamplerCreateInfo& info);
+  VkDescriptorSetLayout descriptor_set_layout(const VkDescriptorSetLayoutCreateInfo& info);
+  VkPipelineLayout pipeline_layout(const VkPipelineLayoutCreateInfo& info);
+
+  size_t object_count();
+
+private:
+  // create info contents flattened into words, so one hash and one compare cover every kind of object
+  using Key = std::vector<uint64_t>;
+  struct KeyHash {
+    size_t operator()(const Key& key) const { return hash_bytes(key.data(), key.size() * sizeof(uint64_t)); }
+  };
+
+  VkDevice _device;
+  // loaders create samplers from worker threads
+  std::mutex _mutex;
+  std::unordered_map<Key, VkSampler, KeyHash> _samplers;
+  std::unordered_map<Key, VkDescriptorSetLayout, KeyHash> _set_layouts;
+  std::unordered_map<Key, VkPipelineLayout, KeyHash> _pipeline_layouts;
+};
@@ -3,8 +3,11 @@
 #include <cstdint>
 #include <deque>
 #include <functional>
+#include <map>
 #include <memory>
 #include <optional>
+#include <transform_hierarchy.h>
+#include <tuple>
 #include <vector>
 #include <vk_descriptors.h>
 
@@ -18,6 +21,7 @@
 
 #include <glm/mat4x4.hpp>
 #include <glm/vec4.hpp>
+#include <vertex.h>
 #include <vulkan/vulkan_core.h>
 
 #define VK_CHECK(x)                                                                                                    \
@@ -47,6 +51,8 @@ struct DeletionQueue {
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphics_family;
   std::optional<uint32_t> present_family;
+  // family without graphics support used for async uploads. empty when the device only has shared families
+  std::optional<uint32_t> transfer_family;
   bool is_complete() { return graphics_family.has_value() && present_family.has_value(); }
 };
 
@@ -56,6 +62,12 @@ struct SwapChainSupportDetails {
   std::vector<VkPresentModeKHR> present_modes;
 };
 
+struct AllocatedBuffer {
+  VkBuffer buffer;
+  VmaAllocationInfo info;
+  VmaAllocation allocation;
+};
+
 struct FrameData {
   VkCommandPool command_pool;
   VkCommandBuffer main_command_buffer;
@@ -64,6 +76,15 @@ struct FrameData {
   VkFence _render_fence;
   DeletionQueue deletion_queue;
   DescriptorAllocatorGrowable descriptor_allocator;
+  // meshlet culling input and output, grown when a frame has more to cull than they hold
+  AllocatedBuffer meshlet_jobs;
+  AllocatedBuffer meshlet_draws;
+  uint32_t meshlet_job_capacity;
+  uint32_t meshlet_command_capacity;
+  // world matrix of every object drawn, read by the vertex shaders at gl_InstanceIndex
+  AllocatedBuffer instances;
+  VkDeviceAddress instance_address;
+  uint32_t instance_capacity;
 };
 
 struct AllocatedImage {
@@ -88,20 +109,6 @@ struct ComputeEffect {
   ComputePushConstants data;
 };
 
-struct AllocatedBuffer {
-  VkBuffer buffer;
-  VmaAllocationInfo info;
-  VmaAllocation allocation;
-};
-
-struct Vertex {
-  glm::vec3 position;
-  float uv_x;
-  glm::vec3 normal;
-  float uv_y;
-  glm::vec4 color;
-};
-
 // resources for a mesh
 struct GPUMeshBuffers {
   AllocatedBuffer index_buf;
@@ -111,8 +118,54 @@ struct GPUMeshBuffers {
 
 // push constants for mesh drawing
 struct GPUDrawPushConstants {
-  glm::mat4 world_mat;
   VkDeviceAddress vertex_buf_address;
+  // the frame's instance matrices, indexed by gl_InstanceIndex
+  VkDeviceAddress instance_buf_address;
+  // material table of the draw's scene and the draw's record in it
+  VkDeviceAddress material_buf_address;
+  uint32_t material_index;
+  // only read by the packed vertex shader. scale is already divided by 65535. aligned to match the glsl block
+  alignas(16) glm::vec4 position_offset;
+  glm::vec4 position_scale;
+};
+
+// set in GPUMeshletCullJob::flags when the job's meshlets may be rejected by their normal cone
+constexpr uint32_t MESHLET_CULL_CONE = 1;
+
+// one draw whose meshlets meshlet_cull.comp tests. layout matches the CullJob struct in the shader
+struct GPUMeshletCullJob {
+  glm::mat4 transform;
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+  // first command slot of the job, the meshlets that survive are compacted from here
+  uint32_t first_command;
+  // pool index the surface starts at, meshlet index ranges are relative to it
+  uint32_t first_index;
+  int32_t vertex_offset;
+  uint32_t flags;
+  // firstInstance of the job's commands, where its transform sits in the frame's instance buffer
+  uint32_t instance;
+  // geometry pool block first_meshlet indexes into
+  uint32_t meshlet_block;
+};
+
+// world space side planes of the view frustum and the camera position, shared by every job in a frame
+struct GPUMeshletCullView {
+  glm::vec4 frustum_planes[4];
+  glm::vec4 camera_position;
+};
+
+struct GPUMeshletCullPushConstants {
+  VkDeviceAddress view;
+  VkDeviceAddress jobs;
+  // meshlet buffer address of every geometry pool block
+  VkDeviceAddress meshlet_blocks;
+  // a surviving meshlet count per job, followed by the commands
+  VkDeviceAddress draw_counts;
+  VkDeviceAddress draw_commands;
+  // the dispatch is split when there are more jobs than one dispatch can have workgroups
+  uint32_t first_job;
+  uint32_t job_count;
 };
 
 struct GPUSceneData {
@@ -135,36 +188,46 @@ struct MaterialPipeline {
   VkPipelineLayout layout;
 };
 
+// id of a texture the engine's texture streamer doesn't manage
+constexpr uint32_t NO_STREAMED_TEXTURE = UINT32_MAX;
+
 struct MaterialInstance {
   MaterialPipeline* pipeline;
+  // only the textures. materials with the same images and samplers share a set
   VkDescriptorSet material_desc_set;
+  // the constants are record data_index of the material table at data_address, passed per draw
+  VkDeviceAddress data_address;
+  uint32_t data_index;
   MaterialPass pass_type;
+  // streamer id of the color texture, whose level is picked from how much of the screen the material covers
+  uint32_t streamed_texture{NO_STREAMED_TEXTURE};
 };
 
+// texture sets written from one descriptor allocator, by color view, color sampler, metal rough view and metal
+// rough sampler
+using MaterialTextureSets = std::map<std::tuple<VkImageView, VkSampler, VkImageView, VkSampler>, VkDescriptorSet>;
+
 struct DrawContext;
+class RenderList;
 
 class IRenderable {
-  virtual void Draw(const glm::mat4& top_matrix, DrawContext& ctx) = 0;
+  // brings the renderable's objects in list up to date with what changed since the last call
+  virtual void update_render_list(RenderList& list, const DrawContext& ctx) = 0;
 };
 
-struct Node : public IRenderable {
+struct Node {
   std::weak_ptr<Node> parent;
   std::vector<std::shared_ptr<Node>> children;
 
-  glm::mat4 local_transform;
-  glm::mat4 world_transform;
+  // the matrices live in the scene's flat store, at index transform
+  TransformHierarchy* transforms{nullptr};
+  uint32_t transform{0};
 
-  void refresh_transform(const glm::mat4& parent_matrix) {
-    world_transform = parent_matrix * local_transform;
+  // virtual so a node is polymorphic and mesh nodes can be told apart
+  virtual ~Node() = default;
 
-    for (auto& c : children) {
-      c->refresh_transform(parent_matrix);
-    }
-  }
-
-  void Draw(const glm::mat4& top_matrix, DrawContext& ctx) {
-    for (auto& c : children) {
-      c->Draw(top_matrix, ctx);
-    }
-  }
+  const glm::mat4& local_transform() const { return transforms->local(transform); }
+  // world_transform is stale until the store's next update
+  const glm::mat4& world_transform() const { return transforms->world(transform); }
+  void set_local_transform(const glm::mat4& local) { transforms->set_local(transform, local); }
 };
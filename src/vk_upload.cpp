@@ -0,0 +1,371 @@
+#include "vk_engine.h"
+#include "vk_images.h"
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <vk_initializers.h>
+#include <vk_upload.h>
+
+// size of each staging block. uploads bigger than this get a block of their own
+constexpr size_t STAGING_BLOCK_SIZE = 64 * 1024 * 1024;
+// keeps every staging offset valid for buffer to image copies
+constexpr size_t STAGING_ALIGNMENT = 16;
+
+UploadBatch::~UploadBatch() {
+  // a batch that was never flushed still owns its staging memory
+  release_staging();
+}
+
+UploadBatch::StagingAllocation UploadBatch::stage(const void* data, size_t size) {
+  size_t offset = (_block_used + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+
+  if (_staging_blocks.empty() || offset + size > _block_capacity) {
+    _block_capacity = std::max(size, STAGING_BLOCK_SIZE);
+    _staging_blocks.push_back(
+        _engine->create_buffer(_block_capacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY));
+    offset = 0;
+  }
+
+  AllocatedBuffer& block = _staging_blocks.back();
+  memcpy((char*)block.info.pMappedData + offset, data, size);
+
+  _block_used = offset + size;
+  _staged_bytes += size;
+
+  return StagingAllocation{.buffer = block.buffer, .offset = offset};
+}
+
+void UploadBatch::upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, size_t size,
+                                bool concurrent_sharing) {
+  if (size == 0) {
+    return;
+  }
+
+  StagingAllocation staging = stage(data, size);
+
+  BufferCopy copy{};
+  copy.src = staging.buffer;
+  copy.dst = dst;
+  copy.region.srcOffset = staging.offset;
+  copy.region.dstOffset = dst_offset;
+  copy.region.size = size;
+  copy.concurrent_sharing = concurrent_sharing;
+
+  _buffer_copies.push_back(copy);
+}
+
+void UploadBatch::upload_image(const AllocatedImage& dst, const void* data, size_t size, bool mipmapped) {
+  StagingAllocation staging = stage(data, size);
+
+  ImageCopy copy{};
+  copy.src = staging.buffer;
+  copy.level_offsets = {staging.offset};
+  copy.dst = dst;
+  copy.mipmapped = mipmapped;
+
+  _image_copies.push_back(copy);
+}
+
+void UploadBatch::upload_image_levels(const AllocatedImage& dst, const void* data, size_t size,
+                                      std::span<const VkDeviceSize> level_offsets) {
+  StagingAllocation staging = stage(data, size);
+
+  ImageCopy copy{};
+  copy.src = staging.buffer;
+  for (VkDeviceSize level_offset : level_offsets) {
+    copy.level_offsets.push_back(staging.offset + level_offset);
+  }
+  copy.dst = dst;
+  copy.mipmapped = false;
+
+  _image_copies.push_back(copy);
+}
+
+void UploadBatch::copy_levels(VkCommandBuffer cmd, const ImageCopy& copy) {
+  std::vector<VkBufferImageCopy> regions(copy.level_offsets.size());
+  for (uint32_t level = 0; level < regions.size(); level++) {
+    VkBufferImageCopy& region = regions[level];
+    region.bufferOffset = copy.level_offsets[level];
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = level;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = std::max(copy.dst.image_extent.width >> level, 1u);
+    region.imageExtent.height = std::max(copy.dst.image_extent.height >> level, 1u);
+    region.imageExtent.depth = 1;
+  }
+
+  vkCmdCopyBufferToImage(cmd, copy.src, copy.dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                         static_cast<uint32_t>(regions.size()), regions.data());
+}
+
+void UploadBatch::record(VkCommandBuffer cmd) {
+  for (const BufferCopy& copy : _buffer_copies) {
+    vkCmdCopyBuffer(cmd, copy.src, copy.dst, 1, &copy.region);
+  }
+
+  for (const ImageCopy& copy : _image_copies) {
+    vkutil::transition_image(cmd, copy.dst.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copy_levels(cmd, copy);
+
+    if (copy.mipmapped) {
+      VkExtent2D image_extent{.width = copy.dst.image_extent.width, .height = copy.dst.image_extent.height};
+      vkutil::generate_mipmaps(cmd, copy.dst.image, image_extent);
+    } else {
+      vkutil::transition_image(cmd, copy.dst.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+  }
+}
+
+static VkImageLayout uploaded_layout(bool mipmapped) {
+  // mipmapped images stay as a transfer destination until the graphics queue generates the rest of the chain
+  return mipmapped ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+}
+
+static void pipeline_barrier(VkCommandBuffer cmd, std::span<VkBufferMemoryBarrier2> buffer_barriers,
+                             std::span<VkImageMemoryBarrier2> image_barriers) {
+  if (buffer_barriers.empty() && image_barriers.empty()) {
+    return;
+  }
+
+  VkDependencyInfo dep_info{.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .pNext = nullptr};
+  dep_info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size());
+  dep_info.pBufferMemoryBarriers = buffer_barriers.data();
+  dep_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+  dep_info.pImageMemoryBarriers = image_barriers.data();
+
+  vkCmdPipelineBarrier2(cmd, &dep_info);
+}
+
+void UploadBatch::record_release(VkCommandBuffer cmd, uint32_t src_family, uint32_t dst_family) {
+  // on a shared queue family the timeline semaphore already orders the copies before the frame, so only the
+  // image layouts need to change
+  const bool ownership_transfer = src_family != dst_family;
+  if (!ownership_transfer) {
+    src_family = VK_QUEUE_FAMILY_IGNORED;
+    dst_family = VK_QUEUE_FAMILY_IGNORED;
+  }
+
+  std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+  std::vector<VkImageMemoryBarrier2> image_barriers;
+
+  for (const BufferCopy& copy : _buffer_copies) {
+    vkCmdCopyBuffer(cmd, copy.src, copy.dst, 1, &copy.region);
+
+    if (ownership_transfer && !copy.concurrent_sharing) {
+      VkBufferMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2, .pNext = nullptr};
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+      barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+      barrier.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+      barrier.dstAccessMask = VK_ACCESS_2_NONE;
+      barrier.srcQueueFamilyIndex = src_family;
+      barrier.dstQueueFamilyIndex = dst_family;
+      barrier.buffer = copy.dst;
+      barrier.offset = copy.region.dstOffset;
+      barrier.size = copy.region.size;
+      buffer_barriers.push_back(barrier);
+    }
+  }
+
+  for (const ImageCopy& copy : _image_copies) {
+    vkutil::transition_image(cmd, copy.dst.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    copy_levels(cmd, copy);
+
+    VkImageLayout new_layout = uploaded_layout(copy.mipmapped);
+    if (!ownership_transfer && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
+      continue;
+    }
+
+    VkImageMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2, .pNext = nullptr};
+    barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    barrier.dstStageMask = ownership_transfer ? VK_PIPELINE_STAGE_2_NONE : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    barrier.dstAccessMask = ownership_transfer ? VK_ACCESS_2_NONE : VK_ACCESS_2_MEMORY_READ_BIT;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = new_layout;
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+    barrier.image = copy.dst.image;
+    barrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+    image_barriers.push_back(barrier);
+  }
+
+  pipeline_barrier(cmd, buffer_barriers, image_barriers);
+}
+
+void UploadBatch::record_acquire(VkCommandBuffer cmd, uint32_t src_family, uint32_t dst_family) {
+  const bool ownership_transfer = src_family != dst_family;
+
+  std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+  std::vector<VkImageMemoryBarrier2> image_barriers;
+
+  if (ownership_transfer) {
+    // the acquire barriers have to mirror the release barriers exactly, layouts included
+    for (const BufferCopy& copy : _buffer_copies) {
+      if (copy.concurrent_sharing) {
+        continue;
+      }
+
+      VkBufferMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2, .pNext = nullptr};
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+      barrier.srcAccessMask = VK_ACCESS_2_NONE;
+      barrier.dstStageMask = VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT;
+      barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT;
+      barrier.srcQueueFamilyIndex = src_family;
+      barrier.dstQueueFamilyIndex = dst_family;
+      barrier.buffer = copy.dst;
+      barrier.offset = copy.region.dstOffset;
+      barrier.size = copy.region.size;
+      buffer_barriers.push_back(barrier);
+    }
+
+    for (const ImageCopy& copy : _image_copies) {
+      VkImageMemoryBarrier2 barrier{.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2, .pNext = nullptr};
+      barrier.srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+      barrier.srcAccessMask = VK_ACCESS_2_NONE;
+      if (copy.mipmapped) {
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT;
+      } else {
+        barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+        barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+      }
+      barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+      barrier.newLayout = uploaded_layout(copy.mipmapped);
+      barrier.srcQueueFamilyIndex = src_family;
+      barrier.dstQueueFamilyIndex = dst_family;
+      barrier.image = copy.dst.image;
+      barrier.subresourceRange = vkinit::image_subresource_range(VK_IMAGE_ASPECT_COLOR_BIT);
+      image_barriers.push_back(barrier);
+    }
+
+    pipeline_barrier(cmd, buffer_barriers, image_barriers);
+  }
+
+  for (const ImageCopy& copy : _image_copies) {
+    if (copy.mipmapped) {
+      VkExtent2D image_extent{.width = copy.dst.image_extent.width, .height = copy.dst.image_extent.height};
+      vkutil::generate_mipmaps(cmd, copy.dst.image, image_extent);
+    }
+  }
+}
+
+void UploadBatch::flush() {
+  if (!empty()) {
+    _engine->immediate_submit([&](VkCommandBuffer cmd) { record(cmd); });
+  }
+
+  _buffer_copies.clear();
+  _image_copies.clear();
+  release_staging();
+}
+
+void UploadBatch::release_staging() {
+  for (AllocatedBuffer& block : _staging_blocks) {
+    _engine->destroy_buffer(block);
+  }
+  _staging_blocks.clear();
+  _block_capacity = 0;
+  _block_used = 0;
+  _staged_bytes = 0;
+}
+
+void AsyncUploader::init(VulkanEngine* engine) {
+  _engine = engine;
+
+  VkCommandPoolCreateInfo pool_ci =
+      vkinit::command_pool_create_info(_engine->_transfer_queue_family, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+  VK_CHECK(vkCreateCommandPool(_engine->_device, &pool_ci, nullptr, &_cmd_pool));
+
+  VkSemaphoreTypeCreateInfo timeline_ci{};
+  timeline_ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  timeline_ci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  timeline_ci.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphore_ci = vkinit::semaphore_create_info();
+  semaphore_ci.pNext = &timeline_ci;
+  VK_CHECK(vkCreateSemaphore(_engine->_device, &semaphore_ci, nullptr, &_timeline));
+}
+
+void AsyncUploader::cleanup() {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // the staging memory of unfinished batches can't be freed while the transfer queue still reads it
+  VkSemaphoreWaitInfo wait_info{};
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &_timeline;
+  wait_info.pValues = &_next_ticket;
+  VK_CHECK(vkWaitSemaphores(_engine->_device, &wait_info, UINT64_MAX));
+
+  _in_flight.clear();
+
+  vkDestroyCommandPool(_engine->_device, _cmd_pool, nullptr);
+  vkDestroySemaphore(_engine->_device, _timeline, nullptr);
+}
+
+uint64_t AsyncUploader::submit(UploadBatch&& batch) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  VkCommandBuffer cmd;
+  VkCommandBufferAllocateInfo cmd_ai = vkinit::command_buffer_allocate_info(_cmd_pool);
+  VK_CHECK(vkAllocateCommandBuffers(_engine->_device, &cmd_ai, &cmd));
+
+  VkCommandBufferBeginInfo begin_info = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+  VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+  batch.record_release(cmd, _engine->_transfer_queue_family, _engine->_graphics_queue_family);
+  VK_CHECK(vkEndCommandBuffer(cmd));
+
+  uint64_t ticket = ++_next_ticket;
+
+  VkSemaphoreSubmitInfo signal_info = vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, _timeline);
+  signal_info.value = ticket;
+
+  VkCommandBufferSubmitInfo cmd_info = vkinit::command_buffer_submit_info(cmd);
+  VkSubmitInfo2 submit_info = vkinit::submit_info(&cmd_info, &signal_info, nullptr);
+  {
+    std::lock_guard<std::mutex> queue_lock(_engine->_queue_mutex);
+    VK_CHECK(vkQueueSubmit2(_engine->_transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
+  }
+
+  _in_flight.push_back(InFlightBatch{.ticket = ticket, .cmd = cmd, .batch = std::move(batch)});
+
+  return ticket;
+}
+
+uint64_t AsyncUploader::record_acquires(VkCommandBuffer cmd) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  if (_in_flight.empty()) {
+    return 0;
+  }
+
+  uint64_t completed{0};
+  VK_CHECK(vkGetSemaphoreCounterValue(_engine->_device, _timeline, &completed));
+
+  // batches signal in submission order, so the finished ones are always at the front
+  uint64_t acquired{0};
+  while (!_in_flight.empty() && _in_flight.front().ticket <= completed) {
+    InFlightBatch& finished = _in_flight.front();
+    finished.batch.record_acquire(cmd, _engine->_transfer_queue_family, _engine->_graphics_queue_family);
+    acquired = finished.ticket;
+
+    // the transfer queue is done with the command buffer and the staging memory
+    vkFreeCommandBuffers(_engine->_device, _cmd_pool, 1, &finished.cmd);
+    _in_flight.pop_front();
+  }
+
+  if (acquired != 0) {
+    _resident_ticket = acquired;
+  }
+  return acquired;
+}
+
+size_t AsyncUploader::pending_batches() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _in_flight.size();
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <vector>
+#include <vk_types.h>
+
+class VulkanEngine;
+
+// gathers buffer and image uploads into one staging arena so a whole batch can be recorded into a
+// single command buffer and submitted with a single fence wait
+class UploadBatch {
+public:
+  explicit UploadBatch(VulkanEngine* engine) : _engine(engine) {}
+  ~UploadBatch();
+
+  UploadBatch(const UploadBatch&) = delete;
+  UploadBatch& operator=(const UploadBatch&) = delete;
+  UploadBatch(UploadBatch&&) = default;
+
+  // copies size bytes of data into staging and queues a copy into dst at dst_offset. buffers created with
+  // VK_SHARING_MODE_CONCURRENT skip the queue family ownership transfer
+  void upload_buffer(VkBuffer dst, VkDeviceSize dst_offset, const void* data, size_t size,
+                     bool concurrent_sharing = false);
+  // copies the pixels for mip 0 into staging and queues the copy. the rest of the mip chain is
+  // generated on the gpu when mipmapped is set
+  void upload_image(const AllocatedImage& dst, const void* data, size_t size, bool mipmapped);
+  // copies a prebuilt mip chain into staging and queues a copy per level. data holds every level and
+  // level_offsets says where each one starts, level 0 first. offsets have to keep the format's block alignment
+  void upload_image_levels(const AllocatedImage& dst, const void* data, size_t size,
+                           std::span<const VkDeviceSize> level_offsets);
+
+  // records every queued copy into cmd
+  void record(VkCommandBuffer cmd);
+  // records the copies on the transfer queue and releases every resource from src_family to dst_family.
+  // mip generation needs blits, so it is left for record_acquire on the graphics queue
+  void record_release(VkCommandBuffer cmd, uint32_t src_family, uint32_t dst_family);
+  // records the matching acquire barriers on dst_family and generates mips
+  void record_acquire(VkCommandBuffer cmd, uint32_t src_family, uint32_t dst_family);
+  // submits the batch through the engine's immediate submit, waits for it and releases the staging memory
+  void flush();
+
+  bool empty() const { return _buffer_copies.empty() && _image_copies.empty(); }
+  size_t staged_bytes() const { return _staged_bytes; }
+
+private:
+  struct StagingAllocation {
+    VkBuffer buffer;
+    VkDeviceSize offset;
+  };
+
+  struct BufferCopy {
+    VkBuffer src;
+    VkBuffer dst;
+    VkBufferCopy region;
+    bool concurrent_sharing;
+  };
+
+  struct ImageCopy {
+    VkBuffer src;
+    // staging offset of each level that is copied, the rest of the chain is generated when mipmapped is set
+    std::vector<VkDeviceSize> level_offsets;
+    AllocatedImage dst;
+    bool mipmapped;
+  };
+
+  static void copy_levels(VkCommandBuffer cmd, const ImageCopy& copy);
+
+  StagingAllocation stage(const void* data, size_t size);
+  void release_staging();
+
+  VulkanEngine* _engine;
+
+  // staging memory is handed out linearly from large blocks, a new block is only made when the current one is full
+  std::vector<AllocatedBuffer> _staging_blocks;
+  size_t _block_capacity{0};
+  size_t _block_used{0};
+  size_t _staged_bytes{0};
+
+  std::vector<BufferCopy> _buffer_copies;
+  std::vector<ImageCopy> _image_copies;
+};
+
+// submits upload batches on the transfer queue without waiting for them. each submit signals the next value of
+// a timeline semaphore, and the graphics side acquires a batch's resources only once that value is reached
+class AsyncUploader {
+public:
+  void init(VulkanEngine* engine);
+  void cleanup();
+
+  // hands the batch to the transfer queue and returns the timeline value that marks its completion
+  uint64_t submit(UploadBatch&& batch);
+
+  // records acquire barriers for every batch the transfer queue has finished. returns the highest timeline
+  // value acquired in cmd, or 0 if nothing was acquired and the frame doesn't need to wait on the semaphore
+  uint64_t record_acquires(VkCommandBuffer cmd);
+
+  // a ticket is resident once its acquire barriers were recorded into an earlier frame
+  bool is_resident(uint64_t ticket) const { return ticket <= _resident_ticket; }
+  uint64_t resident_ticket() const { return _resident_ticket; }
+
+  VkSemaphore timeline() const { return _timeline; }
+  size_t pending_batches();
+
+private:
+  struct InFlightBatch {
+    uint64_t ticket;
+    VkCommandBuffer cmd;
+    UploadBatch batch;
+  };
+
+  VulkanEngine* _engine;
+  VkCommandPool _cmd_pool;
+  VkSemaphore _timeline;
+
+  // loaders can submit from other threads, and the transfer queue needs external synchronization
+  std::mutex _mutex;
+  std::deque<InFlightBatch> _in_flight;
+  uint64_t _next_ticket{0};
+  std::atomic<uint64_t> _resident_ticket{0};
+};
@@ -0,0 +1,170 @@
+// cooks every image a glTF's materials use into a block compressed KTX2 file with its full mip chain, stored in
+// the texture cache the loader checks before decoding anything. color images become BC7, normal and
+// metal-roughness images BC5. run from the build dir like the renderer so the default cache dir lines up:
+// texture_cooker <scene.gltf or .glb> [cache dir]
+
+#include <atomic>
+#include <bc_encoder.h>
+#include <chrono>
+#include <cmath>
+#include <cooked_texture.h>
+#include <fastgltf/core.hpp>
+#include <fmt/core.h>
+#include <hash.h>
+#include <ktx2.h>
+#include <thread_pool.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+struct MipLevel {
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint8_t> rgba;
+};
+
+// 2x2 box filter, odd edges reuse their last row or column. normals are averaged as vectors and renormalized so
+// the smaller levels keep unit length normals
+static MipLevel downsample(const MipLevel& src, TextureRole role) {
+  MipLevel dst;
+  dst.width = std::max(src.width / 2, 1u);
+  dst.height = std::max(src.height / 2, 1u);
+  dst.rgba.resize(size_t(dst.width) * dst.height * 4);
+
+  for (uint32_t y = 0; y < dst.height; y++) {
+    for (uint32_t x = 0; x < dst.width; x++) {
+      const uint32_t x0 = std::min(x * 2, src.width - 1);
+      const uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+      const uint32_t y0 = std::min(y * 2, src.height - 1);
+      const uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+      auto texel = [&](uint32_t tx, uint32_t ty) { return &src.rgba[(size_t(ty) * src.width + tx) * 4]; };
+      const uint8_t* taps[4]{texel(x0, y0), texel(x1, y0), texel(x0, y1), texel(x1, y1)};
+      uint8_t* out = &dst.rgba[(size_t(y) * dst.width + x) * 4];
+
+      if (role == TextureRole::normal) {
+        float n[3]{};
+        for (const uint8_t* tap : taps) {
+          for (uint32_t c = 0; c < 3; c++) {
+            n[c] += tap[c] / 127.5f - 1.f;
+          }
+        }
+        const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (uint32_t c = 0; c < 3; c++) {
+          const float unit = length > 0.f ? n[c] / length : (c == 2 ? 1.f : 0.f);
+          out[c] = uint8_t(std::lround((unit + 1.f) * 127.5f));
+        }
+        out[3] = 255;
+        continue;
+      }
+
+      for (uint32_t c = 0; c < 4; c++) {
+        out[c] = uint8_t((taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4);
+      }
+    }
+  }
+  return dst;
+}
+
+static std::vector<std::byte> encode_level(const MipLevel& level, TextureRole role) {
+  switch (role) {
+  case TextureRole::normal:
+    return encode_bc5(level.rgba, level.width, level.height, 0, 1);
+  case TextureRole::metal_rough:
+    return encode_bc5(level.rgba, level.width, level.height, 1, 2);
+  default:
+    return encode_bc7(level.rgba, level.width, level.height);
+  }
+}
+
+static bool cook_image(std::span<const std::byte> source, TextureRole role, const std::filesystem::path& path) {
+  int width;
+  int height;
+  int channels;
+  stbi_uc* pixels = stbi_load_from_memory((const stbi_uc*)source.data(), static_cast<int>(source.size()), &width,
+                                          &height, &channels, 4);
+  if (pixels == nullptr) {
+    return false;
+  }
+
+  MipLevel level{static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  level.rgba.assign(pixels, pixels + size_t(width) * height * 4);
+  stbi_image_free(pixels);
+
+  std::vector<std::vector<std::byte>> levels;
+  while (true) {
+    levels.push_back(encode_level(level, role));
+    if (level.width == 1 && level.height == 1) {
+      break;
+    }
+    level = downsample(level, role);
+  }
+
+  return write_ktx2(path, cooked_texture_format(role), static_cast<uint32_t>(width), static_cast<uint32_t>(height),
+                    levels);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 2) {
+    fmt::println("usage: texture_cooker <scene.gltf or .glb> [cache dir]");
+    return 1;
+  }
+  const std::filesystem::path gltf_path = argv[1];
+  const std::filesystem::path cache_dir = argc > 2 ? argv[2] : TEXTURE_CACHE_DIR;
+
+  // the same options as the loader so images resolve to the same bytes
+  constexpr auto gltf_options = fastgltf::Options::DontRequireValidAssetMember | fastgltf::Options::AllowDouble |
+                                fastgltf::Options::LoadGLBBuffers | fastgltf::Options::LoadExternalBuffers |
+                                fastgltf::Options::LoadExternalImages;
+  fastgltf::Parser parser(fastgltf::Extensions::KHR_mesh_quantization | fastgltf::Extensions::KHR_texture_transform |
+                          fastgltf::Extensions::KHR_texture_basisu | fastgltf::Extensions::KHR_materials_variants);
+
+  fastgltf::GltfDataBuffer data;
+  data.loadFromFile(gltf_path);
+  auto load = parser.loadGltf(&data, gltf_path.parent_path(), gltf_options);
+  if (!load) {
+    fmt::println("failed to load {}: {}", gltf_path.string(), fastgltf::to_underlying(load.error()));
+    return 1;
+  }
+  fastgltf::Asset gltf = std::move(load.get());
+
+  const auto start = std::chrono::steady_clock::now();
+  const std::vector<std::optional<TextureRole>> roles = image_roles(gltf);
+
+  std::atomic<uint32_t> cooked{0};
+  std::atomic<uint32_t> cached{0};
+  std::atomic<uint32_t> failed{0};
+
+  ThreadPool pool;
+  std::vector<std::future<void>> jobs;
+  for (size_t i = 0; i < gltf.images.size(); i++) {
+    if (!roles[i].has_value()) {
+      continue;
+    }
+    jobs.push_back(pool.submit([&, i]() {
+      MappedFile source_file;
+      std::span<const std::byte> source = image_source_bytes(gltf, gltf.images[i], source_file);
+      // KTX2 sources are loaded as they are
+      if (source.empty() || is_ktx2(source)) {
+        return;
+      }
+
+      const std::filesystem::path path = cooked_texture_path(hash_bytes(source), *roles[i], cache_dir);
+      if (std::filesystem::exists(path)) {
+        cached++;
+      } else if (cook_image(source, *roles[i], path)) {
+        cooked++;
+      } else {
+        fmt::println("failed to cook image {} ({})", i, gltf.images[i].name.c_str());
+        failed++;
+      }
+    }));
+  }
+  for (std::future<void>& job : jobs) {
+    job.get();
+  }
+
+  const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+  fmt::println("cooked {} textures into {} in {} ms, {} already cached, {} failed", cooked.load(), cache_dir.string(),
+               elapsed.count(), cached.load(), failed.load());
+  return failed > 0 ? 1 : 0;
+}